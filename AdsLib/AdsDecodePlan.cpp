@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AdsDecodePlan.h"
+#include "AdsException.h"
+#include "wrap_endian.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+/** nesting of structures, arrays and aliases, deeper types are assumed to be recursive */
+static const size_t MAX_DEPTH = 64;
+
+static bool EqualNoCase(const std::string& lhs, const std::string& rhs)
+{
+    return (lhs.size() == rhs.size()) && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+}
+
+/** position of the element "i,j" in an array with these dimensions, throws if it is out of bounds */
+static uint64_t Position(const std::vector<AdsDatatypeArrayInfo>& dimensions, const std::string& index)
+{
+    uint64_t position = 0;
+    auto next = index.c_str();
+    for (size_t d = 0; d < dimensions.size(); ++d) {
+        char* end;
+        const auto i = static_cast<int64_t>(strtoll(next, &end, 10)) - static_cast<int64_t>(dimensions[d].lBound);
+        if ((end == next) || (*end != ((d + 1 < dimensions.size()) ? ',' : '\0')) ||
+            (i < 0) || (i >= static_cast<int64_t>(dimensions[d].elements))) {
+            throw AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND);
+        }
+        position = position * dimensions[d].elements + static_cast<uint64_t>(i);
+        next = end + 1;
+    }
+    return position;
+}
+
+AdsDecodePlan::AdsDecodePlan(const AdsSymbolTable& symbols, const std::string& typeName)
+    : size(0),
+    numSlots(0)
+{
+    AdsDataType root;
+    if (!symbols.FindType(typeName, root)) {
+        throw AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND);
+    }
+    if (!root.size) {
+        throw AdsException(ADSERR_DEVICE_INVALIDSIZE);
+    }
+    size = root.size;
+    Compile(symbols, typeName, root.dataType, root.size, 0, "", 0);
+
+    /* catch inconsistent type information now, so Decode() doesn't need to check every step */
+    if (!Fits(steps.data(), steps.data() + steps.size(), size)) {
+        throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+    }
+}
+
+bool AdsDecodePlan::Fits(const Step* first, const Step* const last, const uint64_t size)
+{
+    for (auto step = first; step != last; ++step) {
+        if (static_cast<uint64_t>(step->offset) + static_cast<uint64_t>(step->width) * step->count > size) {
+            return false;
+        }
+        if (Op::REPEAT == step->op) {
+            if (!Fits(step + 1, step + 1 + step->numSteps, step->width)) {
+                return false;
+            }
+            step += step->numSteps;
+        }
+    }
+    return true;
+}
+
+void AdsDecodePlan::Compile(const AdsSymbolTable& symbols,
+                            const std::string&    typeName,
+                            const uint32_t        dataType,
+                            const uint32_t        typeSize,
+                            const uint32_t        offset,
+                            const std::string&    path,
+                            const size_t          depth)
+{
+    if (depth > MAX_DEPTH) {
+        throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+    }
+
+    AdsDataType type;
+    if (!symbols.FindType(typeName, type)) {
+        /* base types are usually not part of the data type upload */
+        Add(dataType, typeSize, 1, offset, path);
+        return;
+    }
+
+    if (!type.fields.empty()) {
+        for (const auto& field : type.fields) {
+            Compile(symbols, field.type, field.dataType, field.size, offset + field.offset,
+                    path.empty() ? std::string(field.name) : path + '.' + field.name, depth + 1);
+        }
+        return;
+    }
+
+    if (!type.dimensions.empty()) {
+        uint64_t count = 1;
+        for (const auto& dimension : type.dimensions) {
+            count *= dimension.elements;
+        }
+        if (!count) {
+            return;
+        }
+        if (count > UINT32_MAX) {
+            throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+        }
+        const auto elementSize = static_cast<uint32_t>(type.size / count);
+
+        /* arrays of primitives are decoded by a single step */
+        AdsDataType element;
+        if (!symbols.FindType(type.type, element) || (element.fields.empty() && element.dimensions.empty())) {
+            Add(type.dataType, elementSize, static_cast<uint32_t>(count), offset, path);
+            return;
+        }
+
+        /* other elements are compiled once, relative to the offset and slot of the element */
+        const auto repeat = steps.size();
+        const auto firstField = fields.size();
+        const auto firstSlot = numSlots;
+        steps.push_back(Step { offset, elementSize, static_cast<uint32_t>(count), static_cast<uint32_t>(firstSlot),
+                               Op::REPEAT, 0, 0 });
+        Compile(symbols, type.type, type.dataType, elementSize, 0, path + "[]", depth + 1);
+
+        const auto slotStride = numSlots - firstSlot;
+        if (slotStride * count > UINT32_MAX - firstSlot) {
+            throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+        }
+        for (auto i = repeat + 1; i < steps.size(); i += (Op::REPEAT == steps[i].op) ? steps[i].numSteps + 1 : 1) {
+            steps[i].slot -= static_cast<uint32_t>(firstSlot);
+        }
+        steps[repeat].numSteps = static_cast<uint32_t>(steps.size() - repeat - 1);
+        steps[repeat].numSlots = static_cast<uint32_t>(slotStride);
+        for (auto i = firstField; i < fields.size(); ++i) {
+            fields[i].offset += offset;
+            fields[i].arrays.insert(fields[i].arrays.begin(), AdsDecodedArray {
+                type.dimensions, elementSize, static_cast<uint32_t>(slotStride)
+            });
+        }
+        numSlots = firstSlot + slotStride * count;
+        return;
+    }
+
+    /* aliases and enums are resolved to their base type */
+    if (*type.type && !EqualNoCase(type.type, typeName)) {
+        Compile(symbols, type.type, type.dataType, type.size, offset, path, depth + 1);
+        return;
+    }
+    Add(type.dataType, type.size, 1, offset, path);
+}
+
+void AdsDecodePlan::Add(const uint32_t     dataType,
+                        const uint32_t     width,
+                        const uint32_t     count,
+                        const uint32_t     offset,
+                        const std::string& path)
+{
+    auto kind = AdsValueKind::BYTES;
+    auto op = Op::BYTES;
+    switch (dataType) {
+    case ADST_INT8:
+    case ADST_INT16:
+    case ADST_INT32:
+    case ADST_INT64:
+        kind = AdsValueKind::SIGNED;
+        break;
+
+    case ADST_UINT8:
+    case ADST_UINT16:
+    case ADST_UINT32:
+    case ADST_UINT64:
+    case ADST_BIT:
+        kind = AdsValueKind::UNSIGNED;
+        break;
+
+    case ADST_REAL32:
+    case ADST_REAL64:
+        kind = AdsValueKind::FLOAT;
+        break;
+
+    case ADST_STRING:
+        kind = AdsValueKind::STRING;
+        break;
+
+    case ADST_WSTRING:
+        kind = AdsValueKind::WSTRING;
+        break;
+    }
+
+    /* the width decides, as the data type of enums and aliases isn't always precise */
+    if (AdsValueKind::SIGNED == kind) {
+        const Op ops[] = { Op::INT8, Op::INT16, Op::BYTES, Op::INT32, Op::BYTES, Op::BYTES, Op::BYTES, Op::INT64 };
+        op = (width && (width <= 8)) ? ops[width - 1] : Op::BYTES;
+    } else if (AdsValueKind::UNSIGNED == kind) {
+        const Op ops[] = { Op::UINT8, Op::UINT16, Op::BYTES, Op::UINT32, Op::BYTES, Op::BYTES, Op::BYTES, Op::UINT64 };
+        op = (width && (width <= 8)) ? ops[width - 1] : Op::BYTES;
+    } else if (AdsValueKind::FLOAT == kind) {
+        op = (4 == width) ? Op::REAL32 : (8 == width) ? Op::REAL64 : Op::BYTES;
+    }
+    if ((Op::BYTES == op) && (AdsValueKind::STRING != kind) && (AdsValueKind::WSTRING != kind)) {
+        kind = AdsValueKind::BYTES;
+    }
+
+    const auto slot = static_cast<uint32_t>(numSlots);
+    steps.push_back(Step { offset, width, count, slot, op, 0, 0 });
+    fields.push_back(AdsDecodedField { path, kind, offset, width, count, slot, {} });
+    numSlots += count;
+}
+
+uint32_t AdsDecodePlan::Size() const
+{
+    return size;
+}
+
+size_t AdsDecodePlan::NumSlots() const
+{
+    return numSlots;
+}
+
+const std::vector<AdsDecodedField>& AdsDecodePlan::Fields() const
+{
+    return fields;
+}
+
+AdsDecodedField AdsDecodePlan::Field(const std::string& path) const
+{
+    /* fields of arrays of structures are stored as "[]", so the indices are split off */
+    std::string pattern;
+    std::vector<std::string> indices;
+    for (size_t i = 0; i < path.size(); ++i) {
+        pattern += path[i];
+        if ('[' == path[i]) {
+            const auto end = path.find(']', i);
+            if (std::string::npos == end) {
+                throw AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND);
+            }
+            indices.push_back(path.substr(i + 1, end - i - 1));
+            i = end - 1;
+        }
+    }
+
+    for (const auto& field : fields) {
+        if ((field.arrays.size() != indices.size()) || !EqualNoCase(field.path, pattern)) {
+            continue;
+        }
+        auto selected = field;
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const auto& array = field.arrays[i];
+            const auto position = Position(array.dimensions, indices[i]);
+            selected.offset += static_cast<uint32_t>(position * array.stride);
+            selected.slot += static_cast<uint32_t>(position * array.slotStride);
+        }
+        return selected;
+    }
+    throw AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND);
+}
+
+template<typename T>
+static void DecodeSigned(const uint8_t* data, AdsValue* values, const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i].i = static_cast<T>(bhf::ads::letoh<typename std::make_unsigned<T>::type>(data + i * sizeof(T)));
+    }
+}
+
+template<typename T>
+static void DecodeUnsigned(const uint8_t* data, AdsValue* values, const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i].u = bhf::ads::letoh<T>(data + i * sizeof(T));
+    }
+}
+
+template<typename T, typename Bits>
+static void DecodeFloat(const uint8_t* data, AdsValue* values, const uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto bits = bhf::ads::letoh<Bits>(data + i * sizeof(T));
+        T value;
+        memcpy(&value, &bits, sizeof(value));
+        values[i].f = value;
+    }
+}
+
+void AdsDecodePlan::Decode(const void* const data, const size_t length, AdsValue* values, const size_t count) const
+{
+    if (length / size < count) {
+        throw AdsException(ADSERR_DEVICE_INVALIDSIZE);
+    }
+
+    auto element = static_cast<const uint8_t*>(data);
+    for (size_t e = 0; e < count; ++e, element += size, values += numSlots) {
+        Decode(steps.data(), steps.data() + steps.size(), element, values);
+    }
+}
+
+void AdsDecodePlan::Decode(const Step* const first, const Step* const last, const uint8_t* const element,
+                           AdsValue* const values)
+{
+    for (auto step = first; step != last; ++step) {
+        const auto src = element + step->offset;
+        const auto dst = values + step->slot;
+        switch (step->op) {
+        case Op::INT8:
+            DecodeSigned<int8_t>(src, dst, step->count);
+            break;
+
+        case Op::INT16:
+            DecodeSigned<int16_t>(src, dst, step->count);
+            break;
+
+        case Op::INT32:
+            DecodeSigned<int32_t>(src, dst, step->count);
+            break;
+
+        case Op::INT64:
+            DecodeSigned<int64_t>(src, dst, step->count);
+            break;
+
+        case Op::UINT8:
+            DecodeUnsigned<uint8_t>(src, dst, step->count);
+            break;
+
+        case Op::UINT16:
+            DecodeUnsigned<uint16_t>(src, dst, step->count);
+            break;
+
+        case Op::UINT32:
+            DecodeUnsigned<uint32_t>(src, dst, step->count);
+            break;
+
+        case Op::UINT64:
+            DecodeUnsigned<uint64_t>(src, dst, step->count);
+            break;
+
+        case Op::REAL32:
+            DecodeFloat<float, uint32_t>(src, dst, step->count);
+            break;
+
+        case Op::REAL64:
+            DecodeFloat<double, uint64_t>(src, dst, step->count);
+            break;
+
+        case Op::BYTES:
+            for (uint32_t i = 0; i < step->count; ++i) {
+                dst[i].bytes.data = src + i * step->width;
+                dst[i].bytes.length = step->width;
+            }
+            break;
+
+        case Op::REPEAT:
+            for (uint32_t i = 0; i < step->count; ++i) {
+                Decode(step + 1, step + 1 + step->numSteps, src + i * step->width, dst + i * step->numSlots);
+            }
+            step += step->numSteps;
+            break;
+        }
+    }
+}
+
+size_t AdsDecodePlan::Decode(const AdsNotificationHeader& notification, AdsValue* values, const size_t maxCount) const
+{
+    const auto count = std::min<size_t>(notification.cbSampleSize / size, maxCount);
+    Decode(&notification + 1, notification.cbSampleSize, values, count);
+    return count;
+}
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsSymbolTable.h"
+
+/** tells which member of an AdsValue is valid */
+enum class AdsValueKind : uint8_t {
+    SIGNED,
+    UNSIGNED,
+    FLOAT,
+    STRING,
+    WSTRING,
+
+    /** types without a primitive representation, e.g. REAL80 or pointers */
+    BYTES,
+};
+
+/** primitive value decoded to host byte order */
+union AdsValue {
+    int64_t i;
+    uint64_t u;
+    double f;
+
+    /** STRING, WSTRING and BYTES refer into the decoded data, which has to outlive the value */
+    struct {
+        const uint8_t* data;
+        uint32_t length;
+    } bytes;
+};
+
+/** array of structures, whose elements share the fields of the first one */
+struct AdsDecodedArray {
+    std::vector<AdsDatatypeArrayInfo> dimensions;
+
+    /** distance between two elements in bytes */
+    uint32_t stride;
+
+    /** distance between two elements in AdsValues */
+    uint32_t slotStride;
+};
+
+/** primitive member of a flattened data type. An array of primitives is a single field with count elements. */
+struct AdsDecodedField {
+    /** e.g. "stInfo.nFlags" or "aItems[].sName", where "[]" stands for every element of arrays */
+    std::string path;
+    AdsValueKind kind;
+
+    /** of the first element of arrays */
+    uint32_t offset;
+
+    /** size of one element in bytes */
+    uint32_t width;
+    uint32_t count;
+
+    /** position of the first element in the AdsValues of a decoded element, see offset */
+    uint32_t slot;
+
+    /** one entry for each "[]" in path, the outermost first */
+    std::vector<AdsDecodedArray> arrays;
+};
+
+/**
+ * Flat decoding instructions for a data type of an AdsSymbolTable. Structures,
+ * arrays and aliases are resolved once, when the plan is compiled. Decoding a
+ * sample afterwards only walks an array of steps, which convert each primitive
+ * into a fixed slot of an AdsValue array, without allocations or lookups. The
+ * element type of an array of structures is compiled once and its steps are
+ * repeated with the size of an element as stride.
+ */
+struct AdsDecodePlan {
+    /** throws AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND), if typeName is unknown */
+    AdsDecodePlan(const AdsSymbolTable& symbols, const std::string& typeName);
+
+    /** size of one element of the data type in bytes */
+    uint32_t Size() const;
+
+    /** number of AdsValues one element is decoded into */
+    size_t NumSlots() const;
+
+    /** fields of arrays of structures are listed once, see AdsDecodedField::arrays */
+    const std::vector<AdsDecodedField>& Fields() const;
+
+    /**
+     * Paths are compared case insensitive. Indices of arrays of structures, e.g.
+     * "aItems[2].sName", select the offset and slot of that element.
+     * Throws AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND), if no field has this path
+     */
+    AdsDecodedField Field(const std::string& path) const;
+
+    /**
+     * Decode count consecutive elements, e.g. an array of structures, into values,
+     * which has to provide count * NumSlots() entries.
+     * Throws AdsException(ADSERR_DEVICE_INVALIDSIZE), if length is too short.
+     */
+    void Decode(const void* data, size_t length, AdsValue* values, size_t count = 1) const;
+
+    /**
+     * Decode the sample of a notification callback into values, which has to provide
+     * maxCount * NumSlots() entries.
+     * @return number of decoded elements
+     */
+    size_t Decode(const AdsNotificationHeader& notification, AdsValue* values, size_t maxCount = 1) const;
+
+private:
+    enum class Op : uint8_t {
+        INT8, INT16, INT32, INT64,
+        UINT8, UINT16, UINT32, UINT64,
+        REAL32, REAL64,
+        BYTES,
+
+        /** decode the following numSteps count times, width bytes and numSlots AdsValues apart */
+        REPEAT,
+    };
+
+    /** offset and slot of the steps repeated by a REPEAT are relative to the current element */
+    struct Step {
+        uint32_t offset;
+        uint32_t width;
+        uint32_t count;
+        uint32_t slot;
+        Op op;
+        uint32_t numSteps;
+        uint32_t numSlots;
+    };
+
+    uint32_t size;
+    size_t numSlots;
+    std::vector<Step> steps;
+    std::vector<AdsDecodedField> fields;
+
+    void Compile(const AdsSymbolTable& symbols, const std::string& typeName, uint32_t dataType, uint32_t typeSize,
+                 uint32_t offset, const std::string& path, size_t depth);
+    void Add(uint32_t dataType, uint32_t width, uint32_t count, uint32_t offset, const std::string& path);
+    static bool Fits(const Step* first, const Step* last, uint64_t size);
+    static void Decode(const Step* first, const Step* last, const uint8_t* element, AdsValue* values);
+};
@@ -16,6 +16,102 @@ bool operator<(const AmsAddr& lhs, const AmsAddr& rhs);
 std::ostream& operator<<(std::ostream& os, const AmsNetId& netId);
 AmsNetId make_AmsNetId(const std::string& addr);
 
+/**
+ * @brief Maximum number of sub commands the ADS server accepts in one sum request.
+ */
+static const uint32_t ADS_SUMUP_MAX_ITEMS = 500;
+
+/**
+ * @brief Maximum number of bytes written with one sum request. Larger batches are split,
+ * so the requests fit into the receive buffers of the AMS router of the target.
+ */
+static const uint32_t ADS_SUMUP_MAX_LENGTH = 1024 * 1024;
+
+/**
+ * @brief One variable of a sum read with AdsSyncSumReadReqEx().
+ */
+struct AdsReadItem {
+    uint32_t indexGroup;
+    uint32_t indexOffset;
+    uint32_t length;
+    void* buffer;
+};
+
+/**
+ * @brief One variable of a sum write with AdsSyncSumWriteReqEx().
+ */
+struct AdsWriteItem {
+    uint32_t indexGroup;
+    uint32_t indexOffset;
+    uint32_t length;
+    const void* buffer;
+};
+
+/**
+ * @brief One notification of a bulk registration with AdsSyncAddDeviceNotificationsReqEx().
+ */
+struct AdsNotificationItem {
+    uint32_t indexGroup;
+    uint32_t indexOffset;
+    AdsNotificationAttrib attrib;
+    PAdsNotificationFuncEx pFunc;
+    uint32_t hUser;
+};
+
+/**
+ * @brief One request of a sum read/write with AdsSyncSumReadWriteReqEx().
+ */
+struct AdsReadWriteItem {
+    uint32_t indexGroup;
+    uint32_t indexOffset;
+    uint32_t readLength;
+    void* readData;
+    uint32_t writeLength;
+    const void* writeData;
+};
+
+/**
+ * @brief What happens to received notifications, which don't fit into the notification buffer of a port anymore.
+ */
+enum ADSNOTIFICATIONOVERFLOW {
+    /** discard the frame, which was just received */
+    ADSOVERFLOW_DROPNEWEST = 0,
+
+    /** discard the oldest frames, which are still waiting to be dispatched, until the new one fits */
+    ADSOVERFLOW_DROPOLDEST = 1,
+
+    /** stop receiving from the target system, until the frame fits */
+    ADSOVERFLOW_BLOCK = 2,
+};
+
+/**
+ * @brief Which thread invokes the notification callbacks of a port, see AdsSyncSetNotificationDeliveryEx().
+ */
+enum ADSNOTIFICATIONDELIVERY {
+    /** received frames are buffered and dispatched by a separate thread */
+    ADSDELIVERY_QUEUED = 0,
+
+    /** the callbacks are invoked by the receiving thread, directly from the receive buffer */
+    ADSDELIVERY_DIRECT = 1,
+};
+
+/**
+ * @brief Counters of the notification buffer of a port for one target system, see AdsGetNotificationStatisticsEx().
+ */
+struct AdsNotificationStatistics {
+    /** number of AMS frames, which were discarded by the overflow policy */
+    uint64_t droppedFrames;
+
+    /** number of samples within the discarded frames */
+    uint64_t droppedSamples;
+
+    /** bytes currently waiting to be dispatched */
+    uint64_t pendingBytes;
+
+    /** highest number of bytes, which were waiting to be dispatched at the same time */
+    uint64_t peakBytes;
+};
+
 namespace bhf
 {
 namespace ads
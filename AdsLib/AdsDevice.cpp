@@ -6,20 +6,399 @@
 #include "AdsDevice.h"
 #include "AdsException.h"
 #include "AdsLib.h"
+#include "Log.h"
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <mutex>
 
-static AmsNetId* AddRoute(AmsNetId ams, const char* ip)
+static void CompleteRead(long status, uint32_t bytesRead, void* pUser)
 {
-    const auto error = bhf::ads::AddLocalRoute(ams, ip);
+    std::unique_ptr<std::promise<uint32_t> > promise { static_cast<std::promise<uint32_t>*>(pUser) };
+    if (status) {
+        promise->set_exception(std::make_exception_ptr(AdsException(status)));
+    } else {
+        promise->set_value(bytesRead);
+    }
+}
+
+static void CompleteWrite(long status, uint32_t, void* pUser)
+{
+    std::unique_ptr<std::promise<void> > promise { static_cast<std::promise<void>*>(pUser) };
+    if (status) {
+        promise->set_exception(std::make_exception_ptr(AdsException(status)));
+    } else {
+        promise->set_value();
+    }
+}
+
+static AmsNetId* AddRoute(AmsNetId ams, const char* ip, const SocketOptions& options, size_t numConnections)
+{
+    const auto error = bhf::ads::AddLocalRoute(ams, ip, options, numConnections);
     if (error) {
         throw AdsException(error);
     }
     return new AmsNetId {ams};
 }
 
-AdsDevice::AdsDevice(const std::string& ipV4, AmsNetId netId, uint16_t port)
-    : m_NetId(AddRoute(netId, ipV4.c_str()), {[](AmsNetId ams){bhf::ads::DelLocalRoute(ams); return 0; }}),
+/** @return the symbol handle of name in host byte order, throws an AdsException if it couldn't be acquired */
+static uint32_t AcquireHandle(const long port, const AmsAddr& addr, const std::string& name)
+{
+    uint32_t handle = 0;
+    uint32_t bytesRead = 0;
+    const auto error = AdsSyncReadWriteReqEx2(port, &addr,
+                                              ADSIGRP_SYM_HNDBYNAME, 0,
+                                              sizeof(handle), &handle,
+                                              name.size(),
+                                              name.c_str(),
+                                              &bytesRead);
+
+    if (error || (sizeof(handle) != bytesRead)) {
+        throw AdsException(error);
+    }
+    return bhf::ads::letoh(handle);
+}
+
+/**
+ * Acquire the symbol handles of names with one ADSIGRP_SUMUP_READWRITE. handles are in
+ * host byte order and results receives the error code of each symbol.
+ * @return error code of the whole transfer
+ */
+static long AcquireHandles(const long                      port,
+                           const AmsAddr&                  addr,
+                           const std::vector<std::string>& names,
+                           std::vector<uint32_t>&          handles,
+                           std::vector<long>&              results)
+{
+    handles.assign(names.size(), 0);
+    std::vector<AdsReadWriteItem> items;
+    items.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        items.push_back(AdsReadWriteItem {
+            ADSIGRP_SYM_HNDBYNAME, 0,
+            sizeof(handles[i]), &handles[i],
+            static_cast<uint32_t>(names[i].size()), names[i].c_str()
+        });
+    }
+
+    results.assign(items.size(), 0);
+    std::vector<uint32_t> bytesRead(items.size());
+    const auto error = AdsSyncSumReadWriteReqEx(port, &addr, items.size(), items.data(),
+                                                results.data(), bytesRead.data());
+    if (error) {
+        return error;
+    }
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (!results[i] && (sizeof(handles[i]) != bytesRead[i])) {
+            results[i] = ADSERR_DEVICE_INVALIDSIZE;
+        }
+        handles[i] = bhf::ads::letoh(handles[i]);
+    }
+    return 0;
+}
+
+/** symbol names are case insensitive */
+struct LessNoCase {
+    bool operator()(const std::string& lhs, const std::string& rhs) const
+    {
+        return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                                            [](const char a, const char b) {
+            return std::tolower(static_cast<unsigned char>(a)) < std::tolower(static_cast<unsigned char>(b));
+        });
+    }
+};
+
+/**
+ * Symbol handles of an AdsDevice by name. Every change of ADSIGRP_SYM_VERSION
+ * increments generation, which invalidates all handles acquired before.
+ * The cache shares the route and local port of the device instead of referring
+ * to the device itself, as it might be moved or destroyed before the last handle.
+ */
+struct AdsHandleCache {
+    AdsHandleCache(const std::shared_ptr<const AmsNetId>& __route,
+                   const std::shared_ptr<const long>&     __port,
+                   const AmsAddr&                         __addr)
+        : route(__route),
+        port(__port),
+        addr(__addr),
+        generation(0),
+        symbolVersion(UNKNOWN_VERSION),
+        id(0),
+        hNotify(0)
+    {}
+
+    ~AdsHandleCache()
+    {
+        if (!id) {
+            return;
+        }
+
+        /* after the cache left the registry, callbacks can't reach it anymore */
+        {
+            std::lock_guard<std::mutex> lock(Registry().mutex);
+            Registry().caches.erase(id);
+        }
+        if (hNotify) {
+            AdsSyncDelDeviceNotificationReqEx(*port, &addr, hNotify);
+        }
+    }
+
+    std::shared_ptr<AdsSharedHandle> Get(const std::shared_ptr<AdsHandleCache>& self, const std::string& name)
+    {
+        std::call_once(subscribed, &AdsHandleCache::Subscribe, this);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = handles.find(name);
+            if (it != handles.end()) {
+                auto shared = it->second.lock();
+                if (shared) {
+                    return shared;
+                }
+            }
+        }
+
+        /* the round trip runs unlocked, so lookups of other names don't wait for it */
+        const auto current = generation.load();
+        const auto handle = AcquireHandle(*port, addr, name);
+
+        std::shared_ptr<AdsSharedHandle> shared;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& cached = handles[name];
+            shared = cached.lock();
+            if (!shared) {
+                shared = std::make_shared<AdsSharedHandle>(self, name, handle, current);
+                cached = shared;
+                return shared;
+            }
+        }
+
+        /* a handle, which lost the race, is released after unlocking */
+        const uint32_t value = bhf::ads::htole(handle);
+        AdsSyncWriteReqEx(*port, &addr, ADSIGRP_SYM_RELEASEHND, 0, sizeof(value), &value);
+        return shared;
+    }
+
+    /**
+     * Acquire all invalidated handles again and release the old ones, both in bulk.
+     * @return error code of requester, if its handle couldn't be acquired again
+     */
+    long Refresh(const AdsSharedHandle& requester)
+    {
+        /* destroyed after the locks are released, as the last reference might be among them */
+        std::vector<std::shared_ptr<AdsSharedHandle> > stale;
+
+        /* concurrent refreshes are merged into one, lookups only wait for the snapshot of the handles */
+        std::lock_guard<std::mutex> refreshLock(refreshing);
+        const auto current = generation.load();
+        if (requester.generation == current) {
+            return 0;
+        }
+
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& cached : handles) {
+                auto shared = cached.second.lock();
+                if (shared && (shared->generation != current)) {
+                    names.push_back(shared->name);
+                    stale.push_back(std::move(shared));
+                }
+            }
+        }
+
+        std::vector<uint32_t> fresh;
+        std::vector<long> errors;
+        const auto error = AcquireHandles(*port, addr, names, fresh, errors);
+        if (error) {
+            throw AdsException(error);
+        }
+        std::vector<uint32_t> old;
+        long result = 0;
+        for (size_t i = 0; i < stale.size(); ++i) {
+            old.push_back(bhf::ads::htole(stale[i]->handle.load()));
+            /* the online change might have changed the type of the symbol, too */
+            stale[i]->size = 0;
+            if (errors[i]) {
+                stale[i]->handle = 0;
+                if (stale[i].get() == &requester) {
+                    result = errors[i];
+                }
+                continue;
+            }
+            stale[i]->handle = fresh[i];
+            stale[i]->generation = current;
+        }
+
+        /* after a download the old handles are gone already, so errors are expected */
+        std::vector<AdsWriteItem> items;
+        for (const auto& value : old) {
+            if (value) {
+                items.push_back(AdsWriteItem { ADSIGRP_SYM_RELEASEHND, 0, sizeof(value), &value });
+            }
+        }
+        std::vector<long> ignored(items.size());
+        AdsSyncSumWriteReqEx(*port, &addr, items.size(), items.data(), ignored.data());
+        return result;
+    }
+
+    /** called by the destructor of the last reference to handle */
+    void Release(const AdsSharedHandle& handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const auto it = handles.find(handle.name);
+            if ((it != handles.end()) && it->second.expired()) {
+                handles.erase(it);
+            }
+        }
+        const uint32_t value = bhf::ads::htole(handle.handle.load());
+        if (value) {
+            AdsSyncWriteReqEx(*port, &addr, ADSIGRP_SYM_RELEASEHND, 0, sizeof(value), &value);
+        }
+    }
+
+    /** declared before port, so the route is deleted after the port and its notifications are closed */
+    const std::shared_ptr<const AmsNetId> route;
+    const std::shared_ptr<const long> port;
+    const AmsAddr addr;
+    std::atomic<uint32_t> generation;
+private:
+    static const uint32_t UNKNOWN_VERSION = 0xFFFFFFFF;
+
+    /** maps the hUser of ADSIGRP_SYM_VERSION notifications to their cache */
+    struct CacheRegistry {
+        std::mutex mutex;
+        std::map<uint32_t, AdsHandleCache*> caches;
+        uint32_t nextId = 1;
+    };
+
+    /** never destroyed, as static AdsDevices might outlive it otherwise */
+    static CacheRegistry& Registry()
+    {
+        static CacheRegistry* const registry = new CacheRegistry;
+        return *registry;
+    }
+
+    static void OnSymbolVersion(const AmsAddr*, const AdsNotificationHeader* pNotification, const uint32_t hUser)
+    {
+        if (pNotification->cbSampleSize < 1) {
+            return;
+        }
+        const uint32_t version = *reinterpret_cast<const uint8_t*>(pNotification + 1);
+
+        std::lock_guard<std::mutex> lock(Registry().mutex);
+        const auto it = Registry().caches.find(hUser);
+        if (it == Registry().caches.end()) {
+            return;
+        }
+        /* the first notification only provides the initial version */
+        const auto previous = it->second->symbolVersion.exchange(version);
+        if ((UNKNOWN_VERSION != previous) && (previous != version)) {
+            ++it->second->generation;
+        }
+    }
+
+    void Subscribe()
+    {
+        /* handles acquired before the first notification arrives, have to be invalidated by it, too */
+        uint8_t version = 0;
+        uint32_t bytesRead = 0;
+        if (!AdsSyncReadReqEx2(*port, &addr, ADSIGRP_SYM_VERSION, 0, sizeof(version), &version, &bytesRead) &&
+            (sizeof(version) == bytesRead)) {
+            symbolVersion = version;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(Registry().mutex);
+            id = Registry().nextId++;
+            Registry().caches[id] = this;
+        }
+
+        const AdsNotificationAttrib attrib = { 1, ADSTRANS_SERVERONCHA, 0, {0} };
+        const auto error = AdsSyncAddDeviceNotificationReqEx(*port, &addr,
+                                                             ADSIGRP_SYM_VERSION, 0, &attrib,
+                                                             &AdsHandleCache::OnSymbolVersion, id, &hNotify);
+        if (error) {
+            /* handles are still acquired again, when a request fails with ADSERR_DEVICE_SYMBOLVERSIONINVALID */
+            LOG_WARN("Subscribing to the symbol version failed with: 0x" << std::hex << error);
+            hNotify = 0;
+        }
+    }
+
+    std::atomic<uint32_t> symbolVersion;
+    std::once_flag subscribed;
+
+    /** guards handles */
+    std::mutex mutex;
+
+    /** serializes Refresh() */
+    std::mutex refreshing;
+    std::map<std::string, std::weak_ptr<AdsSharedHandle>, LessNoCase> handles;
+    uint32_t id;
+    uint32_t hNotify;
+};
+
+AdsSharedHandle::AdsSharedHandle(const std::shared_ptr<AdsHandleCache>& __cache,
+                                 const std::string&                     __name,
+                                 const uint32_t                         __handle,
+                                 const uint32_t                         __generation)
+    : name(__name),
+    cache(__cache),
+    handle(__handle),
+    generation(__generation),
+    size(0)
+{}
+
+AdsSharedHandle::~AdsSharedHandle()
+{
+    cache->Release(*this);
+}
+
+uint32_t AdsSharedHandle::Get() const
+{
+    if (generation != cache->generation) {
+        const auto error = cache->Refresh(*this);
+        if (error) {
+            throw AdsException(error);
+        }
+    }
+    return handle;
+}
+
+void AdsSharedHandle::Invalidate() const
+{
+    ++cache->generation;
+}
+
+uint32_t AdsSharedHandle::Size() const
+{
+    const auto cached = size.load();
+    if (cached) {
+        return cached;
+    }
+
+    AdsSymbolInfoByName info;
+    uint32_t bytesRead = 0;
+    const auto error = AdsSyncReadWriteReqEx2(*cache->port, &cache->addr, ADSIGRP_SYM_INFOBYNAME, 0,
+                                              sizeof(info), &info, name.size(), name.c_str(), &bytesRead);
+    if (error || (sizeof(info) != bytesRead)) {
+        throw AdsException(error);
+    }
+    size = bhf::ads::letoh(info.cbLength);
+    return size;
+}
+
+AdsDevice::AdsDevice(const std::string&   ipV4,
+                     AmsNetId             netId,
+                     uint16_t             port,
+                     const SocketOptions& options,
+                     size_t               numConnections)
+    : m_NetId(AddRoute(netId, ipV4.c_str(), options, numConnections),
+              ResourceDeleter<const AmsNetId> {[](AmsNetId ams){bhf::ads::DelLocalRoute(ams); return 0; }}),
     m_Addr({netId, port}),
-    m_LocalPort(new long { AdsPortOpenEx() }, {AdsPortCloseEx})
+    m_LocalPort(new long { AdsPortOpenEx() }, ResourceDeleter<const long> {AdsPortCloseEx}),
+    m_HandleCache(std::make_shared<AdsHandleCache>(m_NetId, m_LocalPort, m_Addr))
 {}
 
 long AdsDevice::DeleteNotificationHandle(uint32_t handle) const
@@ -61,22 +440,69 @@ AdsHandle AdsDevice::GetHandle(const uint32_t offset) const
 
 AdsHandle AdsDevice::GetHandle(const std::string& symbolName) const
 {
-    uint32_t handle = 0;
-    uint32_t bytesRead = 0;
-    uint32_t error = ReadWriteReqEx2(
-        ADSIGRP_SYM_HNDBYNAME, 0,
-        sizeof(handle), &handle,
-        symbolName.size(),
-        symbolName.c_str(),
-        &bytesRead
-        );
+    const auto handle = AcquireHandle(GetLocalPort(), m_Addr, symbolName);
+    return {new uint32_t {handle}, {std::bind(&AdsDevice::DeleteSymbolHandle, this, std::placeholders::_1), this}};
+}
 
-    if (error || (sizeof(handle) != bytesRead)) {
+std::shared_ptr<AdsSharedHandle> AdsDevice::GetSharedHandle(const std::string& symbolName) const
+{
+    return m_HandleCache->Get(m_HandleCache, symbolName);
+}
+
+std::vector<AdsHandle> AdsDevice::GetHandles(const std::vector<std::string>& symbolNames,
+                                             std::vector<long>*              errors) const
+{
+    std::vector<uint32_t> handles;
+    std::vector<long> results;
+    const auto error = AcquireHandles(GetLocalPort(), m_Addr, symbolNames, handles, results);
+    if (error) {
         throw AdsException(error);
     }
 
-    handle = bhf::ads::letoh(handle);
-    return {new uint32_t {handle}, {std::bind(&AdsDevice::DeleteSymbolHandle, this, std::placeholders::_1)}};
+    std::vector<AdsHandle> symbols;
+    symbols.reserve(handles.size());
+    for (size_t i = 0; i < handles.size(); ++i) {
+        if (results[i]) {
+            symbols.emplace_back(nullptr, ResourceDeleter<uint32_t> {[](uint32_t){ return 0; }});
+        } else {
+            symbols.emplace_back(new uint32_t {handles[i]},
+                                 ResourceDeleter<uint32_t> {std::bind(&AdsDevice::DeleteSymbolHandle, this,
+                                                                      std::placeholders::_1), this});
+        }
+    }
+
+    if (errors) {
+        *errors = std::move(results);
+    } else {
+        for (const auto& result : results) {
+            if (result) {
+                /* the handles acquired so far are released in bulk, before we give up */
+                ReleaseHandles(symbols);
+                throw AdsException(result);
+            }
+        }
+    }
+    return symbols;
+}
+
+long AdsDevice::ReleaseHandles(std::vector<AdsHandle>& handles) const
+{
+    std::vector<uint32_t> values;
+    for (auto& handle : handles) {
+        if (handle && (handle.get_deleter().owner == this)) {
+            std::unique_ptr<uint32_t> value { handle.release() };
+            values.push_back(bhf::ads::htole(*value));
+        }
+        handle.reset();
+    }
+
+    std::vector<AdsWriteItem> items;
+    items.reserve(values.size());
+    for (const auto& value : values) {
+        items.push_back(AdsWriteItem { ADSIGRP_SYM_RELEASEHND, 0, sizeof(value), &value });
+    }
+    std::vector<long> errors(items.size());
+    return AdsSyncSumWriteReqEx(GetLocalPort(), &m_Addr, items.size(), items.data(), errors.data());
 }
 
 AdsHandle AdsDevice::GetHandle(const uint32_t               indexGroup,
@@ -146,6 +572,14 @@ void AdsDevice::SetTimeout(const uint32_t timeout) const
     }
 }
 
+void AdsDevice::SetCoalescing(const bool enable, const uint32_t window) const
+{
+    const auto error = AdsSyncSetCoalescingEx(GetLocalPort(), enable, window);
+    if (error) {
+        throw AdsException(error);
+    }
+}
+
 uint32_t AdsDevice::GetTimeout() const
 {
     uint32_t timeout = 0;
@@ -201,3 +635,51 @@ long AdsDevice::WriteReqEx(uint32_t group, uint32_t offset, uint32_t length, con
 {
     return AdsSyncWriteReqEx(GetLocalPort(), &m_Addr, group, offset, length, buffer);
 }
+
+std::vector<long> AdsDevice::ReadMulti(const std::vector<AdsReadItem>& items) const
+{
+    std::vector<long> errors(items.size());
+    const auto error = AdsSyncSumReadReqEx(GetLocalPort(), &m_Addr, items.size(), items.data(), errors.data());
+    if (error) {
+        throw AdsException(error);
+    }
+    return errors;
+}
+
+std::vector<long> AdsDevice::WriteMulti(const std::vector<AdsWriteItem>& items) const
+{
+    std::vector<long> errors(items.size());
+    const auto error = AdsSyncSumWriteReqEx(GetLocalPort(), &m_Addr, items.size(), items.data(), errors.data());
+    if (error) {
+        throw AdsException(error);
+    }
+    return errors;
+}
+
+std::future<uint32_t> AdsDevice::ReadAsync(uint32_t group, uint32_t offset, uint32_t length, void* buffer) const
+{
+    /* ownership of promise is passed to CompleteRead(), as soon as the request was accepted */
+    auto promise = new std::promise<uint32_t>;
+    auto future = promise->get_future();
+    const auto error = AdsAsyncReadReqEx2(GetLocalPort(), &m_Addr, group, offset, length, buffer, &CompleteRead,
+                                          promise);
+    if (error) {
+        delete promise;
+        throw AdsException(error);
+    }
+    return future;
+}
+
+std::future<void> AdsDevice::WriteAsync(uint32_t group, uint32_t offset, uint32_t length, const void* buffer) const
+{
+    /* ownership of promise is passed to CompleteWrite(), as soon as the request was accepted */
+    auto promise = new std::promise<void>;
+    auto future = promise->get_future();
+    const auto error = AdsAsyncWriteReqEx(GetLocalPort(), &m_Addr, group, offset, length, buffer, &CompleteWrite,
+                                          promise);
+    if (error) {
+        delete promise;
+        throw AdsException(error);
+    }
+    return future;
+}
@@ -6,10 +6,14 @@
 #pragma once
 #include "AdsException.h"
 #include "AdsDef.h"
+#include "Sockets.h"
 #include "wrap_endian.h"
+#include <atomic>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
+#include <vector>
 
 /**
  * @brief Maximum size for device name.
@@ -34,8 +38,9 @@ struct AdsDeviceState {
 
 template<class T>
 struct ResourceDeleter {
-    ResourceDeleter(const std::function<long(T)> func)
-        : FreeResource(func)
+    ResourceDeleter(const std::function<long(T)> func, const void* __owner = nullptr)
+        : owner(__owner),
+        FreeResource(func)
     {}
 
     void operator()(T* resource) noexcept
@@ -43,6 +48,9 @@ struct ResourceDeleter {
         FreeResource(*resource);
         delete resource;
     }
+
+    /** resources with the same owner can be released together, nullptr if they can't */
+    const void* const owner;
 private:
     const std::function<long(T)> FreeResource;
 };
@@ -51,8 +59,55 @@ using AdsResource = std::unique_ptr<T, ResourceDeleter<T> >;
 
 using AdsHandle = AdsResource<uint32_t>;
 
+struct AdsHandleCache;
+
+/**
+ * Symbol handle, which is shared by all users of the same symbol name on an
+ * AdsDevice, see AdsDevice::GetSharedHandle(). The handle is released together
+ * with the last reference.
+ */
+struct AdsSharedHandle {
+    AdsSharedHandle(const std::shared_ptr<AdsHandleCache>& cache, const std::string& name, uint32_t handle,
+                    uint32_t generation);
+    ~AdsSharedHandle();
+    AdsSharedHandle(const AdsSharedHandle&) = delete;
+    AdsSharedHandle& operator=(const AdsSharedHandle&) = delete;
+
+    /**
+     * @return the current value of the handle. If an online change invalidated the handle, it is
+     * acquired again together with all other invalidated handles of the device, before it is returned.
+     */
+    uint32_t Get() const;
+
+    /**
+     * Invalidate all handles of the device, e.g. after a request failed with
+     * ADSERR_DEVICE_SYMBOLVERSIONINVALID before the change of the symbol version was notified.
+     */
+    void Invalidate() const;
+
+    /**
+     * @return the size of the symbol in bytes. It is read by ADSIGRP_SYM_INFOBYNAME on first
+     * use and cached, until an online change invalidates the handle.
+     */
+    uint32_t Size() const;
+
+    const std::string name;
+private:
+    friend struct AdsHandleCache;
+    const std::shared_ptr<AdsHandleCache> cache;
+    std::atomic<uint32_t> handle;
+
+    /** handle is valid as long as this matches the generation of the cache */
+    std::atomic<uint32_t> generation;
+
+    /** 0 until Size() was called the first time */
+    mutable std::atomic<uint32_t> size;
+};
+
 struct AdsDevice {
-    AdsDevice(const std::string& ipV4, AmsNetId netId, uint16_t port);
+    AdsDevice(const std::string& ipV4, AmsNetId netId, uint16_t port,
+              const SocketOptions& options = SocketOptions {},
+              size_t numConnections = 1);
 
     DeviceInfo GetDeviceInfo() const;
 
@@ -62,6 +117,27 @@ struct AdsDevice {
     /** Get handle for access by symbol name */
     AdsHandle GetHandle(const std::string& symbolName) const;
 
+    /**
+     * Get a handle for access by symbol name from the handle cache of this device. All callers
+     * share one handle per symbol name, so only the first one pays a round trip. The device
+     * subscribes to ADSIGRP_SYM_VERSION and acquires cached handles again after an online change.
+     */
+    std::shared_ptr<AdsSharedHandle> GetSharedHandle(const std::string& symbolName) const;
+
+    /**
+     * Get handles for many symbols with as few round trips as possible (ADSIGRP_SUMUP_READWRITE).
+     * If errors is nullptr an AdsException is thrown, if any symbol was not found. Otherwise
+     * the error code of each symbol is stored in errors and the handles of failed symbols are empty.
+     */
+    std::vector<AdsHandle> GetHandles(const std::vector<std::string>& symbolNames,
+                                      std::vector<long>*              errors = nullptr) const;
+
+    /**
+     * Release the symbol handles of this device with as few round trips as possible. Other
+     * handles are released one by one as usual. All handles are empty afterwards.
+     */
+    long ReleaseHandles(std::vector<AdsHandle>& handles) const;
+
     /** Get notification handle */
     AdsHandle GetHandle(uint32_t                     indexGroup,
                         uint32_t                     indexOffset,
@@ -80,6 +156,12 @@ struct AdsDevice {
     uint32_t GetTimeout() const;
     void SetTimeout(const uint32_t timeout) const;
 
+    /**
+     * Merge concurrent reads and writes of several threads on this device into sum
+     * commands, see AdsSyncSetCoalescingEx()
+     */
+    void SetCoalescing(bool enable, uint32_t window = 0) const;
+
     long ReadReqEx2(uint32_t group, uint32_t offset, uint32_t length, void* buffer, uint32_t* bytesRead) const;
     long ReadWriteReqEx2(uint32_t    indexGroup,
                          uint32_t    indexOffset,
@@ -90,10 +172,34 @@ struct AdsDevice {
                          uint32_t*   bytesRead) const;
     long WriteReqEx(uint32_t group, uint32_t offset, uint32_t length, const void* buffer) const;
 
-    AdsResource<const AmsNetId> m_NetId;
+    /**
+     * Read many variables with as few round trips as possible (ADSIGRP_SUMUP_READ).
+     * Throws an AdsException if the transfer failed, otherwise the error code of each item is returned.
+     */
+    std::vector<long> ReadMulti(const std::vector<AdsReadItem>& items) const;
+
+    /**
+     * Write many variables with as few round trips as possible (ADSIGRP_SUMUP_WRITE).
+     * Throws an AdsException if the transfer failed, otherwise the error code of each item is returned.
+     */
+    std::vector<long> WriteMulti(const std::vector<AdsWriteItem>& items) const;
+
+    /**
+     * Read without blocking. buffer has to stay valid until the future is ready.
+     * The future provides the number of bytes read or throws an AdsException.
+     */
+    std::future<uint32_t> ReadAsync(uint32_t group, uint32_t offset, uint32_t length, void* buffer) const;
+
+    /** Write without blocking. The future throws an AdsException if the request failed. */
+    std::future<void> WriteAsync(uint32_t group, uint32_t offset, uint32_t length, const void* buffer) const;
+
+    /** shared with the handle cache, which might outlive a moved or destroyed device */
+    std::shared_ptr<const AmsNetId> m_NetId;
     const AmsAddr m_Addr;
 private:
-    AdsResource<const long> m_LocalPort;
+    /** shared with the handle cache, too. The route is only deleted after the port was closed */
+    std::shared_ptr<const long> m_LocalPort;
+    const std::shared_ptr<AdsHandleCache> m_HandleCache;
     long CloseFile(uint32_t handle) const;
     long DeleteNotificationHandle(uint32_t handle) const;
     long DeleteSymbolHandle(uint32_t handle) const;
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "wrap_endian.h"
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Describes the PLC layout of a C++ struct as a compile-time list of its members.
+ * The PLC data is expected to be packed in the order of the list. Specialize it
+ * for every struct, which should be converted field by field:
+ *
+ *   template<>
+ *   struct AdsLayout<ST_LibVersion> {
+ *       using Fields = AdsFields<ADS_FIELD(ST_LibVersion, iMajor), ADS_FIELD(ST_LibVersion, iMinor)>;
+ *   };
+ */
+template<typename T>
+struct AdsLayout {};
+
+template<typename S, typename M, M S::* member>
+struct AdsField {
+    using Type = M;
+
+    static M& Get(S& object)
+    {
+        return object.*member;
+    }
+
+    static const M& Get(const S& object)
+    {
+        return object.*member;
+    }
+};
+
+#define ADS_FIELD(STRUCT, MEMBER) AdsField<STRUCT, decltype(STRUCT::MEMBER), &STRUCT::MEMBER>
+
+/**
+ * Converts between the little endian PLC representation of T and T. Types without
+ * an AdsLayout are copied as they are, arithmetic types and arrays of them are
+ * converted in place.
+ */
+template<typename T, typename Enable = void>
+struct AdsCodec {
+    /** T is described by an AdsLayout */
+    static constexpr bool Described() { return false; }
+
+    /** the PLC representation has the layout of T, only the byte order might differ */
+    static constexpr bool InPlace() { return true; }
+
+    /** of the PLC representation in bytes */
+    static constexpr size_t Size() { return sizeof(T); }
+
+    static void ToHost(T&) {}
+    static void Decode(const uint8_t* data, T& value)
+    {
+        memcpy(&value, data, sizeof(value));
+    }
+
+    static void Encode(const T& value, uint8_t* data)
+    {
+        memcpy(data, &value, sizeof(value));
+    }
+};
+
+template<typename T>
+struct AdsCodec<T, typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type> {
+    static constexpr bool Described() { return false; }
+    static constexpr bool InPlace() { return true; }
+    static constexpr size_t Size() { return sizeof(T); }
+
+    static void ToHost(T& value)
+    {
+        bhf::ads::letoh(&value, &value, 1);
+    }
+
+    static void Decode(const uint8_t* data, T& value)
+    {
+        bhf::ads::letoh(&value, data, 1);
+    }
+
+    static void Encode(const T& value, uint8_t* data)
+    {
+        bhf::ads::htole(data, &value, 1);
+    }
+};
+
+/** arrays of arithmetic types are converted in bulk */
+template<typename U, size_t N>
+struct AdsArrayCodec {
+    using Element = AdsCodec<U>;
+    using Bulk = std::integral_constant<bool, std::is_arithmetic<U>::value || std::is_enum<U>::value>;
+    static constexpr bool Described() { return Element::Described(); }
+    static constexpr bool InPlace() { return Element::InPlace(); }
+    static constexpr size_t Size() { return N * Element::Size(); }
+
+    static void ToHost(U* values)
+    {
+        ToHost(values, Bulk {});
+    }
+
+    static void Decode(const uint8_t* data, U* values)
+    {
+        Decode(data, values, Bulk {});
+    }
+
+    static void Encode(const U* values, uint8_t* data)
+    {
+        Encode(values, data, Bulk {});
+    }
+
+private:
+    static void ToHost(U* values, std::true_type)
+    {
+        bhf::ads::letoh(values, values, N);
+    }
+
+    static void ToHost(U* values, std::false_type)
+    {
+        for (size_t i = 0; i < N; ++i) {
+            Element::ToHost(values[i]);
+        }
+    }
+
+    static void Decode(const uint8_t* data, U* values, std::true_type)
+    {
+        bhf::ads::letoh(values, data, N);
+    }
+
+    static void Decode(const uint8_t* data, U* values, std::false_type)
+    {
+        for (size_t i = 0; i < N; ++i) {
+            Element::Decode(data + i * Element::Size(), values[i]);
+        }
+    }
+
+    static void Encode(const U* values, uint8_t* data, std::true_type)
+    {
+        bhf::ads::htole(data, values, N);
+    }
+
+    static void Encode(const U* values, uint8_t* data, std::false_type)
+    {
+        for (size_t i = 0; i < N; ++i) {
+            Element::Encode(values[i], data + i * Element::Size());
+        }
+    }
+};
+
+template<typename U, size_t N>
+struct AdsCodec<std::array<U, N>, void> {
+    using Array = AdsArrayCodec<U, N>;
+    static constexpr bool Described() { return Array::Described(); }
+    static constexpr bool InPlace() { return Array::InPlace(); }
+    static constexpr size_t Size() { return Array::Size(); }
+
+    static void ToHost(std::array<U, N>& value)
+    {
+        Array::ToHost(value.data());
+    }
+
+    static void Decode(const uint8_t* data, std::array<U, N>& value)
+    {
+        Array::Decode(data, value.data());
+    }
+
+    static void Encode(const std::array<U, N>& value, uint8_t* data)
+    {
+        Array::Encode(value.data(), data);
+    }
+};
+
+template<typename U, size_t N>
+struct AdsCodec<U[N], void> {
+    using Array = AdsArrayCodec<U, N>;
+    static constexpr bool Described() { return Array::Described(); }
+    static constexpr bool InPlace() { return Array::InPlace(); }
+    static constexpr size_t Size() { return Array::Size(); }
+
+    static void ToHost(U (& value)[N])
+    {
+        Array::ToHost(value);
+    }
+
+    static void Decode(const uint8_t* data, U (& value)[N])
+    {
+        Array::Decode(data, value);
+    }
+
+    static void Encode(const U (& value)[N], uint8_t* data)
+    {
+        Array::Encode(value, data);
+    }
+};
+
+template<typename... Fields>
+struct AdsFields;
+
+template<>
+struct AdsFields<> {
+    static constexpr size_t Size() { return 0; }
+
+    template<typename S>
+    static void Decode(const uint8_t*, S&) {}
+
+    template<typename S>
+    static void Encode(const S&, uint8_t*) {}
+};
+
+template<typename First, typename ... Rest>
+struct AdsFields<First, Rest...> {
+    using Codec = AdsCodec<typename First::Type>;
+
+    static constexpr size_t Size() { return Codec::Size() + AdsFields<Rest...>::Size(); }
+
+    template<typename S>
+    static void Decode(const uint8_t* data, S& object)
+    {
+        Codec::Decode(data, First::Get(object));
+        AdsFields<Rest...>::Decode(data + Codec::Size(), object);
+    }
+
+    template<typename S>
+    static void Encode(const S& object, uint8_t* data)
+    {
+        Codec::Encode(First::Get(object), data);
+        AdsFields<Rest...>::Encode(object, data + Codec::Size());
+    }
+};
+
+template<typename T>
+struct AdsVoid {
+    using type = void;
+};
+
+/** structs with an AdsLayout are converted field by field, the code is generated from the field list */
+template<typename T>
+struct AdsCodec<T, typename AdsVoid<typename AdsLayout<T>::Fields>::type> {
+    using Fields = typename AdsLayout<T>::Fields;
+    static constexpr bool Described() { return true; }
+    static constexpr bool InPlace() { return false; }
+    static constexpr size_t Size() { return Fields::Size(); }
+
+    static void ToHost(T&) {}
+    static void Decode(const uint8_t* data, T& value)
+    {
+        Fields::Decode(data, value);
+    }
+
+    static void Encode(const T& value, uint8_t* data)
+    {
+        Fields::Encode(value, data);
+    }
+};
@@ -10,7 +10,10 @@
 #include "standalone/AdsLib.h"
 #endif
 
+#include "AdsDef.h"
 #include "Sockets.h"
+#include <utility>
+#include <vector>
 
 /**
  * Reads data synchronously from an ADS server.
@@ -91,6 +94,135 @@ long AdsSyncWriteReqEx(long           port,
                        uint32_t       bufferLength,
                        const void*    buffer);
 
+/**
+ * Reads many variables synchronously from an ADS server. The items are packed into
+ * ADSIGRP_SUMUP_READ requests of up to ADS_SUMUP_MAX_ITEMS items and ADS_SUMUP_MAX_LENGTH
+ * bytes of response, so only one round trip per request is required instead of one per item.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] numItems number of elements in items and errors
+ * @param[in,out] items variables to read, the data of each item is written to its buffer.
+ * @param[out] errors [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each item
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the transfer, the items are only valid if this is 0
+ */
+long AdsSyncSumReadReqEx(long               port,
+                         const AmsAddr*     pAddr,
+                         uint32_t           numItems,
+                         const AdsReadItem* items,
+                         long*              errors);
+
+/**
+ * Writes many variables synchronously to an ADS server. The items are packed into
+ * ADSIGRP_SUMUP_WRITE requests of up to ADS_SUMUP_MAX_ITEMS items and ADS_SUMUP_MAX_LENGTH
+ * bytes. The data is sent directly from the buffers of the items.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] numItems number of elements in items and errors
+ * @param[in] items variables to write
+ * @param[out] errors [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each item
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the transfer, the items are only valid if this is 0
+ */
+long AdsSyncSumWriteReqEx(long                port,
+                          const AmsAddr*      pAddr,
+                          uint32_t            numItems,
+                          const AdsWriteItem* items,
+                          long*               errors);
+
+/**
+ * Writes data of many requests synchronously into an ADS server and receives data back
+ * from the ADS server. The items are packed into ADSIGRP_SUMUP_READWRITE requests of up
+ * to ADS_SUMUP_MAX_ITEMS items and ADS_SUMUP_MAX_LENGTH bytes in each direction.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] numItems number of elements in items, errors and bytesRead
+ * @param[in,out] items requests, the data received for each item is written to its readData.
+ * @param[out] errors [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each item
+ * @param[out] bytesRead number of bytes received for each item, can be nullptr
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the transfer, the items are only valid if this is 0
+ */
+long AdsSyncSumReadWriteReqEx(long                    port,
+                              const AmsAddr*          pAddr,
+                              uint32_t                numItems,
+                              const AdsReadWriteItem* items,
+                              long*                   errors,
+                              uint32_t*               bytesRead);
+
+/**
+ * Reads data asynchronously from an ADS server. The function returns as soon as the
+ * request was sent. buffer has to stay valid until pFunc was called. If the response
+ * arrives while the request is still being sent, pFunc is called by the calling thread
+ * before this function returns.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data in bytes.
+ * @param[out] buffer Pointer to a data buffer that will receive the data.
+ * @param[in] pFunc callback, which is called exactly once with the result, if the request was sent successfully.
+ * @param[in] pUser custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), pFunc is not called if an error is returned
+ */
+long AdsAsyncReadReqEx2(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        void*                buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser);
+
+/**
+ * Writes data into an ADS server and receives data back asynchronously. The function
+ * returns as soon as the request was sent. readData has to stay valid until pFunc was called.
+ * If the response arrives while the request is still being sent, pFunc is called by the
+ * calling thread before this function returns.
+ * @param[in] port  port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] readLength Length, in bytes, of the read buffer readData.
+ * @param[out] readData Buffer for data read from the ADS server.
+ * @param[in] writeLength Length of the data, in bytes, send to the ADS server.
+ * @param[in] writeData Buffer with data send to the ADS server.
+ * @param[in] pFunc callback, which is called exactly once with the result, if the request was sent successfully.
+ * @param[in] pUser custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), pFunc is not called if an error is returned
+ */
+long AdsAsyncReadWriteReqEx2(long                 port,
+                             const AmsAddr*       pAddr,
+                             uint32_t             indexGroup,
+                             uint32_t             indexOffset,
+                             uint32_t             readLength,
+                             void*                readData,
+                             uint32_t             writeLength,
+                             const void*          writeData,
+                             PAdsCompletionFuncEx pFunc,
+                             void*                pUser);
+
+/**
+ * Writes data asynchronously to an ADS server. The function returns as soon as the
+ * request was sent, buffer can be reused afterwards. If the response arrives while the
+ * request is still being sent, pFunc is called by the calling thread before this
+ * function returns.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] bufferLength Length of the data, in bytes, send to the ADS server.
+ * @param[in] buffer Buffer with data send to the ADS server.
+ * @param[in] pFunc callback, which is called exactly once with the result, if the request was sent successfully.
+ * @param[in] pUser custom pointer passed to pFunc
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469), pFunc is not called if an error is returned
+ */
+long AdsAsyncWriteReqEx(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        const void*          buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser);
+
 /**
  * Changes the ADS status and the device status of an ADS server.
  * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
@@ -131,6 +263,25 @@ long AdsSyncAddDeviceNotificationReqEx(long                         port,
                                        uint32_t                     hUser,
                                        uint32_t*                    pNotification);
 
+/**
+ * Registers many notifications with as few round trips as possible. The items are packed
+ * into ADSIGRP_SUMUP_ADDDEVNOTE requests of up to ADS_SUMUP_MAX_ITEMS items. If one of these
+ * requests fails, the notifications registered by the requests before are deleted again.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] numItems number of elements in items, pNotifications and errors
+ * @param[in] items notifications to register, see AdsSyncAddDeviceNotificationReqEx()
+ * @param[out] pNotifications handle of each notification, 0 if it failed
+ * @param[out] errors [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each item
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the transfer, the items are only valid if this is 0
+ */
+long AdsSyncAddDeviceNotificationsReqEx(long                       port,
+                                        const AmsAddr*             pAddr,
+                                        uint32_t                   numItems,
+                                        const AdsNotificationItem* items,
+                                        uint32_t*                  pNotifications,
+                                        long*                      errors);
+
 /**
  * A notification defined previously is deleted from an ADS server.
  * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
@@ -140,6 +291,22 @@ long AdsSyncAddDeviceNotificationReqEx(long                         port,
  */
 long AdsSyncDelDeviceNotificationReqEx(long port, const AmsAddr* pAddr, uint32_t hNotification);
 
+/**
+ * Deletes many notifications with as few round trips as possible (ADSIGRP_SUMUP_DELDEVNOTE).
+ * The callbacks of all notifications are removed, even if the transfer to the server failed.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] numNotifications number of elements in hNotifications and errors
+ * @param[in] hNotifications handles of the notifications
+ * @param[out] errors [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each notification
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of the first failed transfer
+ */
+long AdsSyncDelDeviceNotificationsReqEx(long            port,
+                                        const AmsAddr*  pAddr,
+                                        uint32_t        numNotifications,
+                                        const uint32_t* hNotifications,
+                                        long*           errors);
+
 /**
  * Read the configured timeout for the ADS functions. The standard value is 5000 ms.
  * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
@@ -148,6 +315,67 @@ long AdsSyncDelDeviceNotificationReqEx(long port, const AmsAddr* pAddr, uint32_t
  */
 long AdsSyncGetTimeoutEx(long port, uint32_t* timeout);
 
+/**
+ * Let the synchronous read and write functions of this port merge their requests
+ * with the concurrent requests of other threads. Small reads (or writes) to the same
+ * ADS server, which are issued while a previous batch is still in flight or within
+ * window microseconds, are sent together as one ADSIGRP_SUMUP_READ (or ADSIGRP_SUMUP_WRITE)
+ * and each caller receives its own result. This raises the throughput of many threads
+ * reading individual variables, but adds up to window microseconds to the latency of
+ * each request. Coalescing is disabled by default.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] enable true to merge requests, false to send each request on its own.
+ * @param[in] window time in microseconds to wait for more requests, before a batch is sent.
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsSyncSetCoalescingEx(long port, bool enable, uint32_t window);
+
+/**
+ * Size the buffers, which hold received notifications of this port until they are
+ * dispatched to the callbacks. Each target system gets its own buffer of capacity
+ * bytes. Memory is only allocated as far as notifications are actually waiting. The
+ * standard value is 4 MB with ADSOVERFLOW_DROPNEWEST. With ADSOVERFLOW_BLOCK the
+ * receiving stalls until the callbacks caught up, which delays all responses from
+ * that target system as well, so callbacks mustn't wait for them. A frame larger
+ * than capacity is always dropped. ADSOVERFLOW_BLOCK is rejected with
+ * ADSERR_DEVICE_INVALIDSTATE while shared receive threads are used, see
+ * SetReceiveThreads(), as the blocked thread would stall every connection it serves.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] capacity maximum number of bytes waiting to be dispatched per target system
+ * @param[in] overflow what to do with frames, which don't fit into the buffer
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsSyncSetNotificationBufferEx(long port, uint32_t capacity, ADSNOTIFICATIONOVERFLOW overflow);
+
+/**
+ * Select the thread, which invokes the notification callbacks of this port. By default
+ * the notifications are copied into the notification buffer and dispatched by a separate
+ * thread. The sample behind pNotification is aligned to 8 bytes then. With
+ * ADSDELIVERY_DIRECT the receiving thread invokes the callbacks itself and pNotification
+ * points into the receive buffer, so samples are never copied. The sample is only valid
+ * until the callback returns and has no particular alignment, so copy it with memcpy()
+ * instead of casting it to the type of the variable. While a callback runs, nothing else
+ * is received from that target system, so it has to return quickly and mustn't call any
+ * synchronous Ads functions for that target system, including AdsSyncDelDeviceNotificationReqEx().
+ * With shared receive threads, see SetReceiveThreads(), one thread serves the connections
+ * to several target systems. A slow callback stalls all of them then, and synchronous
+ * calls to any target system served by the same thread time out the same way.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] delivery ADSDELIVERY_QUEUED or ADSDELIVERY_DIRECT
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsSyncSetNotificationDeliveryEx(long port, ADSNOTIFICATIONDELIVERY delivery);
+
+/**
+ * Read the counters of the notification buffer of this port for one target system.
+ * The counters accumulate while the port is open.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[out] statistics receives the counters
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsGetNotificationStatisticsEx(long port, const AmsAddr* pAddr, AdsNotificationStatistics* statistics);
+
 namespace bhf
 {
 namespace ads
@@ -160,6 +388,62 @@ namespace ads
  */
 long AddLocalRoute(AmsNetId ams, const char* ip);
 
+/**
+ * Add new ams route to target system and tune the TCP connection to it. If a
+ * connection to ip already exists, it is shared and options are ignored.
+ * @param[in] ams address of the target system
+ * @param[in] ip address of the target system
+ * @param[in] options socket options for the connection
+ * @param[in] numConnections number of TCP connections to open. Requests with large
+ *            amounts of data are spread over the additional connections, so they don't
+ *            delay small requests and notifications, which always use the first one.
+ *            The target has to accept several connections from the same AmsNetId.
+ *            Routes to the same ip share its connections, so they have to request the same
+ *            number of connections, otherwise ROUTERERR_PORTALREADYINUSE is returned. The
+ *            options of the first route to an ip apply to all of them.
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AddLocalRoute(AmsNetId ams, const char* ip, const SocketOptions& options, size_t numConnections = 1);
+
+/**
+ * Select how responses and notifications are received. By default (numThreads == 0)
+ * each connection to a target system runs its own receive thread. With numThreads > 0
+ * all connections share a pool of numThreads epoll based receive threads instead,
+ * which scales better with many target systems. This is only supported on Linux and
+ * can only be changed while no routes exist.
+ * Completion handlers and notification callbacks run on the shared thread, which
+ * serves their connection. A slow callback delays every other connection of that
+ * thread, and synchronous requests from within a callback will time out. Fails with
+ * ADSERR_DEVICE_INVALIDSTATE, while an open port uses ADSOVERFLOW_BLOCK, see
+ * AdsSyncSetNotificationBufferEx().
+ * @param[in] numThreads number of shared receive threads (at most 64) or 0 for one thread per connection
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetReceiveThreads(uint32_t numThreads);
+
+/**
+ * Select how notifications are dispatched to their callbacks. By default (numThreads == 0)
+ * each pair of local port and target system gets its own dispatch thread and a 4 MB
+ * receive buffer. With numThreads > 0 all of them share a pool of numThreads worker
+ * threads instead and buffer only as much as is actually waiting. Callbacks of the same
+ * port and target are still called in order, one at a time. This can only be changed
+ * while no routes exist.
+ * @param[in] numThreads number of shared dispatch threads or 0 for one thread per port and target
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long SetNotificationThreads(uint32_t numThreads);
+
+/**
+ * Add many ams routes at once. The connections to the target systems are established
+ * in parallel, so the total time is bound by the slowest target instead of the sum of
+ * all. Use SocketOptions::connectTimeout to limit the time spent on unreachable targets.
+ * @param[in] routes pairs of ams and ip address of the target systems
+ * @param[in] options socket options for new connections
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469) of each route in the same order as routes
+ */
+std::vector<long> AddLocalRoutes(const std::vector<std::pair<AmsNetId, std::string> >& routes,
+                                 const SocketOptions&                                options = SocketOptions {});
+
 /**
  * Delete ams route that had previously been added with AddLocalRoute().
  * @param[in] ams address of the target system
@@ -24,9 +24,11 @@
 #define _ADS_NOTIFICATION_H_
 
 #include "AdsDef.h"
-#include "RingBuffer.h"
 
+#include <cstring>
+#include <memory>
 #include <utility>
+#include <vector>
 
 using VirtualConnection = std::pair<uint16_t, AmsAddr>;
 
@@ -40,40 +42,48 @@ struct Notification {
                  uint16_t               __port)
         : connection({__port, __amsAddr}),
         callback(__func),
-        buffer(new uint8_t[sizeof(AdsNotificationHeader) + length]),
+        hNotification(0),
+        cbSampleSize(length),
         hUser(__hUser)
-    {
-        auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
-        header->hNotification = 0;
-        header->cbSampleSize = length;
-    }
+    {}
+
+    Notification(const Notification&) = delete;
+    Notification& operator=(const Notification&) = delete;
 
-    void Notify(uint64_t timestamp, RingBuffer& ring) const
+    /**
+     * sample has to provide Size() bytes, which are preceded by at least
+     * sizeof(AdsNotificationHeader) bytes, which aren't needed anymore. The
+     * header is built in place there, so the sample is passed to the callback
+     * without copying it. If aligned is given, a sample, which isn't aligned to
+     * 8 bytes, is copied behind the header into aligned instead.
+     */
+    void Notify(uint64_t timestamp, uint8_t* sample, std::vector<uint64_t>* aligned = nullptr) const
     {
-        auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
-        uint8_t* data = reinterpret_cast<uint8_t*>(header + 1);
-        for (size_t i = 0; i < header->cbSampleSize; ++i) {
-            data[i] = ring.ReadFromLittleEndian<uint8_t>();
+        const AdsNotificationHeader header { timestamp, hNotification, cbSampleSize };
+        auto pHeader = sample - sizeof(header);
+        if (aligned && (reinterpret_cast<uintptr_t>(sample) % sizeof(uint64_t))) {
+            aligned->resize((sizeof(header) + cbSampleSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            pHeader = reinterpret_cast<uint8_t*>(aligned->data());
+            memcpy(pHeader + sizeof(header), sample, cbSampleSize);
         }
-        header->nTimeStamp = timestamp;
-        callback(&connection.second, header, hUser);
+        memcpy(pHeader, &header, sizeof(header));
+        callback(&connection.second, reinterpret_cast<const AdsNotificationHeader*>(pHeader), hUser);
     }
 
     uint32_t Size() const
     {
-        auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
-        return header->cbSampleSize;
+        return cbSampleSize;
     }
 
     void hNotify(uint32_t value)
     {
-        auto header = reinterpret_cast<AdsNotificationHeader*>(buffer.get());
-        header->hNotification = value;
+        hNotification = value;
     }
 
 private:
     const PAdsNotificationFuncEx callback;
-    const std::shared_ptr<uint8_t> buffer;
+    uint32_t hNotification;
+    const uint32_t cbSampleSize;
     const uint32_t hUser;
 };
 
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AdsSum.h"
+#include "wrap_endian.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+long AdsSyncSumReadReqEx(const long         port,
+                         const AmsAddr*     pAddr,
+                         const uint32_t     numItems,
+                         const AdsReadItem* items,
+                         long*              errors)
+{
+    if (numItems && (!items || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    /* request: {list of IGrp, IOffs, Length}, response: {list of results} followed by {list of data} */
+    std::vector<uint32_t> request;
+    std::vector<uint8_t> response;
+    for (uint32_t first = 0; first < numItems;) {
+        request.clear();
+        size_t readLength = 0;
+        uint32_t count = 0;
+        while ((first + count < numItems) && (count < ADS_SUMUP_MAX_ITEMS)) {
+            const auto& item = items[first + count];
+            const auto itemLength = sizeof(uint32_t) + item.length;
+            if (count && (readLength + itemLength > ADS_SUMUP_MAX_LENGTH)) {
+                break;
+            }
+            if (item.length && !item.buffer) {
+                return ADSERR_CLIENT_INVALIDPARM;
+            }
+            request.push_back(bhf::ads::htole(item.indexGroup));
+            request.push_back(bhf::ads::htole(item.indexOffset));
+            request.push_back(bhf::ads::htole(item.length));
+            readLength += itemLength;
+            ++count;
+        }
+        if (readLength > UINT32_MAX) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+
+        response.resize(readLength);
+        uint32_t bytesRead = 0;
+        const auto status = AdsSyncReadWriteReqEx2(port, pAddr, ADSIGRP_SUMUP_READ, count,
+                                                   static_cast<uint32_t>(response.size()), response.data(),
+                                                   static_cast<uint32_t>(request.size() * sizeof(uint32_t)),
+                                                   request.data(), &bytesRead);
+        if (status) {
+            return status;
+        }
+        if (bytesRead < count * sizeof(uint32_t)) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+
+        /* the data area contains the requested length of every item, even of the failed ones */
+        auto data = response.data() + count * sizeof(uint32_t);
+        const auto end = response.data() + bytesRead;
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto& item = items[first + i];
+            long error = bhf::ads::letoh<uint32_t>(response.data() + i * sizeof(uint32_t));
+            if (!error && (static_cast<size_t>(end - data) < item.length)) {
+                error = ADSERR_DEVICE_INVALIDSIZE;
+            }
+            if (!error) {
+                memcpy(item.buffer, data, item.length);
+            }
+            errors[first + i] = error;
+            data += std::min<size_t>(item.length, end - data);
+        }
+        first += count;
+    }
+    return 0;
+}
+
+long AdsSyncSumWriteReqEx(const long          port,
+                          const AmsAddr*      pAddr,
+                          const uint32_t      numItems,
+                          const AdsWriteItem* items,
+                          long*               errors)
+{
+    if (numItems && (!items || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    /* request: {list of IGrp, IOffs, Length} followed by {list of data}, response: {list of results} */
+    std::vector<uint32_t> headers;
+    std::vector<SocketBuffer> buffers;
+    std::vector<uint32_t> results;
+    for (uint32_t first = 0; first < numItems;) {
+        headers.clear();
+        buffers.resize(1);
+        size_t length = 0;
+        uint32_t count = 0;
+        while ((first + count < numItems) && (count < ADS_SUMUP_MAX_ITEMS)) {
+            const auto& item = items[first + count];
+            const auto itemLength = 3 * sizeof(uint32_t) + item.length;
+            if (count && (length + itemLength > ADS_SUMUP_MAX_LENGTH)) {
+                break;
+            }
+            if (item.length && !item.buffer) {
+                return ADSERR_CLIENT_INVALIDPARM;
+            }
+            headers.push_back(bhf::ads::htole(item.indexGroup));
+            headers.push_back(bhf::ads::htole(item.indexOffset));
+            headers.push_back(bhf::ads::htole(item.length));
+            buffers.push_back(SocketBuffer { item.buffer, item.length });
+            length += itemLength;
+            ++count;
+        }
+        buffers[0] = SocketBuffer { headers.data(), headers.size() * sizeof(uint32_t) };
+        if (length > UINT32_MAX) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+
+        results.resize(count);
+        uint32_t bytesRead = 0;
+        const auto status = AdsSyncReadWriteGatherReqEx(port, pAddr, ADSIGRP_SUMUP_WRITE, count,
+                                                        count * sizeof(uint32_t), results.data(),
+                                                        static_cast<uint32_t>(buffers.size()), buffers.data(),
+                                                        &bytesRead);
+        if (status) {
+            return status;
+        }
+        if (bytesRead < count * sizeof(uint32_t)) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            errors[first + i] = bhf::ads::letoh(results[i]);
+        }
+        first += count;
+    }
+    return 0;
+}
+
+long AdsSyncSumReadWriteReqEx(const long              port,
+                              const AmsAddr*          pAddr,
+                              const uint32_t          numItems,
+                              const AdsReadWriteItem* items,
+                              long*                   errors,
+                              uint32_t*               bytesRead)
+{
+    if (numItems && (!items || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    /* request: {list of IGrp, IOffs, RLength, WLength} followed by {list of data} */
+    /* response: {list of results, RLength} followed by {list of data (returned lengths)} */
+    std::vector<uint32_t> headers;
+    std::vector<SocketBuffer> buffers;
+    std::vector<uint8_t> response;
+    for (uint32_t first = 0; first < numItems;) {
+        headers.clear();
+        buffers.resize(1);
+        size_t writeLength = 0;
+        size_t readLength = 0;
+        uint32_t count = 0;
+        while ((first + count < numItems) && (count < ADS_SUMUP_MAX_ITEMS)) {
+            const auto& item = items[first + count];
+            const auto itemWriteLength = 4 * sizeof(uint32_t) + item.writeLength;
+            const auto itemReadLength = 2 * sizeof(uint32_t) + item.readLength;
+            if (count && ((writeLength + itemWriteLength > ADS_SUMUP_MAX_LENGTH) ||
+                          (readLength + itemReadLength > ADS_SUMUP_MAX_LENGTH))) {
+                break;
+            }
+            if ((item.writeLength && !item.writeData) || (item.readLength && !item.readData)) {
+                return ADSERR_CLIENT_INVALIDPARM;
+            }
+            headers.push_back(bhf::ads::htole(item.indexGroup));
+            headers.push_back(bhf::ads::htole(item.indexOffset));
+            headers.push_back(bhf::ads::htole(item.readLength));
+            headers.push_back(bhf::ads::htole(item.writeLength));
+            buffers.push_back(SocketBuffer { item.writeData, item.writeLength });
+            writeLength += itemWriteLength;
+            readLength += itemReadLength;
+            ++count;
+        }
+        buffers[0] = SocketBuffer { headers.data(), headers.size() * sizeof(uint32_t) };
+        if ((writeLength > UINT32_MAX) || (readLength > UINT32_MAX)) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+
+        response.resize(readLength);
+        uint32_t received = 0;
+        const auto status = AdsSyncReadWriteGatherReqEx(port, pAddr, ADSIGRP_SUMUP_READWRITE, count,
+                                                        static_cast<uint32_t>(response.size()), response.data(),
+                                                        static_cast<uint32_t>(buffers.size()), buffers.data(),
+                                                        &received);
+        if (status) {
+            return status;
+        }
+        if (received < count * 2 * sizeof(uint32_t)) {
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+
+        auto data = response.data() + count * 2 * sizeof(uint32_t);
+        const auto end = response.data() + received;
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto& item = items[first + i];
+            const auto result = response.data() + i * 2 * sizeof(uint32_t);
+            long error = bhf::ads::letoh<uint32_t>(result);
+            const uint32_t length = bhf::ads::letoh<uint32_t>(result + sizeof(uint32_t));
+            if ((length > item.readLength) || (static_cast<size_t>(end - data) < length)) {
+                error = error ? error : ADSERR_DEVICE_INVALIDSIZE;
+            } else if (!error) {
+                memcpy(item.readData, data, length);
+            }
+            errors[first + i] = error;
+            if (bytesRead) {
+                bytesRead[first + i] = error ? 0 : length;
+            }
+            data += std::min<size_t>(length, end - data);
+        }
+        first += count;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsLib.h"
+#include "Sockets.h"
+
+/**
+ * Internal helper of the sum commands, not part of the public API. Writes data synchronously
+ * into an ADS server and receives data back from the ADS server, like AdsSyncReadWriteReqEx2().
+ * The data send to the ADS server is gathered from several buffers, the standalone router
+ * sends them without copying them into one buffer first.
+ * @param[in] port  port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] pAddr Structure with NetId and port number of the ADS server.
+ * @param[in] indexGroup Index Group.
+ * @param[in] indexOffset Index Offset.
+ * @param[in] readLength Length, in bytes, of the read buffer readData.
+ * @param[out] readData Buffer for data read from the ADS server.
+ * @param[in] numBuffers number of elements in writeBuffers
+ * @param[in] writeBuffers Buffers with data send to the ADS server, in the order they are sent.
+ * @param[out] bytesRead pointer to a variable. If successful, this variable will return the number of actually read data bytes.
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsSyncReadWriteGatherReqEx(long                port,
+                                 const AmsAddr*      pAddr,
+                                 uint32_t            indexGroup,
+                                 uint32_t            indexOffset,
+                                 uint32_t            readLength,
+                                 void*               readData,
+                                 uint32_t            numBuffers,
+                                 const SocketBuffer* writeBuffers,
+                                 uint32_t*           bytesRead);
@@ -0,0 +1,611 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AdsSymbolTable.h"
+#include "AdsException.h"
+#include "AdsLib.h"
+#include "Log.h"
+#include "wrap_endian.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+/**
+ * Describes the image of an AdsSymbolTable and the state of the target it was
+ * uploaded from. The image is only valid for a target, as long as everything
+ * up to stringsLength matches.
+ */
+struct AdsSymbolTable::Header {
+    char magic[8];
+    uint32_t format;
+    uint32_t byteOrder;
+    AmsAddr target;
+    uint32_t symbolVersion;
+    uint8_t uploadInfo[24];
+    uint32_t stringsLength;
+    uint32_t numSymbols;
+    uint32_t numTypes;
+    uint32_t numFields;
+    uint32_t numDimensions;
+    uint32_t numSlots;
+};
+
+static const char IMAGE_MAGIC[8] = {'A', 'D', 'S', 'S', 'Y', 'M', 'S', '\0'};
+
+/** increment, whenever the layout of the image changes */
+static const uint32_t IMAGE_FORMAT = 1;
+
+/** written in host byte order, so images of other architectures are rejected */
+static const uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+
+/** symbol version of targets, which don't provide ADSIGRP_SYM_VERSION. Their images are never reused. */
+static const uint32_t UNKNOWN_VERSION = 0xFFFFFFFF;
+
+struct AdsSymbolTable::Tables {
+    std::vector<char> strings;
+    std::vector<SymbolEntry> symbols;
+    std::vector<TypeEntry> types;
+    std::vector<FieldEntry> fields;
+    std::vector<AdsDatatypeArrayInfo> dimensions;
+    std::vector<uint32_t> index;
+};
+
+/**
+ * Appends strings to the pool of an AdsSymbolTable. Strings which occur several
+ * times, like type and field names, are stored only once.
+ */
+struct AdsSymbolTable::StringPool {
+    StringPool(std::vector<char>& __strings)
+        : strings(__strings)
+    {}
+
+    uint32_t Add(const char* s, size_t length)
+    {
+        const auto offset = static_cast<uint32_t>(strings.size());
+        strings.insert(strings.end(), s, s + length);
+        strings.push_back('\0');
+        return offset;
+    }
+
+    uint32_t Intern(const char* s, size_t length)
+    {
+        const auto it = interned.emplace(std::string(s, length), 0);
+        if (it.second) {
+            it.first->second = Add(s, length);
+        }
+        return it.first->second;
+    }
+
+private:
+    std::vector<char>& strings;
+    std::map<std::string, uint32_t> interned;
+};
+
+static inline char ToLower(const char c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+}
+
+/** ASCII case insensitive strcmp() */
+static int CompareNoCase(const char* lhs, const char* rhs)
+{
+    for ( ; ; ++lhs, ++rhs) {
+        const auto l = static_cast<unsigned char>(ToLower(*lhs));
+        const auto r = static_cast<unsigned char>(ToLower(*rhs));
+        if ((l != r) || !l) {
+            return l - r;
+        }
+    }
+}
+
+/** ASCII case insensitive FNV-1a */
+static uint32_t HashNoCase(const char* s)
+{
+    uint32_t hash = 2166136261u;
+    for ( ; *s; ++s) {
+        hash = (hash ^ static_cast<unsigned char>(ToLower(*s))) * 16777619u;
+    }
+    return hash;
+}
+
+/** @return the length of an entry, which has to fit into [minimum, available] */
+static uint32_t EntryLength(const uint8_t* entry, const size_t available, const size_t minimum)
+{
+    const auto length = (available >= minimum) ? bhf::ads::letoh<uint32_t>(entry) : 0;
+    if ((length < minimum) || (length > available)) {
+        throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+    }
+    return length;
+}
+
+static uint32_t Upload(const AdsDevice& route, const uint32_t indexGroup, std::vector<uint8_t>& buffer)
+{
+    uint32_t bytesRead = 0;
+    const auto error = route.ReadReqEx2(indexGroup, 0, static_cast<uint32_t>(buffer.size()), buffer.data(),
+                                        &bytesRead);
+    if (error) {
+        throw AdsException(error);
+    }
+    return bytesRead;
+}
+
+/** offsets of the sections of an image in the order of the Tables, followed by the total length */
+static void Layout(const uint32_t stringsLength, const uint32_t numSymbols, const uint32_t numTypes,
+                   const uint32_t numFields, const uint32_t numDimensions, const uint32_t numSlots,
+                   const size_t entrySizes[6], uint64_t offsets[7])
+{
+    const uint64_t counts[6] = { stringsLength, numSymbols, numTypes, numFields, numDimensions, numSlots };
+    uint64_t offset = 0;
+    for (size_t i = 0; i < 6; ++i) {
+        /* keep every section 8 byte aligned */
+        offset = (offset + 7) & ~uint64_t(7);
+        offsets[i] = offset;
+        offset += counts[i] * entrySizes[i];
+    }
+    offsets[6] = offset;
+}
+
+AdsSymbolTable::AdsSymbolTable(const AdsDevice& route)
+    : mapped(nullptr),
+    mappedLength(0),
+    fromCache(false)
+{
+    Header header;
+    ReadHeader(route, header);
+    Upload(route, header);
+}
+
+AdsSymbolTable::AdsSymbolTable(const AdsDevice& route, const std::string& cacheFile)
+    : mapped(nullptr),
+    mappedLength(0),
+    fromCache(false)
+{
+    Header header;
+    ReadHeader(route, header);
+    if ((UNKNOWN_VERSION != header.symbolVersion) && Load(cacheFile, header)) {
+        fromCache = true;
+        return;
+    }
+    Upload(route, header);
+    if (UNKNOWN_VERSION != header.symbolVersion) {
+        Store(cacheFile);
+    }
+}
+
+AdsSymbolTable::~AdsSymbolTable()
+{
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    if (mapped) {
+        munmap(mapped, mappedLength);
+    }
+#endif
+}
+
+void AdsSymbolTable::ReadHeader(const AdsDevice& route, Header& header)
+{
+    header = Header {};
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.format = IMAGE_FORMAT;
+    header.byteOrder = IMAGE_BYTE_ORDER;
+    header.target = route.m_Addr;
+
+    /* request the symbol version and upload info together, to validate a cache with a single round trip */
+    uint8_t symbolVersion = 0;
+    const std::vector<AdsReadItem> items {
+        { ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion },
+        { ADSIGRP_SYM_UPLOADINFO2, 0, sizeof(header.uploadInfo), header.uploadInfo },
+    };
+    std::vector<long> errors;
+    try {
+        errors = route.ReadMulti(items);
+    } catch (const AdsException& ex) {
+        if (ADSERR_DEVICE_SRVNOTSUPP != ex.errorCode) {
+            throw;
+        }
+
+        /* target doesn't support sum commands */
+        for (const auto& item : items) {
+            uint32_t bytesRead = 0;
+            const auto error = route.ReadReqEx2(item.indexGroup, item.indexOffset, item.length, item.buffer,
+                                                &bytesRead);
+            errors.push_back((error || (bytesRead == item.length)) ? error : ADSERR_DEVICE_INVALIDSIZE);
+        }
+    }
+    if (errors[1]) {
+        throw AdsException(errors[1]);
+    }
+    header.symbolVersion = errors[0] ? UNKNOWN_VERSION : symbolVersion;
+}
+
+void AdsSymbolTable::Upload(const AdsDevice& route, const Header& header)
+{
+    /* AdsSymbolUploadInfo2: nSymbols, nSymSize, nDatatypes, nDatatypeSize, nMaxDynSymbols, nUsedDynSymbols */
+    const auto numSymbols = bhf::ads::letoh<uint32_t>(header.uploadInfo);
+    const auto symbolsLength = bhf::ads::letoh<uint32_t>(header.uploadInfo + 4);
+    const auto numDataTypes = bhf::ads::letoh<uint32_t>(header.uploadInfo + 8);
+    const auto dataTypesLength = bhf::ads::letoh<uint32_t>(header.uploadInfo + 12);
+
+    Tables tables;
+    StringPool pool { tables.strings };
+    std::vector<uint8_t> buffer(symbolsLength);
+    tables.symbols.reserve(numSymbols);
+    ParseSymbols(tables, pool, buffer.data(), ::Upload(route, ADSIGRP_SYM_UPLOAD, buffer));
+
+    buffer.resize(dataTypesLength);
+    tables.types.reserve(numDataTypes);
+    ParseDataTypes(tables, pool, buffer.data(), ::Upload(route, ADSIGRP_SYM_DT_UPLOAD, buffer));
+
+    /* keep the index at most half full, so most lookups hit in the first slot */
+    size_t slots = 1;
+    while (slots < 2 * tables.symbols.size()) {
+        slots *= 2;
+    }
+    tables.index.resize(slots);
+    for (size_t i = 0; i < tables.symbols.size(); ++i) {
+        auto slot = HashNoCase(tables.strings.data() + tables.symbols[i].name) & (slots - 1);
+        while (tables.index[slot]) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        tables.index[slot] = static_cast<uint32_t>(i + 1);
+    }
+
+    const auto& names = tables.strings;
+    std::sort(tables.types.begin(), tables.types.end(), [&names](const TypeEntry& lhs, const TypeEntry& rhs) {
+        return CompareNoCase(names.data() + lhs.name, names.data() + rhs.name) < 0;
+    });
+
+    /* copy the tables into a single image, which can be written to a cache file as it is */
+    Header image = header;
+    image.stringsLength = static_cast<uint32_t>(tables.strings.size());
+    image.numSymbols = static_cast<uint32_t>(tables.symbols.size());
+    image.numTypes = static_cast<uint32_t>(tables.types.size());
+    image.numFields = static_cast<uint32_t>(tables.fields.size());
+    image.numDimensions = static_cast<uint32_t>(tables.dimensions.size());
+    image.numSlots = static_cast<uint32_t>(tables.index.size());
+
+    const size_t entrySizes[6] = {
+        sizeof(char), sizeof(SymbolEntry), sizeof(TypeEntry), sizeof(FieldEntry), sizeof(AdsDatatypeArrayInfo),
+        sizeof(uint32_t)
+    };
+    uint64_t offsets[7];
+    Layout(image.stringsLength, image.numSymbols, image.numTypes, image.numFields, image.numDimensions,
+           image.numSlots, entrySizes, offsets);
+    heap.resize(sizeof(image) + offsets[6]);
+    const auto sections = heap.data() + sizeof(image);
+    memcpy(heap.data(), &image, sizeof(image));
+    memcpy(sections + offsets[0], tables.strings.data(), tables.strings.size());
+    memcpy(sections + offsets[1], tables.symbols.data(), tables.symbols.size() * sizeof(SymbolEntry));
+    memcpy(sections + offsets[2], tables.types.data(), tables.types.size() * sizeof(TypeEntry));
+    memcpy(sections + offsets[3], tables.fields.data(), tables.fields.size() * sizeof(FieldEntry));
+    memcpy(sections + offsets[4], tables.dimensions.data(),
+           tables.dimensions.size() * sizeof(AdsDatatypeArrayInfo));
+    memcpy(sections + offsets[5], tables.index.data(), tables.index.size() * sizeof(uint32_t));
+    Attach(heap.data(), heap.size(), header);
+}
+
+bool AdsSymbolTable::Attach(const uint8_t* const image, const size_t length, const Header& expected)
+{
+    if (length < sizeof(Header)) {
+        return false;
+    }
+    Header header;
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(&header, &expected, offsetof(Header, stringsLength))) {
+        return false;
+    }
+
+    const size_t entrySizes[6] = {
+        sizeof(char), sizeof(SymbolEntry), sizeof(TypeEntry), sizeof(FieldEntry), sizeof(AdsDatatypeArrayInfo),
+        sizeof(uint32_t)
+    };
+    uint64_t offsets[7];
+    Layout(header.stringsLength, header.numSymbols, header.numTypes, header.numFields, header.numDimensions,
+           header.numSlots, entrySizes, offsets);
+    const auto sections = image + sizeof(header);
+    if ((offsets[6] > length - sizeof(header)) || !header.numSlots || (header.numSlots & (header.numSlots - 1)) ||
+        (header.numSlots <= header.numSymbols) || !header.stringsLength ||
+        sections[offsets[0] + header.stringsLength - 1] ||
+        !Validate(header, sections, offsets)) {
+        LOG_WARN("Symbol table image is corrupted");
+        return false;
+    }
+
+    strings = reinterpret_cast<const char*>(sections + offsets[0]);
+    symbols = reinterpret_cast<const SymbolEntry*>(sections + offsets[1]);
+    numSymbols = header.numSymbols;
+    types = reinterpret_cast<const TypeEntry*>(sections + offsets[2]);
+    numTypes = header.numTypes;
+    fields = reinterpret_cast<const FieldEntry*>(sections + offsets[3]);
+    dimensions = reinterpret_cast<const AdsDatatypeArrayInfo*>(sections + offsets[4]);
+    index = reinterpret_cast<const uint32_t*>(sections + offsets[5]);
+    numSlots = header.numSlots;
+    return true;
+}
+
+bool AdsSymbolTable::Validate(const Header& header, const uint8_t* const sections, const uint64_t offsets[7])
+{
+    /* a cache file is untrusted input, every reference has to stay within its section */
+    const auto symbolEntries = reinterpret_cast<const SymbolEntry*>(sections + offsets[1]);
+    for (uint32_t i = 0; i < header.numSymbols; ++i) {
+        const auto& entry = symbolEntries[i];
+        if ((entry.name >= header.stringsLength) || (entry.type >= header.stringsLength)) {
+            return false;
+        }
+    }
+
+    const auto typeEntries = reinterpret_cast<const TypeEntry*>(sections + offsets[2]);
+    for (uint32_t i = 0; i < header.numTypes; ++i) {
+        const auto& entry = typeEntries[i];
+        if ((entry.name >= header.stringsLength) || (entry.type >= header.stringsLength) ||
+            (uint64_t(entry.firstDimension) + entry.numDimensions > header.numDimensions) ||
+            (uint64_t(entry.firstField) + entry.numFields > header.numFields)) {
+            return false;
+        }
+    }
+
+    const auto fieldEntries = reinterpret_cast<const FieldEntry*>(sections + offsets[3]);
+    for (uint32_t i = 0; i < header.numFields; ++i) {
+        const auto& entry = fieldEntries[i];
+        if ((entry.name >= header.stringsLength) || (entry.type >= header.stringsLength)) {
+            return false;
+        }
+    }
+
+    /* Find() stops at the first empty slot, so at least one is required */
+    const auto slots = reinterpret_cast<const uint32_t*>(sections + offsets[5]);
+    bool empty = false;
+    for (uint32_t i = 0; i < header.numSlots; ++i) {
+        if (slots[i] > header.numSymbols) {
+            return false;
+        }
+        empty |= !slots[i];
+    }
+    return empty;
+}
+
+bool AdsSymbolTable::Load(const std::string& cacheFile, const Header& expected)
+{
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    const int fd = open(cacheFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) || (static_cast<size_t>(status.st_size) < sizeof(Header))) {
+        close(fd);
+        return false;
+    }
+    const auto length = static_cast<size_t>(status.st_size);
+    const auto image = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == image) {
+        return false;
+    }
+    if (!Attach(static_cast<const uint8_t*>(image), length, expected)) {
+        munmap(image, length);
+        return false;
+    }
+    mapped = image;
+    mappedLength = length;
+    return true;
+#else
+    /* without mmap() the image is read into memory */
+    std::ifstream file(cacheFile, std::ios::binary);
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!Attach(image.data(), image.size(), expected)) {
+        return false;
+    }
+    heap.swap(image);
+    return true;
+#endif
+}
+
+void AdsSymbolTable::Store(const std::string& cacheFile) const
+{
+    /* write to a temporary file first, so other processes never see an incomplete image */
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    const auto temporary = cacheFile + '.' + std::to_string(getpid());
+#else
+    const auto temporary = cacheFile + '.' + std::to_string(_getpid());
+#endif
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(heap.data()), heap.size());
+        if (!file.flush()) {
+            LOG_WARN("Writing symbol cache '" << temporary << "' failed");
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    std::remove(cacheFile.c_str());
+#endif
+    if (std::rename(temporary.c_str(), cacheFile.c_str())) {
+        LOG_WARN("Replacing symbol cache '" << cacheFile << "' failed");
+        std::remove(temporary.c_str());
+    }
+}
+
+void AdsSymbolTable::ParseSymbols(Tables& tables, StringPool& pool, const uint8_t* data, size_t length)
+{
+    while (length) {
+        const auto entryLength = EntryLength(data, length, sizeof(AdsSymbolEntry));
+        const auto nameLength = bhf::ads::letoh<uint16_t>(data + offsetof(AdsSymbolEntry, nameLength));
+        const auto typeLength = bhf::ads::letoh<uint16_t>(data + offsetof(AdsSymbolEntry, typeLength));
+        if (sizeof(AdsSymbolEntry) + nameLength + 1 + typeLength + 1 > entryLength) {
+            throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+        }
+
+        const auto name = reinterpret_cast<const char*>(data + sizeof(AdsSymbolEntry));
+        tables.symbols.push_back(SymbolEntry {
+            pool.Add(name, nameLength),
+            pool.Intern(name + nameLength + 1, typeLength),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsSymbolEntry, iGroup)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsSymbolEntry, iOffs)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsSymbolEntry, size)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsSymbolEntry, dataType)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsSymbolEntry, flags)),
+        });
+        data += entryLength;
+        length -= entryLength;
+    }
+}
+
+void AdsSymbolTable::ParseDataTypes(Tables& tables, StringPool& pool, const uint8_t* data, size_t length)
+{
+    while (length) {
+        const auto entryLength = EntryLength(data, length, sizeof(AdsDatatypeEntry));
+        const auto nameLength = bhf::ads::letoh<uint16_t>(data + offsetof(AdsDatatypeEntry, nameLength));
+        const auto typeLength = bhf::ads::letoh<uint16_t>(data + offsetof(AdsDatatypeEntry, typeLength));
+        const auto commentLength = bhf::ads::letoh<uint16_t>(data + offsetof(AdsDatatypeEntry, commentLength));
+        const auto arrayDim = bhf::ads::letoh<uint16_t>(data + offsetof(AdsDatatypeEntry, arrayDim));
+        const auto subItems = bhf::ads::letoh<uint16_t>(data + offsetof(AdsDatatypeEntry, subItems));
+        const auto name = reinterpret_cast<const char*>(data + sizeof(AdsDatatypeEntry));
+        size_t pos = sizeof(AdsDatatypeEntry) + nameLength + 1 + typeLength + 1 + commentLength + 1;
+        if (pos + arrayDim * sizeof(AdsDatatypeArrayInfo) > entryLength) {
+            throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+        }
+
+        const TypeEntry type {
+            pool.Intern(name, nameLength),
+            pool.Intern(name + nameLength + 1, typeLength),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsDatatypeEntry, size)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsDatatypeEntry, dataType)),
+            bhf::ads::letoh<uint32_t>(data + offsetof(AdsDatatypeEntry, flags)),
+            static_cast<uint32_t>(tables.dimensions.size()),
+            arrayDim,
+            static_cast<uint32_t>(tables.fields.size()),
+            subItems,
+        };
+
+        for (uint16_t i = 0; i < arrayDim; ++i) {
+            tables.dimensions.push_back(AdsDatatypeArrayInfo {
+                bhf::ads::letoh<uint32_t>(data + pos),
+                bhf::ads::letoh<uint32_t>(data + pos + sizeof(uint32_t)),
+            });
+            pos += sizeof(AdsDatatypeArrayInfo);
+        }
+
+        /* the elements of a structure are data type entries themselves, only their headers are of interest */
+        for (uint16_t i = 0; i < subItems; ++i) {
+            const auto item = data + pos;
+            const auto itemLength = EntryLength(item, entryLength - pos, sizeof(AdsDatatypeEntry));
+            const auto itemNameLength = bhf::ads::letoh<uint16_t>(item + offsetof(AdsDatatypeEntry, nameLength));
+            const auto itemTypeLength = bhf::ads::letoh<uint16_t>(item + offsetof(AdsDatatypeEntry, typeLength));
+            if (sizeof(AdsDatatypeEntry) + itemNameLength + 1 + itemTypeLength + 1 > itemLength) {
+                throw AdsException(ADSERR_DEVICE_INVALIDDATA);
+            }
+
+            const auto itemName = reinterpret_cast<const char*>(item + sizeof(AdsDatatypeEntry));
+            tables.fields.push_back(FieldEntry {
+                pool.Intern(itemName, itemNameLength),
+                pool.Intern(itemName + itemNameLength + 1, itemTypeLength),
+                bhf::ads::letoh<uint32_t>(item + offsetof(AdsDatatypeEntry, offs)),
+                bhf::ads::letoh<uint32_t>(item + offsetof(AdsDatatypeEntry, size)),
+                bhf::ads::letoh<uint32_t>(item + offsetof(AdsDatatypeEntry, dataType)),
+                bhf::ads::letoh<uint32_t>(item + offsetof(AdsDatatypeEntry, flags)),
+            });
+            pos += itemLength;
+        }
+        tables.types.push_back(type);
+        data += entryLength;
+        length -= entryLength;
+    }
+}
+
+const char* AdsSymbolTable::String(const uint32_t offset) const
+{
+    return strings + offset;
+}
+
+bool AdsSymbolTable::Find(const std::string& name, AdsSymbol& symbol) const
+{
+    const auto mask = numSlots - 1;
+    for (auto slot = HashNoCase(name.c_str()) & mask; index[slot]; slot = (slot + 1) & mask) {
+        const auto& entry = symbols[index[slot] - 1];
+        if (!CompareNoCase(String(entry.name), name.c_str())) {
+            symbol = AdsSymbol {
+                String(entry.name),
+                String(entry.type),
+                entry.indexGroup,
+                entry.indexOffset,
+                entry.size,
+                entry.dataType,
+                entry.flags,
+            };
+            return true;
+        }
+    }
+    return false;
+}
+
+AdsSymbol AdsSymbolTable::Get(const std::string& name) const
+{
+    AdsSymbol symbol;
+    if (!Find(name, symbol)) {
+        throw AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND);
+    }
+    return symbol;
+}
+
+bool AdsSymbolTable::FindType(const std::string& name, AdsDataType& dataType) const
+{
+    const auto end = types + numTypes;
+    const auto it = std::lower_bound(types, end, name,
+                                     [this](const TypeEntry& entry, const std::string& value) {
+        return CompareNoCase(String(entry.name), value.c_str()) < 0;
+    });
+    if ((it == end) || CompareNoCase(String(it->name), name.c_str())) {
+        return false;
+    }
+
+    dataType.name = String(it->name);
+    dataType.type = String(it->type);
+    dataType.size = it->size;
+    dataType.dataType = it->dataType;
+    dataType.flags = it->flags;
+    dataType.dimensions.assign(dimensions + it->firstDimension,
+                               dimensions + it->firstDimension + it->numDimensions);
+    dataType.fields.clear();
+    for (uint32_t i = it->firstField; i < it->firstField + it->numFields; ++i) {
+        const auto& field = fields[i];
+        dataType.fields.push_back(AdsDataTypeField {
+            String(field.name),
+            String(field.type),
+            field.offset,
+            field.size,
+            field.dataType,
+            field.flags,
+        });
+    }
+    return true;
+}
+
+size_t AdsSymbolTable::NumSymbols() const
+{
+    return numSymbols;
+}
+
+size_t AdsSymbolTable::NumDataTypes() const
+{
+    return numTypes;
+}
+
+bool AdsSymbolTable::FromCache() const
+{
+    return fromCache;
+}
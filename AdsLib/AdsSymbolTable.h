@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "AdsDevice.h"
+
+/**
+ * Location and data type of a symbol. The strings belong to the AdsSymbolTable,
+ * which returned the symbol and stay valid as long as that table exists.
+ */
+struct AdsSymbol {
+    const char* name;
+    const char* type;
+    uint32_t indexGroup;
+    uint32_t indexOffset;
+    uint32_t size;
+    uint32_t dataType;
+    uint32_t flags;
+};
+
+/** Element of a structured data type, offset is relative to the start of the structure */
+struct AdsDataTypeField {
+    const char* name;
+    const char* type;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t dataType;
+    uint32_t flags;
+};
+
+struct AdsDataType {
+    const char* name;
+
+    /** type an alias is derived from or the element type of an array */
+    const char* type;
+    uint32_t size;
+    uint32_t dataType;
+    uint32_t flags;
+    std::vector<AdsDatatypeArrayInfo> dimensions;
+    std::vector<AdsDataTypeField> fields;
+};
+
+/**
+ * Local copy of the symbol and data type tables of an ADS device. Both tables are
+ * uploaded once (ADSIGRP_SYM_UPLOAD, ADSIGRP_SYM_DT_UPLOAD), so looking up the
+ * location of a symbol doesn't need a round trip to the device. PLC projects can
+ * have hundreds of thousands of symbols, so the entries are kept in flat arrays,
+ * which refer to a single pool of interned strings. Symbols are found through an
+ * open addressing hash index, data types by binary search. All of this is stored
+ * in one position independent image, which can be mapped from a cache file.
+ */
+struct AdsSymbolTable {
+    AdsSymbolTable(const AdsDevice& route);
+
+    /**
+     * Like AdsSymbolTable(route), but the tables are mapped from cacheFile, if it was
+     * written for the same target and the symbol version and upload info of the target
+     * didn't change since. Both are validated with a single request. Otherwise the
+     * tables are uploaded and cacheFile is replaced.
+     */
+    AdsSymbolTable(const AdsDevice& route, const std::string& cacheFile);
+    ~AdsSymbolTable();
+    AdsSymbolTable(const AdsSymbolTable&) = delete;
+    AdsSymbolTable& operator=(const AdsSymbolTable&) = delete;
+
+    /**
+     * Names are compared case insensitive, like TwinCAT does.
+     * @return false, if no symbol with this name exists
+     */
+    bool Find(const std::string& name, AdsSymbol& symbol) const;
+
+    /** throws AdsException(ADSERR_DEVICE_SYMBOLNOTFOUND), if no symbol with this name exists */
+    AdsSymbol Get(const std::string& name) const;
+
+    /** @return false, if no data type with this name exists */
+    bool FindType(const std::string& name, AdsDataType& dataType) const;
+
+    size_t NumSymbols() const;
+    size_t NumDataTypes() const;
+
+    /** @return true, if the tables were loaded from the cache file instead of the target */
+    bool FromCache() const;
+
+private:
+    /** strings are stored as offsets into the string pool */
+    struct SymbolEntry {
+        uint32_t name;
+        uint32_t type;
+        uint32_t indexGroup;
+        uint32_t indexOffset;
+        uint32_t size;
+        uint32_t dataType;
+        uint32_t flags;
+    };
+
+    struct TypeEntry {
+        uint32_t name;
+        uint32_t type;
+        uint32_t size;
+        uint32_t dataType;
+        uint32_t flags;
+        uint32_t firstDimension;
+        uint32_t numDimensions;
+        uint32_t firstField;
+        uint32_t numFields;
+    };
+
+    struct FieldEntry {
+        uint32_t name;
+        uint32_t type;
+        uint32_t offset;
+        uint32_t size;
+        uint32_t dataType;
+        uint32_t flags;
+    };
+
+    struct Header;
+    struct Tables;
+    struct StringPool;
+
+    /** image of the tables, either owned on the heap or mapped from the cache file */
+    std::vector<uint8_t> heap;
+    void* mapped;
+    size_t mappedLength;
+    bool fromCache;
+
+    /** sections of the image */
+    const char* strings;
+    const SymbolEntry* symbols;
+    size_t numSymbols;
+    const TypeEntry* types;
+    size_t numTypes;
+    const FieldEntry* fields;
+    const AdsDatatypeArrayInfo* dimensions;
+
+    /** slots of the hash index contain the position in symbols + 1 or 0, if they are empty */
+    const uint32_t* index;
+    size_t numSlots;
+
+    static void ReadHeader(const AdsDevice& route, Header& header);
+    void Upload(const AdsDevice& route, const Header& header);
+    bool Load(const std::string& cacheFile, const Header& header);
+    void Store(const std::string& cacheFile) const;
+    bool Attach(const uint8_t* image, size_t length, const Header& expected);
+    static bool Validate(const Header& header, const uint8_t* sections, const uint64_t offsets[7]);
+    static void ParseSymbols(Tables& tables, StringPool& pool, const uint8_t* data, size_t length);
+    static void ParseDataTypes(Tables& tables, StringPool& pool, const uint8_t* data, size_t length);
+    const char* String(uint32_t offset) const;
+};
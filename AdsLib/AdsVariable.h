@@ -1,64 +1,103 @@
 #pragma once
 
 #include "AdsDevice.h"
+#include "AdsDecodePlan.h"
+#include "AdsLayout.h"
 
+/**
+ * Values are converted from little endian to host byte order, see AdsCodec. If T is
+ * described by an AdsLayout, the size of its packed layout is validated against the
+ * PLC symbol, when the variable is constructed by name or from an AdsSymbol.
+ */
 template<typename T>
 struct AdsVariable {
+    /**
+     * variables with the same symbolName on the same route share their handle, see AdsDevice::GetSharedHandle().
+     * The size of the symbol, which is validated for described types, is cached together with the handle.
+     */
     AdsVariable(const AdsDevice& route, const std::string& symbolName)
         : m_Route(route),
         m_IndexGroup(ADSIGRP_SYM_VALBYHND),
-        m_Handle(route.GetHandle(symbolName))
-    {}
+        m_IndexOffset(0),
+        m_Symbol(route.GetSharedHandle(symbolName))
+    {
+        if (AdsCodec<T>::Described()) {
+            Validate(m_Symbol->Size());
+        }
+    }
 
     AdsVariable(const AdsDevice& route, const uint32_t group, const uint32_t offset)
         : m_Route(route),
         m_IndexGroup(group),
-        m_Handle(route.GetHandle(offset))
+        m_IndexOffset(offset)
     {}
 
+    /** access a symbol of an AdsSymbolTable directly by its location, without acquiring a handle */
+    AdsVariable(const AdsDevice& route, const AdsSymbol& symbol)
+        : AdsVariable(route, symbol.indexGroup, symbol.indexOffset)
+    {
+        if (AdsCodec<T>::Described()) {
+            Validate(symbol.size);
+        }
+    }
+
     operator T() const
     {
-        T buffer;
-        Read(sizeof(buffer), &buffer);
-        return buffer;
+        return Load<T>();
     }
 
     void operator=(const T& value) const
     {
-        Write(sizeof(T), &value);
+        Store(value);
     }
 
     template<typename U, size_t N>
     operator std::array<U, N>() const
     {
-        std::array<U, N> buffer;
-        Read(sizeof(U) * N, buffer.data());
-        return buffer;
+        return Load<std::array<U, N> >();
     }
 
     template<typename U, size_t N>
     void operator=(const std::array<U, N>& value) const
     {
-        Write(sizeof(U) * N, value.data());
+        Store(value);
     }
 
     void Read(const size_t size, void* data) const
     {
         uint32_t bytesRead = 0;
         auto error = m_Route.ReadReqEx2(m_IndexGroup,
-                                        *m_Handle,
+                                        IndexOffset(),
                                         size,
                                         data,
                                         &bytesRead);
 
+        if (Retry(error)) {
+            error = m_Route.ReadReqEx2(m_IndexGroup, IndexOffset(), size, data, &bytesRead);
+        }
         if (error || (size != bytesRead)) {
             throw AdsException(error);
         }
     }
 
+    /**
+     * Read count elements of a structured data type and decode them into values, see
+     * AdsDecodePlan::Decode(). buffer is reused between reads and has to outlive
+     * STRING and BYTES values.
+     */
+    void Read(const AdsDecodePlan& plan, std::vector<uint8_t>& buffer, AdsValue* values, const size_t count = 1) const
+    {
+        buffer.resize(plan.Size() * count);
+        Read(buffer.size(), buffer.data());
+        plan.Decode(buffer.data(), buffer.size(), values, count);
+    }
+
     void Write(const size_t size, const void* data) const
     {
-        auto error = m_Route.WriteReqEx(m_IndexGroup, *m_Handle, size, data);
+        auto error = m_Route.WriteReqEx(m_IndexGroup, IndexOffset(), size, data);
+        if (Retry(error)) {
+            error = m_Route.WriteReqEx(m_IndexGroup, IndexOffset(), size, data);
+        }
         if (error) {
             throw AdsException(error);
         }
@@ -66,5 +105,87 @@ struct AdsVariable {
 private:
     const AdsDevice& m_Route;
     const uint32_t m_IndexGroup;
-    const AdsHandle m_Handle;
+    const uint32_t m_IndexOffset;
+    const std::shared_ptr<AdsSharedHandle> m_Symbol;
+
+    static void Validate(const uint32_t size)
+    {
+        if (AdsCodec<T>::Size() != size) {
+            throw AdsException(ADSERR_DEVICE_INVALIDSIZE);
+        }
+    }
+
+    /** small values are converted on the stack, larger ones on the heap */
+    static const size_t STACK_BUFFER_SIZE = 256;
+
+    template<typename X>
+    X Load() const
+    {
+        X value;
+        Load(value, std::integral_constant<bool, AdsCodec<X>::InPlace()> {});
+        return value;
+    }
+
+    template<typename X>
+    void Load(X& value, std::true_type) const
+    {
+        Read(sizeof(value), &value);
+        AdsCodec<X>::ToHost(value);
+    }
+
+    template<typename X>
+    void Load(X& value, std::false_type) const
+    {
+        const size_t size = AdsCodec<X>::Size();
+        uint8_t local[(size && (size <= STACK_BUFFER_SIZE)) ? size : 1];
+        std::vector<uint8_t> heap((size <= STACK_BUFFER_SIZE) ? 0 : size);
+        const auto buffer = heap.empty() ? local : heap.data();
+        Read(size, buffer);
+        AdsCodec<X>::Decode(buffer, value);
+    }
+
+    template<typename X>
+    void Store(const X& value) const
+    {
+        Store(value, std::integral_constant<bool, AdsCodec<X>::InPlace()> {});
+    }
+
+    template<typename X>
+    void Store(const X& value, std::true_type) const
+    {
+        if (!bhf::ads::IsBigEndian()) {
+            Write(sizeof(value), &value);
+            return;
+        }
+        /* swapping the byte order is symmetric */
+        X copy = value;
+        AdsCodec<X>::ToHost(copy);
+        Write(sizeof(copy), &copy);
+    }
+
+    template<typename X>
+    void Store(const X& value, std::false_type) const
+    {
+        const size_t size = AdsCodec<X>::Size();
+        uint8_t local[(size && (size <= STACK_BUFFER_SIZE)) ? size : 1];
+        std::vector<uint8_t> heap((size <= STACK_BUFFER_SIZE) ? 0 : size);
+        const auto buffer = heap.empty() ? local : heap.data();
+        AdsCodec<X>::Encode(value, buffer);
+        Write(size, buffer);
+    }
+
+    uint32_t IndexOffset() const
+    {
+        return m_Symbol ? m_Symbol->Get() : m_IndexOffset;
+    }
+
+    /** the online change might not have been notified yet, when the old handle was used */
+    bool Retry(const long error) const
+    {
+        if (m_Symbol && (ADSERR_DEVICE_SYMBOLVERSIONINVALID == error)) {
+            m_Symbol->Invalidate();
+            return true;
+        }
+        return false;
+    }
 };
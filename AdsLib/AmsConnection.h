@@ -23,20 +23,27 @@
 #pragma once
 
 #include "AmsPort.h"
+#include "AmsReactor.h"
+#include "MirrorRingBuffer.h"
+#include "NodePool.h"
 #include "Sockets.h"
 #include "Router.h"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <set>
 #include <thread>
+#include <vector>
 
 using Timepoint = std::chrono::steady_clock::time_point;
 #define WAITING_FOR_RESPONSE ((uint32_t)0xFFFFFFFF)
+#define WAITING_PARKED ((uint32_t)0xFFFFFFFE)
 
 struct AmsRequest {
     Frame frame;
-    const AmsAddr& destAddr;
+    const AmsAddr destAddr;
     uint16_t port;
     uint16_t cmdId;
     uint32_t bufferLength;
@@ -44,6 +51,11 @@ struct AmsRequest {
     uint32_t* bytesRead;
     Timepoint deadline;
 
+    /** user data, which is sent after the frame without copying it into the frame */
+    const SocketBuffer* payload;
+    size_t numPayload;
+    uint32_t payloadLength;
+
     AmsRequest(const AmsAddr& ams,
                uint16_t       __port,
                uint16_t       __cmdId,
@@ -57,62 +69,261 @@ struct AmsRequest {
         cmdId(__cmdId),
         bufferLength(__bufferLength),
         buffer(__buffer),
-        bytesRead(__bytesRead)
+        bytesRead(__bytesRead),
+        payload(nullptr),
+        numPayload(0),
+        payloadLength(0)
     {}
 
+    AmsRequest(const AmsRequest&) = delete;
+    AmsRequest& operator=(const AmsRequest&) = delete;
+
+    /**
+     * Append data to the request by reference. The data has to stay valid, until
+     * the request was passed to AmsConnection::AdsRequest() or AdsRequestAsync().
+     */
+    void SetPayload(const void* data, uint32_t length)
+    {
+        single = SocketBuffer { data, length };
+        SetPayloadBuffers(&single, 1);
+    }
+
+    /** Append data from several buffers by reference, the buffers are sent in the given order. */
+    void SetPayloadBuffers(const SocketBuffer* buffers, size_t numBuffers)
+    {
+        payload = buffers;
+        numPayload = numBuffers;
+        size_t length = 0;
+        for (size_t i = 0; i < numBuffers; ++i) {
+            length += buffers[i].length;
+        }
+        payloadLength = static_cast<uint32_t>(length);
+    }
+
     void SetDeadline(uint32_t tmms)
     {
         deadline = std::chrono::steady_clock::now();
         deadline += std::chrono::milliseconds(tmms);
     }
+
+private:
+    SocketBuffer single;
 };
 
+/**
+ * Completion handler of an asynchronous request. It is called from the receive
+ * thread of the connection, so it should return quickly.
+ */
+using AmsCompletion = std::function<void (long status, uint32_t bytesRead)>;
+
 struct AmsResponse {
-    std::atomic<AmsRequest*> request;
+    AmsRequest* const request;
     std::atomic<uint32_t> invokeId;
 
-    AmsResponse();
-    void Notify(uint32_t error);
-    void Release();
+    /** true if nobody waits for this response in Wait(), its deadline is supervised by the AmsConnection instead */
+    const bool detached;
+
+    AmsResponse(AmsRequest& __request, bool __detached = false);
+    virtual ~AmsResponse() {}
+    virtual void Notify(uint32_t error);
 
-    // wait for response or timeout and return received errorCode or ADSERR_CLIENT_SYNCTIMEOUT
-    uint32_t Wait();
+    /**
+     * wait for response or timeout and return received errorCode or ADSERR_CLIENT_SYNCTIMEOUT.
+     * For up to spinTime microseconds the result is polled, before the thread goes to sleep.
+     */
+    uint32_t Wait(uint32_t spinTime = 0);
 
 private:
+    /**
+     * WAITING_FOR_RESPONSE, WAITING_PARKED while Wait() sleeps on cv or the result.
+     * mutex and cv are only used, if the response didn't arrive while spinning.
+     */
+    std::atomic<uint32_t> state;
     std::mutex mutex;
     std::condition_variable cv;
-    uint32_t errorCode;
+};
+
+/**
+ * Response of a request issued with AmsConnection::AdsRequestAsync(). It owns
+ * its request and destroys itself after the completion handler was called.
+ * The response is shared by the writer and the receive thread, which may
+ * complete it before the write returned. Whichever of Notify() and Sent()
+ * comes last calls the completion handler, so the request and its payload
+ * are never released while they are still written to the socket.
+ */
+struct AmsAsyncResponse : AmsResponse {
+    AmsAsyncResponse(std::unique_ptr<AmsRequest> __request, AmsCompletion __completion);
+    void Notify(uint32_t error) override;
+
+    /** Called by the writer after the request was written completely */
+    void Sent();
+
+private:
+    const std::unique_ptr<AmsRequest> owner;
+    const AmsCompletion completion;
+    uint32_t bytesRead;
+    uint32_t result;
+    std::atomic<uint32_t> references;
+
+    void Unref();
 };
 
 struct AmsConnection {
-    AmsConnection(Router& __router, IpV4 destIp = IpV4 { "" });
+    AmsConnection(Router&              __router,
+                  IpV4                 destIp = IpV4 { "" },
+                  AmsReactor*          reactor = nullptr,
+                  const SocketOptions& options = SocketOptions {},
+                  NotificationPool*    notificationPool = nullptr);
     ~AmsConnection();
 
     SharedDispatcher CreateNotifyMapping(uint32_t hNotify, std::shared_ptr<Notification> notification);
     long DeleteNotification(const AmsAddr& amsAddr, uint32_t hNotify, uint32_t tmms, uint16_t port);
-    long AdsRequest(AmsRequest& request, uint32_t timeout);
+
+    /**
+     * Delete many notifications with ADSIGRP_SUMUP_DELDEVNOTE, falls back to one
+     * request per notification, if the target doesn't support sum commands.
+     */
+    long DeleteNotifications(const AmsAddr&               amsAddr,
+                             const std::vector<uint32_t>& hNotify,
+                             uint32_t                     tmms,
+                             long*                        errors,
+                             uint16_t                     port);
+    long AdsRequest(AmsRequest& request, uint32_t timeout, uint32_t spinTime = 0);
+
+    /**
+     * Like AdsRequest(), but a READ or WRITE is merged with the concurrent requests
+     * of other threads to the same target into one ADSIGRP_SUMUP_READ/WRITE. A batch
+     * is sent, when window microseconds elapsed and the previous batch of the same
+     * kind completed or when it is full. Other commands are passed to AdsRequest().
+     */
+    long AdsRequestCoalesced(AmsRequest& request, uint32_t timeout, uint32_t spinTime, uint32_t window);
+
+    /**
+     * Send request without waiting for the response. On success completion is
+     * called exactly once, either with the response or when the timeout elapsed.
+     * If an error is returned, completion is never called.
+     */
+    long AdsRequestAsync(std::unique_ptr<AmsRequest> request, uint32_t timeout, AmsCompletion completion);
+
+    /** number of requests, which are still waiting for their response */
+    size_t Outstanding();
+
+    /** dispatchers of the notifications, which were added by port */
+    std::vector<SharedDispatcher> GetDispatchers(uint16_t port);
 
 private:
     friend struct AmsRouter;
+    friend struct AmsReactor;
     Router& router;
     TcpSocket socket;
     std::thread receiver;
+    AmsReactor* const reactor;
+    NotificationPool* const notificationPool;
     std::atomic<size_t> refCount;
     std::atomic<uint32_t> invokeId;
-    std::array<AmsResponse, Router::NUM_PORTS_MAX> queue;
-
-    template<class T> void ReceiveFrame(AmsResponse* response, size_t length, uint32_t aoeError) const;
-    bool ReceiveNotification(const AoEHeader& header);
-    void ReceiveJunk(size_t bytesToRead) const;
-    void Receive(void* buffer, size_t bytesToRead, timeval* timeout = nullptr) const;
-    void Receive(void* buffer, size_t bytesToRead, const Timepoint& deadline) const;
-    template<class T> void Receive(T& buffer) const { Receive(&buffer, sizeof(T)); }
-    AmsResponse* Write(AmsRequest& request, const AmsAddr srcAddr);
+    std::mutex writeMutex;
+
+    /**
+     * responses, which are still waiting for a frame from the remote side, are tracked by their invokeId.
+     * The nodes of these containers are recycled, so that a request doesn't cause heap allocations.
+     */
+    NodePool pendingPool;
+    NodePool deadlinesPool;
+    std::map<uint32_t, AmsResponse*, std::less<uint32_t>,
+             PoolAllocator<std::pair<const uint32_t, AmsResponse*> > > pending;
+    std::set<std::pair<Timepoint, uint32_t>, std::less<std::pair<Timepoint, uint32_t> >,
+             PoolAllocator<std::pair<Timepoint, uint32_t> > > deadlines;
+    std::mutex pendingMutex;
+    bool receiving;
+
+    /** set by Orphan(), only accessed by the receive thread */
+    bool orphaned;
+
+    /**
+     * upper bound for the receive thread to wait for data, before it checks
+     * deadlines of detached responses again. Timeouts of asynchronous requests
+     * are detected with this granularity.
+     */
+    static const uint32_t EXPIRE_INTERVAL_MS = 100;
+
+    /** raw data from the socket, which wasn't processed yet. Every frame in it is contiguous. */
+    std::unique_ptr<MirrorRingBuffer> rxBuffer;
+    static const size_t RX_CHUNK_SIZE = 64 * 1024;
+
+    /** frames announcing more than this are considered corrupt and close the connection */
+    static const size_t RX_MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+    /** a grown rxBuffer is only shrunk again, after this many calls to Receive() saw no frame larger than RX_CHUNK_SIZE */
+    static const size_t RX_SHRINK_CYCLES = 1024;
+    size_t rxSmallCycles;
+
+    template<class T> void ReceiveFrame(AmsResponse* response, const uint8_t* payload, size_t length,
+                                        uint32_t aoeError) const;
+    void ReceiveFrame(uint8_t* frame, size_t length);
+    bool ReceiveNotification(const AoEHeader& header, uint8_t* data);
+
+    /**
+     * read all available data with a single call to recv() and process all complete frames.
+     * Throws a std::runtime_error, if the connection was closed or its data is corrupt.
+     */
+    void Receive();
+
+    /** send request and register response as pending, returns the invokeId of the request or 0 on error */
+    uint32_t Write(AmsRequest& request, const AmsAddr srcAddr, AmsResponse& response);
     void Recv();
     void TryRecv();
+    void StopReceiving();
+
+    /**
+     * Called instead of the destructor, when the last route of this connection is
+     * deleted by a callback on its own receive thread, which can't join itself.
+     * Returns false, if the calling thread isn't the receive thread. Otherwise the
+     * socket is shut down and the receive thread deletes the connection on exit.
+     */
+    bool Orphan();
     uint32_t GetInvokeId();
-    AmsResponse* Reserve(AmsRequest* request, uint16_t port);
+    uint32_t Reserve(AmsResponse* response);
+    void Release(AmsResponse* response, uint32_t id);
     AmsResponse* GetPending(uint32_t id, uint16_t port);
+    void Expire(const Timepoint& now);
+    timeval NextExpiry();
+
+    /** a request waiting in AdsRequestCoalesced(), result and done are protected by coalescingMutex */
+    struct CoalescedRequest {
+        AmsRequest* const request;
+        long result;
+        bool done;
+
+        /** the target doesn't support sum commands, the request has to be sent on its own */
+        bool resend;
+    };
+
+    /** requests which are sent together, owned by the thread which sends them */
+    struct CoalescedBatch {
+        std::vector<CoalescedRequest*> requests;
+        size_t length;
+
+        /** a request didn't fit anymore, the batch is sent without waiting for the end of its window */
+        bool full;
+        bool Accepts(size_t length) const;
+    };
+
+    struct CoalescingQueue {
+        CoalescingQueue();
+        CoalescedBatch* open;
+        size_t inFlight;
+        bool unsupported;
+
+        /** threads in AdsRequestCoalesced() referring to this queue, it is only erased without any */
+        size_t users;
+    };
+
+    /** requests are merged per source port, target and command */
+    using CoalescingKey = std::pair<VirtualConnection, uint16_t>;
+    std::map<CoalescingKey, CoalescingQueue> coalescing;
+    std::mutex coalescingMutex;
+    std::condition_variable coalescingCv;
+    long SendCoalesced(CoalescedBatch& batch, uint32_t timeout, uint32_t spinTime);
 
     std::map<VirtualConnection, SharedDispatcher> dispatcherList;
     std::recursive_mutex dispatcherListMutex;
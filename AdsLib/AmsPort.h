@@ -30,14 +30,26 @@ struct AmsPort {
     bool IsOpen() const;
     uint16_t Open(uint16_t __port);
     uint32_t tmms;
+    uint32_t spinTime;
+    bool coalesce;
+    uint32_t coalesceWindow;
+    uint32_t notificationCapacity;
+    ADSNOTIFICATIONOVERFLOW notificationOverflow;
+    ADSNOTIFICATIONDELIVERY notificationDelivery;
     uint16_t port;
 
+    /** dispatcher is configured with notificationCapacity, notificationOverflow and notificationDelivery */
     void AddNotification(AmsAddr ams, uint32_t hNotify, SharedDispatcher dispatcher);
     long DelNotification(AmsAddr ams, uint32_t hNotify);
+    long DelNotifications(AmsAddr ams, const uint32_t* hNotify, uint32_t numNotify, long* errors);
 
 private:
     using NotifyUUID = std::pair<const AmsAddr, const uint32_t>;
     static const uint32_t DEFAULT_TIMEOUT = 5000;
     std::map<NotifyUUID, SharedDispatcher> dispatcherList;
     std::mutex mutex;
+
+    /** notifications of the same dispatcher are deleted together */
+    using DispatcherBatch = std::pair<SharedDispatcher, std::vector<uint32_t> >;
+    static void Erase(std::map<NotificationDispatcher*, DispatcherBatch>& batches, uint32_t tmms);
 };
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+struct AmsConnection;
+
+/**
+ * Event loop, which multiplexes the sockets of many AmsConnections onto a few
+ * receive threads. Without a reactor every AmsConnection runs its own receive
+ * thread. Only available on Linux, as it is based on epoll.
+ *
+ * Completion handlers and notification callbacks run on the loop thread, but
+ * without holding any lock of the reactor. A callback can delete connections,
+ * even its own one, see Retire().
+ */
+struct AmsReactor {
+    /** upper limit for numThreads, more loops than cores only add context switches */
+    static const size_t MAX_THREADS = 64;
+
+    AmsReactor(size_t numThreads);
+    ~AmsReactor();
+
+    /** start receiving for connection on the least busy thread */
+    void Add(AmsConnection* connection);
+
+    /**
+     * After Remove() returned, the reactor will not access connection anymore.
+     * If the connection is just receiving, Remove() waits until it is done.
+     */
+    void Remove(AmsConnection* connection);
+
+    /**
+     * Called from a loop thread, the reactor takes ownership of connections and
+     * destroys them after the events, which are currently processed. Connections
+     * can't be destroyed right away, as one of them might be on the call stack.
+     * @return false, if the caller is no loop thread and has to destroy connections itself
+     */
+    bool Retire(std::vector<std::unique_ptr<AmsConnection> >& connections);
+
+private:
+    struct Loop {
+        Loop();
+        ~Loop();
+        void Run();
+        void Stop();
+        bool Acquire(AmsConnection* connection);
+        void Release(AmsConnection* connection, bool closed);
+        void DestroyRetired();
+
+        const int epollFd;
+        const int wakeFd;
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::set<AmsConnection*> connections;
+
+        /** connection, which is used by the loop thread right now, it must not be destroyed */
+        AmsConnection* active;
+
+        /** only accessed by the loop thread itself, or after it was stopped */
+        std::vector<std::unique_ptr<AmsConnection> > retired;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<Loop> > loops;
+};
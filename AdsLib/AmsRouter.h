@@ -34,22 +34,69 @@ struct AmsRouter : Router {
     void SetLocalAddress(AmsNetId netId);
     long GetTimeout(uint16_t port, uint32_t& timeout);
     long SetTimeout(uint16_t port, uint32_t timeout);
+    long SetSpinTime(uint16_t port, uint32_t spinTime);
+    long SetCoalescing(uint16_t port, bool enable, uint32_t window);
+    long SetNotificationBuffer(uint16_t port, uint32_t capacity, ADSNOTIFICATIONOVERFLOW overflow);
+    long SetNotificationDelivery(uint16_t port, ADSNOTIFICATIONDELIVERY delivery);
+    long GetNotificationStatistics(uint16_t port, const AmsAddr& addr, AdsNotificationStatistics& statistics);
     long AddNotification(AmsRequest& request, uint32_t* pNotification, std::shared_ptr<Notification> notify);
+    long AddNotifications(AmsRequest&                                         request,
+                          const std::vector<AdsAddDeviceNotificationRequest>& attribs,
+                          const std::vector<std::shared_ptr<Notification> >&  notify,
+                          uint32_t*                                           pNotifications,
+                          long*                                               errors);
     long DelNotification(uint16_t port, const AmsAddr* pAddr, uint32_t hNotification);
+    long DelNotifications(uint16_t port, const AmsAddr* pAddr, const uint32_t* hNotifications, uint32_t count,
+                          long* errors);
 
-    long AddRoute(AmsNetId ams, const IpV4& ip);
+    long SetReceiveThreads(uint32_t numThreads);
+    long SetNotificationThreads(uint32_t numThreads);
+    long AddRoute(AmsNetId             ams,
+                  const IpV4&          ip,
+                  const SocketOptions& options = SocketOptions {},
+                  size_t               numConnections = 1);
+
+    /**
+     * Add many routes at once. Connections to new targets are established in
+     * parallel and without holding the router lock, so a slow or unreachable
+     * target doesn't delay the others or concurrent requests.
+     * @return error code of each route in the order of routes
+     */
+    std::vector<long> AddRoutes(const std::vector<std::pair<AmsNetId, IpV4> >& routes, const SocketOptions& options);
     void DelRoute(const AmsNetId& ams);
     AmsConnection* GetConnection(const AmsNetId& pAddr);
     long AdsRequest(AmsRequest& request);
+    long AdsRequestAsync(std::unique_ptr<AmsRequest> request, AmsCompletion completion);
 
 private:
     AmsNetId localAddr;
     std::recursive_mutex mutex;
+    std::unique_ptr<AmsReactor> reactor;
+    std::unique_ptr<NotificationPool> notificationPool;
+    size_t connecting;
+
+    /** number of DelRoute() calls, which destroy connections without holding the lock */
+    size_t closing;
     std::map<IpV4, std::unique_ptr<AmsConnection> > connections;
     std::map<AmsNetId, AmsConnection*> mapping;
 
+    /**
+     * additional connections of a route, which carry requests with at least
+     * BULK_THRESHOLD bytes of data, so they don't block small requests on
+     * the primary connection.
+     */
+    std::map<IpV4, std::vector<std::unique_ptr<AmsConnection> > > bulkConnections;
+    static const size_t BULK_THRESHOLD = 16 * 1024;
+
+    /** numConnections of the AddRoute() call, which created the connections to a target */
+    std::map<IpV4, size_t> requestedConnections;
+
     std::map<IpV4, std::unique_ptr<AmsConnection> >::iterator __GetConnection(const AmsNetId& pAddr);
-    void DeleteIfLastConnection(const AmsConnection* conn);
+    AmsConnection* SelectConnection(const AmsRequest& request);
+    size_t NumConnections(const IpV4& ip) const;
+    long MapRoute(AmsNetId ams, AmsConnection* conn);
+    void DeleteIfLastConnection(const AmsConnection* conn, std::vector<std::unique_ptr<AmsConnection> >& unused);
+    std::vector<SharedDispatcher> GetDispatchers(uint16_t port);
 
     std::array<AmsPort, NUM_PORTS_MAX> ports;
 };
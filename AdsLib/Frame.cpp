@@ -27,19 +27,122 @@
 #include <cstring>
 #include <new>
 
+namespace
+{
+thread_local bool cacheDestroyed = false;
+
+/**
+ * Heap buffers of destroyed frames are kept per thread, to serve the next
+ * large frame without a trip to the allocator. Larger buffers are released
+ * immediately, so a thread never retains more than Frame::MAX_CACHED_BYTES.
+ */
+struct FrameCache {
+    static const size_t NUM_BUFFERS = 4;
+    static const size_t MAX_BUFFER_SIZE = 64 * 1024;
+    static_assert(NUM_BUFFERS * MAX_BUFFER_SIZE <= Frame::MAX_CACHED_BYTES, "FrameCache exceeds its limit");
+
+    ~FrameCache()
+    {
+        /* frames destroyed during thread exit must not use the cache anymore */
+        cacheDestroyed = true;
+    }
+
+    std::unique_ptr<uint8_t[]> Get(size_t& length)
+    {
+        if (cacheDestroyed) {
+            return std::unique_ptr<uint8_t[]>(new uint8_t[length]);
+        }
+        Entry* best = nullptr;
+        for (auto& e : entries) {
+            if (e.buffer && (e.size >= length) && (!best || (e.size < best->size))) {
+                best = &e;
+            }
+        }
+        if (!best) {
+            return std::unique_ptr<uint8_t[]>(new uint8_t[length]);
+        }
+        length = best->size;
+        return std::move(best->buffer);
+    }
+
+    void Put(std::unique_ptr<uint8_t[]> buffer, const size_t length)
+    {
+        if (cacheDestroyed || (length > MAX_BUFFER_SIZE)) {
+            return;
+        }
+
+        /* replace an empty slot or the smallest cached buffer */
+        Entry* victim = &entries[0];
+        for (auto& e : entries) {
+            if (!e.buffer) {
+                victim = &e;
+                break;
+            }
+            if (e.size < victim->size) {
+                victim = &e;
+            }
+        }
+        if (!victim->buffer || (victim->size < length)) {
+            victim->buffer = std::move(buffer);
+            victim->size = length;
+        }
+    }
+
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& e : entries) {
+            bytes += e.buffer ? e.size : 0;
+        }
+        return bytes;
+    }
+
+private:
+    struct Entry {
+        std::unique_ptr<uint8_t[]> buffer;
+        size_t size;
+    };
+    Entry entries[NUM_BUFFERS] {};
+};
+
+thread_local FrameCache cache;
+}
+
 Frame::Frame(size_t length, const void* data)
-    : m_Data(new uint8_t[length])
+    : m_Data(m_Inline),
+    m_OriginalSize(INLINE_SIZE)
 {
-    m_Size = m_Data ? length : 0;
-    m_Pos = m_Data.get() + m_Size;
-    m_OriginalSize = m_Size;
+    if (length > INLINE_SIZE) {
+        size_t size = length;
+        auto buffer = cache.Get(size);
+        assign(std::move(buffer), size);
+    }
+    m_Size = m_OriginalSize;
+    m_Pos = m_Data + m_Size;
 
-    if (m_Pos && data) {
+    if (data) {
         m_Pos -= length;
         memcpy(m_Pos, data, length);
     }
 }
 
+Frame::~Frame()
+{
+    if (m_Heap) {
+        cache.Put(std::move(m_Heap), m_OriginalSize);
+    }
+}
+
+void Frame::assign(std::unique_ptr<uint8_t[]> buffer, const size_t size)
+{
+    if (m_Heap) {
+        cache.Put(std::move(m_Heap), m_OriginalSize);
+    }
+    m_Heap = std::move(buffer);
+    m_Data = m_Heap.get();
+    m_OriginalSize = size;
+}
+
 uint8_t Frame::operator[](size_t index) const
 {
     return m_Pos[index];
@@ -63,7 +166,7 @@ const uint8_t* Frame::data() const
 Frame& Frame::limit(size_t newSize)
 {
     m_Size = std::min(m_Size, newSize);
-    m_Pos = m_Data.get();
+    m_Pos = m_Data;
     return *this;
 }
 
@@ -71,31 +174,32 @@ Frame& Frame::reset(const size_t newSize)
 {
     if (newSize > m_OriginalSize) {
         try {
-            std::unique_ptr<uint8_t[]> tmp {new uint8_t[newSize]};
-            m_OriginalSize = newSize;
-            m_Data = std::move(tmp);
+            size_t size = newSize;
+            auto buffer = cache.Get(size);
+            assign(std::move(buffer), size);
         } catch (const std::bad_alloc&) {
             LOG_WARN("Not enough memory to reset frame to " << std::dec << newSize << " bytes");
         }
     }
 
     m_Size = m_OriginalSize;
-    m_Pos = m_Data.get() + m_Size;
+    m_Pos = m_Data + m_Size;
     return *this;
 }
 
 Frame& Frame::prepend(const void* const data, const size_t size)
 {
-    const size_t bytesFree = m_Pos - m_Data.get();
+    const size_t bytesFree = m_Pos - m_Data;
     if (size > bytesFree) {
-        auto newData = new uint8_t[size + m_Size];
-
-        m_Pos = newData + bytesFree + size;
-        memcpy(m_Pos, m_Data.get() + bytesFree, m_Size - bytesFree);
-        m_Data.reset(newData);
-        m_Size += size;
-        m_OriginalSize = m_Size;
-        m_Pos = m_Data.get() + bytesFree;
+        size_t newSize = size + m_Size;
+        auto newData = cache.Get(newSize);
+
+        /* move the current content to the end of the new buffer */
+        const size_t used = m_Size - bytesFree;
+        memcpy(newData.get() + newSize - used, m_Pos, used);
+        assign(std::move(newData), newSize);
+        m_Size = newSize;
+        m_Pos = m_Data + newSize - used - size;
     } else {
         m_Pos -= size;
     }
@@ -105,16 +209,21 @@ Frame& Frame::prepend(const void* const data, const size_t size)
 
 uint8_t* Frame::rawData() const
 {
-    return m_Data.get();
+    return m_Data;
 }
 
 Frame& Frame::remove(size_t numBytes)
 {
-    m_Pos = std::min<uint8_t*>(m_Pos + numBytes, m_Data.get() + m_Size);
+    m_Pos = std::min<uint8_t*>(m_Pos + numBytes, m_Data + m_Size);
     return *this;
 }
 
 size_t Frame::size() const
 {
-    return m_Size - (m_Pos - m_Data.get());
+    return m_Size - (m_Pos - m_Data);
+}
+
+size_t Frame::cachedBytes()
+{
+    return cacheDestroyed ? 0 : cache.Bytes();
 }
@@ -15,6 +15,9 @@ struct Frame {
      * @param data, if not null this frame will be initialized with <lenght> number of bytes from <data>
      */
     Frame(size_t length, const void* data = nullptr);
+    ~Frame();
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
 
     /**
      * @brief operator []
@@ -132,9 +135,33 @@ struct Frame {
      */
     size_t size() const;
 
+    /**
+     * Heap buffers of destroyed frames are kept per thread and reused by the next
+     * frames of that thread, so steady traffic doesn't hit the allocator. Each
+     * thread retains at most MAX_CACHED_BYTES until it exits.
+     */
+    static const size_t MAX_CACHED_BYTES = 4 * 64 * 1024;
+
+    /**
+     * @brief cachedBytes
+     * @return number of bytes the calling thread currently retains for reuse
+     */
+    static size_t cachedBytes();
+
 private:
-    std::unique_ptr<uint8_t[]> m_Data;
+    /**
+     * Frames up to this size, which is enough for all AMS request headers,
+     * are stored inline, so common requests don't touch the heap at all.
+     */
+    static const size_t INLINE_SIZE = 96;
+
+    std::unique_ptr<uint8_t[]> m_Heap;
+    uint8_t* m_Data;
     uint8_t* m_Pos;
     size_t m_Size;
     size_t m_OriginalSize;
+    uint8_t m_Inline[INLINE_SIZE];
+
+    /** replace the current buffer with a heap buffer of <size> bytes, the old content is lost */
+    void assign(std::unique_ptr<uint8_t[]> buffer, size_t size);
 };
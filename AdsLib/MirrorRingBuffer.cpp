@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "MirrorRingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static size_t PageSize()
+{
+#if defined(__linux__)
+    const auto size = sysconf(_SC_PAGESIZE);
+    return (size > 0) ? static_cast<size_t>(size) : 4096;
+#else
+    return 4096;
+#endif
+}
+
+#if defined(__linux__)
+/** map a memfd twice into a reserved range, so that data[i] and data[i + capacity] share their memory */
+static uint8_t* MapMirror(const size_t capacity)
+{
+    const int fd = memfd_create("MirrorRingBuffer", MFD_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (ftruncate(fd, static_cast<off_t>(capacity))) {
+        close(fd);
+        return nullptr;
+    }
+
+    const auto reserved = mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == reserved) {
+        close(fd);
+        return nullptr;
+    }
+    const auto first = static_cast<uint8_t*>(reserved);
+    const auto lower = mmap(first, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    const auto upper = mmap(first + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+    if ((MAP_FAILED == lower) || (MAP_FAILED == upper)) {
+        munmap(reserved, 2 * capacity);
+        return nullptr;
+    }
+    return first;
+}
+#endif
+
+MirrorRingBuffer::MirrorRingBuffer(size_t N, const bool map)
+    : capacity(std::max<size_t>(1, (N + PageSize() - 1) / PageSize()) * PageSize()),
+    used(0),
+    data(nullptr),
+    mirrored(false)
+{
+#if defined(__linux__)
+    if (map) {
+        data = MapMirror(capacity);
+        mirrored = (nullptr != data);
+    }
+#else
+    (void)map;
+#endif
+    if (!data) {
+        /* without a second mapping, Write() copies into the other half */
+        data = new uint8_t[2 * capacity];
+    }
+    write = data;
+    read = data;
+}
+
+MirrorRingBuffer::~MirrorRingBuffer()
+{
+#if defined(__linux__)
+    if (mirrored) {
+        munmap(data, 2 * capacity);
+        return;
+    }
+#endif
+    delete[] data;
+}
+
+void MirrorRingBuffer::Write(size_t n)
+{
+    assert(n <= BytesFree());
+    if (!mirrored) {
+        /*
+         * write is always in the lower half, which holds the bytes. Bytes written into the
+         * upper half are copied down. Bytes in the lower half are only read through the upper
+         * half by a record, which starts in front of them at read, so they are only copied up
+         * while the available bytes wrap around.
+         */
+        const auto end = write + n;
+        const auto wrap = data + capacity;
+        if (read > write) {
+            memcpy(write + capacity, write, std::min(end, wrap) - write);
+        }
+        if (end > wrap) {
+            memcpy(data, wrap, end - wrap);
+        }
+    }
+    write = Wrap(write + n);
+    used += n;
+}
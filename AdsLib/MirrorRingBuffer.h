@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include "wrap_endian.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Ring buffer, which maps its memory twice into consecutive virtual addresses.
+ * Every record, which starts at the read or write pointer, is contiguous, even
+ * if it wraps around the end of the buffer. Headers and payloads can be accessed
+ * by single memcpy()s or pointers, without splitting them at the wrap around.
+ * On platforms without memfd_create() the two halves are kept in sync by copying
+ * instead, but only the bytes, which a record wrapping around might need.
+ */
+struct MirrorRingBuffer {
+    /**
+     * capacity is at least N bytes, rounded up to a multiple of the page size.
+     * map == false selects the copying fallback on every platform, e.g. for tests.
+     */
+    MirrorRingBuffer(size_t N, bool map = true);
+    ~MirrorRingBuffer();
+
+    MirrorRingBuffer(const MirrorRingBuffer&) = delete;
+    MirrorRingBuffer& operator=(const MirrorRingBuffer&) = delete;
+
+    size_t Capacity() const
+    {
+        return capacity;
+    }
+
+    /** true, if the memory is mapped twice instead of being copied */
+    bool Mirrored() const
+    {
+        return mirrored;
+    }
+
+    size_t BytesFree() const
+    {
+        return capacity - used;
+    }
+
+    size_t BytesAvailable() const
+    {
+        return used;
+    }
+
+    /** all free bytes are contiguous starting at write */
+    size_t WriteChunk() const
+    {
+        return BytesFree();
+    }
+
+    void Write(size_t n);
+
+    template<class T> T ReadFromLittleEndian()
+    {
+        assert(sizeof(T) <= BytesAvailable());
+        const auto result = bhf::ads::letoh<T>(read);
+        Read(sizeof(T));
+        return result;
+    }
+
+    void Read(size_t n)
+    {
+        assert(n <= BytesAvailable());
+        read = Wrap(read + n);
+        used -= n;
+    }
+
+private:
+    size_t capacity;
+    size_t used;
+    uint8_t* data;
+    bool mirrored;
+
+    template<class T> T* Wrap(T* ptr) const
+    {
+        return (ptr >= data + capacity) ? ptr - capacity : ptr;
+    }
+public:
+    uint8_t* write;
+
+    /** records might be modified in place, before they are Read() */
+    uint8_t* read;
+};
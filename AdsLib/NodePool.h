@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/**
+ * Keeps the nodes a node based container (std::map, std::set) releases for
+ * reuse, so that a container with a stable number of elements stops calling
+ * the allocator. NodePool is not thread-safe, accesses have to be serialized
+ * by the owner of the container.
+ */
+struct NodePool {
+    NodePool()
+        : blockSize(0),
+        head(nullptr)
+    {}
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool()
+    {
+        while (head) {
+            auto next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+
+    void* Allocate(size_t size)
+    {
+        if (!blockSize) {
+            blockSize = size;
+        }
+        if (head && (size == blockSize)) {
+            auto block = head;
+            head = head->next;
+            return block;
+        }
+        return ::operator new(size < sizeof(Block) ? sizeof(Block) : size);
+    }
+
+    void Deallocate(void* p, size_t size)
+    {
+        if (size != blockSize) {
+            ::operator delete(p);
+            return;
+        }
+        auto block = static_cast<Block*>(p);
+        block->next = head;
+        head = block;
+    }
+
+private:
+    struct Block {
+        Block* next;
+    };
+    size_t blockSize;
+    Block* head;
+};
+
+template<class T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator(NodePool& __pool)
+        : pool(&__pool)
+    {}
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>& other)
+        : pool(other.pool)
+    {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1) {
+            return static_cast<T*>(pool->Allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n == 1) {
+            pool->Deallocate(p, sizeof(T));
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    NodePool* pool;
+};
+
+template<class T, class U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return lhs.pool == rhs.pool;
+}
+
+template<class T, class U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return lhs.pool != rhs.pool;
+}
@@ -24,32 +24,176 @@
 
 #include "AdsNotification.h"
 #include "AmsHeader.h"
-#include "Semaphore.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 using DeleteNotificationCallback = std::function<long (uint32_t hNotify, uint32_t tmms)>;
+using DeleteNotificationsCallback = std::function<long (const std::vector<uint32_t>& hNotify, uint32_t tmms,
+                                                        long* errors)>;
 
-struct NotificationDispatcher {
-    NotificationDispatcher(DeleteNotificationCallback callback);
+struct NotificationPool;
+
+struct NotificationDispatcher : std::enable_shared_from_this<NotificationDispatcher> {
+    static const uint32_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+    /**
+     * Without a pool the dispatcher runs its own thread, with a pool the frames
+     * are dispatched by the workers of the pool instead.
+     */
+    NotificationDispatcher(DeleteNotificationCallback  callback,
+                           DeleteNotificationsCallback bulkCallback,
+                           NotificationPool*           pool = nullptr);
     ~NotificationDispatcher();
     void Emplace(uint32_t hNotify, std::shared_ptr<Notification> notification);
     long Erase(uint32_t hNotify, uint32_t tmms);
-    void Notify();
-    void Run();
+
+    /** delete many notifications with as few requests as possible, errors receives the result of each */
+    long Erase(const std::vector<uint32_t>& hNotify, uint32_t tmms, long* errors);
+
+    /**
+     * limit the bytes waiting to be dispatched, select what Post() does, when a frame
+     * doesn't fit anymore and whether Deliver() invokes the callbacks itself
+     */
+    void Configure(uint32_t capacity, ADSNOTIFICATIONOVERFLOW overflow, ADSNOTIFICATIONDELIVERY delivery);
+    AdsNotificationStatistics Statistics();
+
+    /** restore the default configuration and clear the statistics, e.g. when the port is closed */
+    void Reset();
+
+    /**
+     * Queue a copy of the notification frame for dispatching.
+     * @return false, if the frame was dropped
+     */
+    bool Post(const uint8_t* frame, uint32_t length);
+
+    /**
+     * With ADSDELIVERY_DIRECT the callbacks are invoked by the calling thread, with
+     * their headers built in place within frame. Queued frames have to be dispatched
+     * first, so the frame is posted instead, until the queue ran empty and no Dispatch()
+     * is scheduled anymore.
+     * @return false, if the frame was dropped
+     */
+    bool Deliver(uint8_t* frame, uint32_t length);
+
+    /** called by a worker of the pool to dispatch the frames posted so far */
+    void Dispatch();
 
     const DeleteNotificationCallback deleteNotification;
-    RingBuffer ring;
+    const DeleteNotificationsCallback deleteNotifications;
+    NotificationPool* const pool;
 private:
+    /** buffers grown beyond this by a burst of notifications are released after dispatching */
+    static const size_t MAX_IDLE_CAPACITY = 64 * 1024;
+
+    /**
+     * Open addressing hash table of hNotify with linear probing, which is read without
+     * locks or reference counting. Emplace() fills empty slots in place, Erase() marks
+     * slots as deleted. Once more than half of the slots are used, a larger copy is
+     * published instead. A slot is never reused, so a reader either sees the previous
+     * or the new state of every slot.
+     */
+    struct Table {
+        struct Slot {
+            std::atomic<uint32_t> hNotify;
+            std::atomic<Notification*> notification;
+        };
+
+        Table(size_t minCapacity);
+        const Notification* Find(uint32_t hNotify) const;
+        void Insert(uint32_t hNotify, Notification* notification);
+        void Remove(uint32_t hNotify);
+        bool Full() const;
+
+    private:
+        size_t used;
+        unsigned shift;
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+
+        size_t Index(uint32_t hNotify) const;
+    };
+
+    /**
+     * The owners of the notifications and the tables, which are modified under mutex.
+     * Only the holder of busy reads table: the thread of the dispatcher, a worker of
+     * the pool or the receiving thread with ADSDELIVERY_DIRECT. Erased notifications
+     * and replaced tables are retired and released by the reader, after its batch of
+     * frames, because it might still refer to them until then. Without a reader they
+     * are released right away by Emplace() and Erase().
+     */
     std::map<uint32_t, std::shared_ptr<Notification> > notifications;
-    std::recursive_mutex mutex;
-    Semaphore sem;
-    std::atomic<bool> stopExecution;
+    std::unique_ptr<Table> table;
+    std::atomic<const Table*> lookup;
+    std::vector<std::shared_ptr<Notification> > retiredNotifications;
+    std::vector<std::unique_ptr<Table> > retiredTables;
+    std::atomic<bool> retired;
+    std::mutex mutex;
+    bool stopExecution;
     std::thread thread;
 
-    std::shared_ptr<Notification> Find(uint32_t hNotify);
+    /**
+     * frames queued by Post() within [pending.begin() + pendingBegin, pending.end()),
+     * each prefixed with its length. The frames taken for dispatching are moved to
+     * dispatching, so they don't count against capacity. A dispatcher is scheduled
+     * to at most one worker at a time, so samples are still delivered in the order
+     * they were received.
+     */
+    std::mutex pendingMutex;
+    std::condition_variable posted;
+    std::condition_variable drained;
+    std::vector<uint8_t> pending;
+    size_t pendingBegin;
+    std::vector<uint8_t> dispatching;
+
+    /** Dispatch() passes samples, which are misaligned within dispatching, from here */
+    std::vector<uint64_t> aligned;
+    bool scheduled;
+
+    /** Dispatch() is working on the frames in dispatching, or Deliver() on a frame of its own */
+    bool busy;
+    uint32_t capacity;
+    ADSNOTIFICATIONOVERFLOW overflow;
+    ADSNOTIFICATIONDELIVERY delivery;
+    AdsNotificationStatistics statistics;
+
+    void Run();
+    void Remove(uint32_t hNotify);
+    void Reclaim();
+
+    /** Reclaim(), unless a reader is busy, which will do so after its batch */
+    void ReclaimIdle();
+    /** aligned is nullptr with ADSDELIVERY_DIRECT, as its samples are never copied */
+    void DispatchFrame(uint8_t* frame, uint32_t length, std::vector<uint64_t>* aligned);
+    void Drop(const uint8_t* frame, uint32_t length);
 };
 using SharedDispatcher = std::shared_ptr<NotificationDispatcher>;
+
+/**
+ * Fixed number of worker threads, which dispatch the notifications of all
+ * NotificationDispatchers created for it, instead of one thread per dispatcher.
+ */
+struct NotificationPool {
+    NotificationPool(size_t numThreads);
+    ~NotificationPool();
+
+    /** queue dispatcher to run Dispatch() on the next idle worker */
+    void Schedule(SharedDispatcher dispatcher);
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<SharedDispatcher> ready;
+    bool stop;
+    std::vector<std::thread> threads;
+
+    void Run();
+    void Stop();
+};
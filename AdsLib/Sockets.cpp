@@ -24,9 +24,11 @@
 #include "Log.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <climits>
 #include <cstring>
 #include <exception>
+#include <memory>
 #include <sstream>
 #include <system_error>
 
@@ -77,7 +79,8 @@ Socket::Socket(IpV4 ip, uint16_t port, int type)
     : m_WSAInitialized(!InitSocketLibrary()),
     m_Socket(socket(AF_INET, type, 0)),
     m_DestAddr(SOCK_DGRAM == type ? reinterpret_cast<const struct sockaddr*>(&m_SockAddress) : nullptr),
-    m_DestAddrLen(m_DestAddr ? sizeof(m_SockAddress) : 0)
+    m_DestAddrLen(m_DestAddr ? sizeof(m_SockAddress) : 0),
+    m_QuickAck(false)
 {
     if (INVALID_SOCKET == m_Socket) {
         throw std::system_error(WSAGetLastError(), std::system_category());
@@ -107,10 +110,21 @@ size_t Socket::read(uint8_t* buffer, size_t maxBytes, timeval* timeout) const
     if (!Select(timeout)) {
         return 0;
     }
+    return receive(buffer, maxBytes);
+}
 
+size_t Socket::receive(uint8_t* buffer, size_t maxBytes) const
+{
     maxBytes = static_cast<int>(std::min<size_t>(INT_MAX, maxBytes));
     const int bytesRead = recv(m_Socket, reinterpret_cast<char*>(buffer), maxBytes, 0);
     if (bytesRead > 0) {
+#ifdef TCP_QUICKACK
+        if (m_QuickAck) {
+            /* the kernel might fall back to delayed acks at any time, so we have to renew it after each read */
+            const int enable = 1;
+            setsockopt(m_Socket, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+        }
+#endif
         return bytesRead;
     }
     const auto lastError = WSAGetLastError();
@@ -159,6 +173,22 @@ bool Socket::Select(timeval* timeout) const
     return true;
 }
 
+bool Socket::Poll(timeval* timeout) const
+{
+    fd_set readSockets;
+    FD_ZERO(&readSockets);
+    FD_SET(m_Socket, &readSockets);
+
+    const int state = NATIVE_SELECT(m_Socket + 1, &readSockets, nullptr, nullptr, timeout);
+    if (SOCKET_ERROR == state) {
+        if (WSAGetLastError() == WSAENOTSOCK) {
+            throw std::runtime_error("connection closed");
+        }
+        return false;
+    }
+    return state > 0;
+}
+
 size_t Socket::write(const Frame& frame) const
 {
     if (frame.size() > INT_MAX) {
@@ -177,21 +207,193 @@ size_t Socket::write(const Frame& frame) const
     return status;
 }
 
-TcpSocket::TcpSocket(const IpV4 ip, const uint16_t port)
-    : Socket(ip, port, SOCK_STREAM)
+size_t Socket::write(const Frame& frame, const void* const payload, const size_t payloadLength) const
+{
+    const SocketBuffer buffer { payload, payloadLength };
+    return write(frame, &buffer, 1);
+}
+
+size_t Socket::write(const Frame& frame, const SocketBuffer* const buffers, const size_t numBuffers) const
+{
+    size_t length = frame.size();
+    for (size_t i = 0; i < numBuffers; ++i) {
+        length += buffers[i].length;
+    }
+    if (length == frame.size()) {
+        return write(frame);
+    }
+
+    /* small requests are described on the stack, only large sum requests need an allocation */
+    static const size_t NUM_INLINE_BUFFERS = 8;
+    const size_t count = numBuffers + 1;
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    iovec inlineIov[NUM_INLINE_BUFFERS];
+    std::unique_ptr<iovec[]> heapIov;
+    iovec* iov = inlineIov;
+    if (count > NUM_INLINE_BUFFERS) {
+        heapIov.reset(new iovec[count]);
+        iov = heapIov.get();
+    }
+    iov[0] = { const_cast<uint8_t*>(frame.data()), frame.size() };
+    for (size_t i = 0; i < numBuffers; ++i) {
+        iov[i + 1] = { const_cast<void*>(buffers[i].data), buffers[i].length };
+    }
+
+    size_t bytesSent = 0;
+    size_t first = 0;
+    while (bytesSent < length) {
+        msghdr msg {};
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = std::min<size_t>(count - first, MAX_IOV);
+        const ssize_t status = sendmsg(m_Socket, &msg, 0);
+        if (status < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("write frame failed with error: " << std::strerror(errno));
+            return 0;
+        }
+        bytesSent += status;
+
+        /* blocking sockets send partially only if interrupted or limited by MAX_IOV, continue with the remaining bytes */
+        size_t done = status;
+        while ((first < count) && (done >= iov[first].iov_len)) {
+            done -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < count) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + done;
+            iov[first].iov_len -= done;
+        }
+    }
+    return bytesSent;
+#else
+    if (length > ULONG_MAX) {
+        LOG_ERROR("frame length: " << length << " exceeds maximum length for sockets");
+        return 0;
+    }
+
+    WSABUF inlineBuffers[NUM_INLINE_BUFFERS];
+    std::unique_ptr<WSABUF[]> heapBuffers;
+    WSABUF* wsaBuffers = inlineBuffers;
+    if (count > NUM_INLINE_BUFFERS) {
+        heapBuffers.reset(new WSABUF[count]);
+        wsaBuffers = heapBuffers.get();
+    }
+    wsaBuffers[0] = { static_cast<ULONG>(frame.size()), reinterpret_cast<CHAR*>(const_cast<uint8_t*>(frame.data())) };
+    for (size_t i = 0; i < numBuffers; ++i) {
+        wsaBuffers[i + 1] = { static_cast<ULONG>(buffers[i].length), static_cast<CHAR*>(const_cast<void*>(buffers[i].data)) };
+    }
+    DWORD bytesSent = 0;
+    if (SOCKET_ERROR == WSASend(m_Socket, wsaBuffers, static_cast<DWORD>(count), &bytesSent, 0, nullptr, nullptr)) {
+        LOG_ERROR("write frame failed with error: " << std::strerror(WSAGetLastError()));
+        return 0;
+    }
+    return bytesSent;
+#endif
+}
+
+TcpSocket::TcpSocket(const IpV4 ip, const uint16_t port, const SocketOptions& options)
+    : Socket(ip, port, SOCK_STREAM),
+    m_ConnectTimeout(options.connectTimeout)
 {
     // AdsDll.lib seems to use TCP_NODELAY, we use it to be compatible
-    const int enable = 0;
-    if (setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable))) {
-        LOG_WARN("Enabling TCP_NODELAY failed");
+    const int noDelay = options.noDelay;
+    if (setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay))) {
+        LOG_WARN("Configuring TCP_NODELAY failed");
+    }
+
+    if (options.recvBufferSize > 0) {
+        if (setsockopt(m_Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&options.recvBufferSize,
+                       sizeof(options.recvBufferSize))) {
+            LOG_WARN("Setting SO_RCVBUF failed");
+        }
     }
+
+    if (options.sendBufferSize > 0) {
+        if (setsockopt(m_Socket, SOL_SOCKET, SO_SNDBUF, (const char*)&options.sendBufferSize,
+                       sizeof(options.sendBufferSize))) {
+            LOG_WARN("Setting SO_SNDBUF failed");
+        }
+    }
+
+    if (options.busyPoll > 0) {
+#ifdef SO_BUSY_POLL
+        if (setsockopt(m_Socket, SOL_SOCKET, SO_BUSY_POLL, (const char*)&options.busyPoll, sizeof(options.busyPoll))) {
+            LOG_WARN("Setting SO_BUSY_POLL failed");
+        }
+#else
+        LOG_WARN("SO_BUSY_POLL is not supported on this platform");
+#endif
+    }
+
+    if (options.quickAck) {
+#ifdef TCP_QUICKACK
+        m_QuickAck = true;
+#else
+        LOG_WARN("TCP_QUICKACK is not supported on this platform");
+#endif
+    }
+}
+
+static void SetNonBlocking(const SOCKET socket, const bool enable)
+{
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+    const int flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+#else
+    u_long mode = enable;
+    ioctlsocket(socket, FIONBIO, &mode);
+#endif
+}
+
+void TcpSocket::ConnectNonBlocking() const
+{
+    SetNonBlocking(m_Socket, true);
+    if (::connect(m_Socket, reinterpret_cast<const sockaddr*>(&m_SockAddress), sizeof(m_SockAddress))) {
+        const auto lastError = WSAGetLastError();
+        if (lastError != CONNECT_IN_PROGRESS) {
+            SetNonBlocking(m_Socket, false);
+            throw std::system_error(lastError, std::system_category());
+        }
+
+        /* the handshake is complete, as soon as the socket becomes writable */
+        fd_set writeSockets;
+        FD_ZERO(&writeSockets);
+        FD_SET(m_Socket, &writeSockets);
+        fd_set errorSockets = writeSockets;
+        timeval timeout { static_cast<long>(m_ConnectTimeout / 1000), static_cast<long>(m_ConnectTimeout % 1000 * 1000) };
+        const int state = NATIVE_SELECT(m_Socket + 1, nullptr, &writeSockets, &errorSockets, &timeout);
+        if (state <= 0) {
+            SetNonBlocking(m_Socket, false);
+            throw std::system_error(state ? WSAGetLastError() : CONNECT_TIMEDOUT, std::system_category());
+        }
+
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(m_Socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len)) {
+            error = WSAGetLastError();
+        }
+        if (error) {
+            SetNonBlocking(m_Socket, false);
+            throw std::system_error(error, std::system_category());
+        }
+    }
+    SetNonBlocking(m_Socket, false);
 }
 
 uint32_t TcpSocket::Connect() const
 {
     const uint32_t addr = ntohl(m_SockAddress.sin_addr.s_addr);
 
-    if (::connect(m_Socket, reinterpret_cast<const sockaddr*>(&m_SockAddress), sizeof(m_SockAddress))) {
+    if (m_ConnectTimeout) {
+        try {
+            ConnectNonBlocking();
+        } catch (const std::system_error& e) {
+            LOG_ERROR("Connect TCP socket failed with: " << e.what());
+            throw;
+        }
+    } else if (::connect(m_Socket, reinterpret_cast<const sockaddr*>(&m_SockAddress), sizeof(m_SockAddress))) {
         LOG_ERROR("Connect TCP socket failed with: " << std::strerror(WSAGetLastError()));
         throw std::system_error(WSAGetLastError(), std::system_category());
     }
@@ -36,12 +36,74 @@ struct IpV4 {
     bool operator==(const IpV4& ref) const;
 };
 
+/**
+ * Tuning of the TCP socket of an AMS connection. The defaults are optimized
+ * for low latency of small requests.
+ */
+struct SocketOptions {
+    SocketOptions()
+        : noDelay(true),
+        quickAck(false),
+        recvBufferSize(0),
+        sendBufferSize(0),
+        busyPoll(0),
+        connectTimeout(0),
+        serverPort(0)
+    {}
+
+    /** disable Nagle's algorithm (TCP_NODELAY), so small requests are sent immediately */
+    bool noDelay;
+
+    /** acknowledge received data immediately (TCP_QUICKACK), Linux only */
+    bool quickAck;
+
+    /** size of the kernel receive buffer (SO_RCVBUF) in bytes, 0 keeps the system default */
+    int recvBufferSize;
+
+    /** size of the kernel send buffer (SO_SNDBUF) in bytes, 0 keeps the system default */
+    int sendBufferSize;
+
+    /** microseconds to busy poll the device queue on receive (SO_BUSY_POLL), 0 disables, Linux only */
+    int busyPoll;
+
+    /** milliseconds to wait for the TCP handshake, 0 waits as long as the operating system does */
+    uint32_t connectTimeout;
+
+    /** TCP port of the ADS server, 0 selects the standard port ADS_TCP_SERVER_PORT (48898) */
+    uint16_t serverPort;
+};
+
+/**
+ * One piece of data, which is sent directly from its own buffer by a gathering write.
+ */
+struct SocketBuffer {
+    const void* data;
+    size_t length;
+};
+
 struct Socket {
     Frame& read(Frame& frame, timeval* timeout) const;
     size_t read(uint8_t* buffer, size_t maxBytes, timeval* timeout) const;
     size_t write(const Frame& frame) const;
+
+    /** send frame followed by payload with a single gathering write, without copying them together */
+    size_t write(const Frame& frame, const void* payload, size_t payloadLength) const;
+
+    /** send frame followed by all buffers with a single gathering write */
+    size_t write(const Frame& frame, const SocketBuffer* buffers, size_t numBuffers) const;
+
+    /** receive whatever is available without waiting for the socket, to be used after Poll() */
+    size_t receive(uint8_t* buffer, size_t maxBytes) const;
+
+    /** wait until data is available to read(), returns false if the timeout elapsed first */
+    bool Poll(timeval* timeout) const;
     void Shutdown();
 
+    SOCKET Handle() const
+    {
+        return m_Socket;
+    }
+
     struct TimeoutEx : std::runtime_error {
         TimeoutEx(const char* _Message) : std::runtime_error(_Message)
         {}
@@ -54,14 +116,20 @@ protected:
     const sockaddr* const m_DestAddr;
     const size_t m_DestAddrLen;
 
+    bool m_QuickAck;
+
     Socket(IpV4 ip, uint16_t port, int type);
     ~Socket();
     bool Select(timeval* timeout) const;
 };
 
 struct TcpSocket : Socket {
-    TcpSocket(IpV4 ip, uint16_t port);
+    TcpSocket(IpV4 ip, uint16_t port, const SocketOptions& options = SocketOptions {});
     uint32_t Connect() const;
+
+private:
+    const uint32_t m_ConnectTimeout;
+    void ConnectNonBlocking() const;
 };
 
 struct UdpSocket : Socket {
@@ -19,6 +19,15 @@ using ads_ui32 = unsigned long;
 #include <stdint.h>
 #include <TcAdsDef.h>
 
+/**
+ * @brief Type definition of the callback function required by the AdsAsync*() functions.
+ * It is called from the receive thread of the connection, so it should return quickly.
+ * @param[in] status ADS return code of the request
+ * @param[in] bytesRead number of bytes, which were written into the read buffer of the request
+ * @param[in] pUser custom pointer passed to the AdsAsync*() function
+ */
+typedef void (* PAdsCompletionFuncEx)(long status, uint32_t bytesRead, void* pUser);
+
 ////////////////////////////////////////////////////////////////////////////////
 // ADS Cmd Ids
 #define ADSSRVID_INVALID                    0x00
@@ -4,6 +4,12 @@
  */
 
 #include "AdsLib.h"
+#include "AdsSum.h"
+#include "Sockets.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace bhf
 {
@@ -14,6 +20,26 @@ long AddLocalRoute(AmsNetId, const char*)
     return 0;
 }
 
+long AddLocalRoute(AmsNetId, const char*, const SocketOptions&, size_t)
+{
+    return 0;
+}
+
+std::vector<long> AddLocalRoutes(const std::vector<std::pair<AmsNetId, std::string> >& routes, const SocketOptions&)
+{
+    return std::vector<long>(routes.size(), 0);
+}
+
+long SetReceiveThreads(uint32_t)
+{
+    return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long SetNotificationThreads(uint32_t)
+{
+    return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
 void DelLocalRoute(AmsNetId)
 {}
 
@@ -85,6 +111,26 @@ long AdsSyncReadWriteReqEx2(long           port,
                                   (ads_ui32*)bytesRead);
 }
 
+long AdsSyncReadWriteGatherReqEx(long                port,
+                                 const AmsAddr*      pAddr,
+                                 uint32_t            indexGroup,
+                                 uint32_t            indexOffset,
+                                 uint32_t            readLength,
+                                 void*               readData,
+                                 uint32_t            numBuffers,
+                                 const SocketBuffer* writeBuffers,
+                                 uint32_t*           bytesRead)
+{
+    /* TcAdsDll has no gathering API, so the buffers are copied together */
+    std::vector<uint8_t> writeData;
+    for (uint32_t i = 0; i < numBuffers; ++i) {
+        const auto data = static_cast<const uint8_t*>(writeBuffers[i].data);
+        writeData.insert(writeData.end(), data, data + writeBuffers[i].length);
+    }
+    return AdsSyncReadWriteReqEx2(port, pAddr, indexGroup, indexOffset, readLength, readData,
+                                  static_cast<uint32_t>(writeData.size()), writeData.data(), bytesRead);
+}
+
 long AdsSyncAddDeviceNotificationReqEx(long                         port,
                                        const AmsAddr*               pAddr,
                                        uint32_t                     indexGroup,
@@ -133,3 +179,163 @@ long AdsSyncWriteReqEx(long           port,
                              (ads_ui32)bufferLength,
                              (void*)buffer);
 }
+
+/**
+ * TcAdsDll has no asynchronous interface, we fall back to the synchronous
+ * requests and call the completion handler before returning.
+ */
+long AdsAsyncReadReqEx2(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        void*                buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser)
+{
+    if (!pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    uint32_t bytesRead = 0;
+    const auto status = AdsSyncReadReqEx2(port, pAddr, indexGroup, indexOffset, bufferLength, buffer, &bytesRead);
+    pFunc(status, bytesRead, pUser);
+    return 0;
+}
+
+long AdsAsyncReadWriteReqEx2(long                 port,
+                             const AmsAddr*       pAddr,
+                             uint32_t             indexGroup,
+                             uint32_t             indexOffset,
+                             uint32_t             readLength,
+                             void*                readData,
+                             uint32_t             writeLength,
+                             const void*          writeData,
+                             PAdsCompletionFuncEx pFunc,
+                             void*                pUser)
+{
+    if (!pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    uint32_t bytesRead = 0;
+    const auto status = AdsSyncReadWriteReqEx2(port,
+                                               pAddr,
+                                               indexGroup,
+                                               indexOffset,
+                                               readLength,
+                                               readData,
+                                               writeLength,
+                                               writeData,
+                                               &bytesRead);
+    pFunc(status, bytesRead, pUser);
+    return 0;
+}
+
+long AdsAsyncWriteReqEx(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        const void*          buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser)
+{
+    if (!pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    const auto status = AdsSyncWriteReqEx(port, pAddr, indexGroup, indexOffset, bufferLength, buffer);
+    pFunc(status, 0, pUser);
+    return 0;
+}
+
+long AdsSyncSetCoalescingEx(long, bool enable, uint32_t)
+{
+    /* requests are passed to the TwinCAT router one by one */
+    return enable ? ADSERR_DEVICE_SRVNOTSUPP : 0;
+}
+
+long AdsSyncSetNotificationBufferEx(long, uint32_t, ADSNOTIFICATIONOVERFLOW)
+{
+    /* notifications are buffered by the TwinCAT router */
+    return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long AdsSyncSetNotificationDeliveryEx(long, ADSNOTIFICATIONDELIVERY)
+{
+    return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+long AdsGetNotificationStatisticsEx(long, const AmsAddr*, AdsNotificationStatistics*)
+{
+    return ADSERR_DEVICE_SRVNOTSUPP;
+}
+
+/**
+ * errors of the ADS device and unknown handles concern a single item, all others
+ * mean the request didn't get through
+ */
+static bool IsItemError(const long error)
+{
+    return ((error >= ADSERR_DEVICE_ERROR) && (error < ADSERR_CLIENT_ERROR)) || (ADSERR_CLIENT_REMOVEHASH == error);
+}
+
+long AdsSyncAddDeviceNotificationsReqEx(long                       port,
+                                        const AmsAddr*             pAddr,
+                                        uint32_t                   numItems,
+                                        const AdsNotificationItem* items,
+                                        uint32_t*                  pNotifications,
+                                        long*                      errors)
+{
+    if (numItems && (!items || !pNotifications || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    /* TcAdsDll has no bulk API, so the notifications are added one by one */
+    long status = 0;
+    uint32_t registered = 0;
+    for ( ; registered < numItems; ++registered) {
+        const auto& item = items[registered];
+        errors[registered] = AdsSyncAddDeviceNotificationReqEx(port, pAddr, item.indexGroup, item.indexOffset,
+                                                               &item.attrib, item.pFunc, item.hUser,
+                                                               &pNotifications[registered]);
+        if (errors[registered] && !IsItemError(errors[registered])) {
+            status = errors[registered];
+            break;
+        }
+        if (errors[registered]) {
+            pNotifications[registered] = 0;
+        }
+    }
+
+    if (status) {
+        /* like the standalone implementation, a failed transfer leaves no notification behind */
+        for (uint32_t i = 0; i < registered; ++i) {
+            if (!errors[i]) {
+                AdsSyncDelDeviceNotificationReqEx(port, pAddr, pNotifications[i]);
+            }
+        }
+        std::fill(pNotifications, pNotifications + numItems, 0);
+        std::fill(errors, errors + numItems, status);
+    }
+    return status;
+}
+
+long AdsSyncDelDeviceNotificationsReqEx(long            port,
+                                        const AmsAddr*  pAddr,
+                                        uint32_t        numNotifications,
+                                        const uint32_t* hNotifications,
+                                        long*           errors)
+{
+    if (numNotifications && (!hNotifications || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    /* every notification is deleted, the first error of a transfer is returned */
+    long status = 0;
+    for (uint32_t i = 0; i < numNotifications; ++i) {
+        errors[i] = AdsSyncDelDeviceNotificationReqEx(port, pAddr, hNotifications[i]);
+        if (!status && errors[i] && !IsItemError(errors[i])) {
+            status = errors[i];
+        }
+    }
+    return status;
+}
@@ -283,6 +283,27 @@ enum ADSTRANSMODE {
     ADSTRANS_MAXMODES
 };
 
+/** values of AdsSymbolEntry::dataType and AdsDatatypeEntry::dataType */
+enum ADSDATATYPEID {
+    ADST_VOID = 0,
+    ADST_INT16 = 2,
+    ADST_INT32 = 3,
+    ADST_REAL32 = 4,
+    ADST_REAL64 = 5,
+    ADST_INT8 = 16,
+    ADST_UINT8 = 17,
+    ADST_UINT16 = 18,
+    ADST_UINT32 = 19,
+    ADST_INT64 = 20,
+    ADST_UINT64 = 21,
+    ADST_STRING = 30,
+    ADST_WSTRING = 31,
+    ADST_REAL80 = 32,
+    ADST_BIT = 33,
+    ADST_BIGTYPE = 65,
+    ADST_MAXTYPES
+};
+
 enum ADSSTATE : uint16_t {
     ADSSTATE_INVALID = 0,
     ADSSTATE_IDLE = 1,
@@ -378,6 +399,15 @@ struct AdsNotificationHeader {
 typedef void (* PAdsNotificationFuncEx)(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification,
                                         uint32_t hUser);
 
+/**
+ * @brief Type definition of the callback function required by the AdsAsync*() functions.
+ * It is called from the receive thread of the connection, so it should return quickly.
+ * @param[in] status ADS return code of the request
+ * @param[in] bytesRead number of bytes, which were written into the read buffer of the request
+ * @param[in] pUser custom pointer passed to the AdsAsync*() function
+ */
+typedef void (* PAdsCompletionFuncEx)(long status, uint32_t bytesRead, void* pUser);
+
 #define ADSSYMBOLFLAG_PERSISTENT    ((uint32_t)(1 << 0))
 #define ADSSYMBOLFLAG_BITVALUE      ((uint32_t)(1 << 1))
 #define ADSSYMBOLFLAG_REFERENCETO   ((uint32_t)(1 << 2))
@@ -407,6 +437,38 @@ struct AdsSymbolEntry {
     uint16_t commentLength; // length of comment (null terminating character not counted)
 };
 
+/**
+ * @brief Bounds of one dimension of an array data type
+ */
+struct AdsDatatypeArrayInfo {
+    uint32_t lBound; // lower bound of the index
+    uint32_t elements; // number of elements in this dimension
+};
+
+/**
+ * @brief This structure describes the header of ADS data type information
+ *
+ * Reading IndexGroup == ADSIGRP_SYM_DT_UPLOAD returns a list of these entries.
+ * Each header is followed by zero terminated strings for "data type name",
+ * "base type name" and a "comment", arrayDim AdsDatatypeArrayInfo and subItems
+ * AdsDatatypeEntry describing the elements of a structure.
+ */
+struct AdsDatatypeEntry {
+    uint32_t entryLength; // length of complete data type entry
+    uint32_t version; // version of the data type structure
+    uint32_t hashValue; // hash value of the data type
+    uint32_t typeHashValue; // hash value of the base type
+    uint32_t size; // size of the data type in bytes
+    uint32_t offs; // offset of the entry within its parent data type
+    uint32_t dataType; // adsDataType of the data type
+    uint32_t flags; // data type flags
+    uint16_t nameLength; // length of data type name (null terminating character not counted)
+    uint16_t typeLength; // length of base type name (null terminating character not counted)
+    uint16_t commentLength; // length of comment (null terminating character not counted)
+    uint16_t arrayDim; // number of array dimensions
+    uint16_t subItems; // number of elements of a structure
+};
+
 /**
  * @brief This structure is used to provide ADS symbol information for ADS SUM commands
  */
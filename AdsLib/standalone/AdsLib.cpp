@@ -21,6 +21,7 @@
  */
 
 #include "AdsLib.h"
+#include "AdsSum.h"
 #include "AmsRouter.h"
 
 static AmsRouter& GetRouter()
@@ -46,10 +47,10 @@ namespace bhf
 {
 namespace ads
 {
-long AddLocalRoute(const AmsNetId ams, const char* ip)
+long AddLocalRoute(const AmsNetId ams, const char* ip, const SocketOptions& options, const size_t numConnections)
 {
     try {
-        return GetRouter().AddRoute(ams, IpV4(ip));
+        return GetRouter().AddRoute(ams, IpV4(ip), options, numConnections);
     } catch (const std::bad_alloc&) {
         return GLOBALERR_NO_MEMORY;
     } catch (const std::runtime_error&) {
@@ -57,6 +58,55 @@ long AddLocalRoute(const AmsNetId ams, const char* ip)
     }
 }
 
+std::vector<long> AddLocalRoutes(const std::vector<std::pair<AmsNetId, std::string> >& routes,
+                                 const SocketOptions&                                options)
+{
+    std::vector<long> errors(routes.size(), GLOBALERR_NO_MEMORY);
+    try {
+        std::vector<std::pair<AmsNetId, IpV4> > resolved;
+        std::vector<size_t> index;
+        for (size_t i = 0; i < routes.size(); ++i) {
+            try {
+                resolved.emplace_back(routes[i].first, IpV4(routes[i].second));
+                index.push_back(i);
+            } catch (const std::runtime_error&) {
+                errors[i] = GLOBALERR_TARGET_PORT;
+            }
+        }
+
+        const auto results = GetRouter().AddRoutes(resolved, options);
+        for (size_t i = 0; i < results.size(); ++i) {
+            errors[index[i]] = results[i];
+        }
+    } catch (const std::bad_alloc&) {}
+    return errors;
+}
+
+long SetReceiveThreads(const uint32_t numThreads)
+{
+    try {
+        return GetRouter().SetReceiveThreads(numThreads);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long SetNotificationThreads(const uint32_t numThreads)
+{
+    try {
+        return GetRouter().SetNotificationThreads(numThreads);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    } catch (const std::system_error&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AddLocalRoute(const AmsNetId ams, const char* ip)
+{
+    return AddLocalRoute(ams, ip, SocketOptions {}, 1);
+}
+
 void DelLocalRoute(const AmsNetId ams)
 {
     GetRouter().DelRoute(ams);
@@ -200,9 +250,9 @@ long AdsSyncReadWriteReqEx2(long           port,
             readLength,
             readData,
             bytesRead,
-            sizeof(AoEReadWriteReqHeader) + writeLength
+            sizeof(AoEReadWriteReqHeader)
         };
-        request.frame.prepend(writeData, writeLength);
+        request.SetPayload(writeData, writeLength);
         request.frame.prepend(AoEReadWriteReqHeader {
             indexGroup,
             indexOffset,
@@ -215,6 +265,44 @@ long AdsSyncReadWriteReqEx2(long           port,
     }
 }
 
+long AdsSyncReadWriteGatherReqEx(long                port,
+                                 const AmsAddr*      pAddr,
+                                 uint32_t            indexGroup,
+                                 uint32_t            indexOffset,
+                                 uint32_t            readLength,
+                                 void*               readData,
+                                 uint32_t            numBuffers,
+                                 const SocketBuffer* writeBuffers,
+                                 uint32_t*           bytesRead)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if ((readLength && !readData) || (numBuffers && !writeBuffers)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        AmsRequest request {
+            *pAddr,
+            (uint16_t)port,
+            AoEHeader::READ_WRITE,
+            readLength,
+            readData,
+            bytesRead,
+            sizeof(AoEReadWriteReqHeader)
+        };
+        request.SetPayloadBuffers(writeBuffers, numBuffers);
+        request.frame.prepend(AoEReadWriteReqHeader {
+            indexGroup,
+            indexOffset,
+            readLength,
+            request.payloadLength
+        });
+        return GetRouter().AdsRequest(request);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
 long AdsSyncWriteReqEx(long           port,
                        const AmsAddr* pAddr,
                        uint32_t       indexGroup,
@@ -233,9 +321,9 @@ long AdsSyncWriteReqEx(long           port,
             (uint16_t)port,
             AoEHeader::WRITE,
             0, nullptr, nullptr,
-            sizeof(AoERequestHeader) + bufferLength,
+            sizeof(AoERequestHeader),
         };
-        request.frame.prepend(buffer, bufferLength);
+        request.SetPayload(buffer, bufferLength);
         request.frame.prepend<AoERequestHeader>({
             indexGroup,
             indexOffset,
@@ -247,6 +335,121 @@ long AdsSyncWriteReqEx(long           port,
     }
 }
 
+static AmsCompletion MakeCompletion(PAdsCompletionFuncEx pFunc, void* pUser)
+{
+    return [pFunc, pUser](long status, uint32_t bytesRead) {
+               pFunc(status, bytesRead, pUser);
+    };
+}
+
+long AdsAsyncReadReqEx2(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        void*                buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!buffer || !pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::unique_ptr<AmsRequest> request { new AmsRequest {
+                                                  *pAddr,
+                                                  (uint16_t)port,
+                                                  AoEHeader::READ,
+                                                  bufferLength,
+                                                  buffer,
+                                                  nullptr,
+                                                  sizeof(AoERequestHeader)
+                                              } };
+        request->frame.prepend(AoERequestHeader {
+            indexGroup,
+            indexOffset,
+            bufferLength
+        });
+        return GetRouter().AdsRequestAsync(std::move(request), MakeCompletion(pFunc, pUser));
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsAsyncReadWriteReqEx2(long                 port,
+                             const AmsAddr*       pAddr,
+                             uint32_t             indexGroup,
+                             uint32_t             indexOffset,
+                             uint32_t             readLength,
+                             void*                readData,
+                             uint32_t             writeLength,
+                             const void*          writeData,
+                             PAdsCompletionFuncEx pFunc,
+                             void*                pUser)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if ((readLength && !readData) || (writeLength && !writeData) || !pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::unique_ptr<AmsRequest> request { new AmsRequest {
+                                                  *pAddr,
+                                                  (uint16_t)port,
+                                                  AoEHeader::READ_WRITE,
+                                                  readLength,
+                                                  readData,
+                                                  nullptr,
+                                                  sizeof(AoEReadWriteReqHeader)
+                                              } };
+        request->SetPayload(writeData, writeLength);
+        request->frame.prepend(AoEReadWriteReqHeader {
+            indexGroup,
+            indexOffset,
+            readLength,
+            writeLength
+        });
+        return GetRouter().AdsRequestAsync(std::move(request), MakeCompletion(pFunc, pUser));
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsAsyncWriteReqEx(long                 port,
+                        const AmsAddr*       pAddr,
+                        uint32_t             indexGroup,
+                        uint32_t             indexOffset,
+                        uint32_t             bufferLength,
+                        const void*          buffer,
+                        PAdsCompletionFuncEx pFunc,
+                        void*                pUser)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!buffer || !pFunc) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        std::unique_ptr<AmsRequest> request { new AmsRequest {
+                                                  *pAddr,
+                                                  (uint16_t)port,
+                                                  AoEHeader::WRITE,
+                                                  0, nullptr, nullptr,
+                                                  sizeof(AoERequestHeader)
+                                              } };
+        request->SetPayload(buffer, bufferLength);
+        request->frame.prepend<AoERequestHeader>({
+            indexGroup,
+            indexOffset,
+            bufferLength
+        });
+        return GetRouter().AdsRequestAsync(std::move(request), MakeCompletion(pFunc, pUser));
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
 long AdsSyncWriteControlReqEx(long           port,
                               const AmsAddr* pAddr,
                               uint16_t       adsState,
@@ -261,9 +464,9 @@ long AdsSyncWriteControlReqEx(long           port,
             (uint16_t)port,
             AoEHeader::WRITE_CONTROL,
             0, nullptr, nullptr,
-            sizeof(AdsWriteCtrlRequest) + bufferLength
+            sizeof(AdsWriteCtrlRequest)
         };
-        request.frame.prepend(buffer, bufferLength);
+        request.SetPayload(buffer, bufferLength);
         request.frame.prepend<AdsWriteCtrlRequest>({
             adsState,
             devState,
@@ -324,6 +527,104 @@ long AdsSyncDelDeviceNotificationReqEx(long port, const AmsAddr* pAddr, uint32_t
     return GetRouter().DelNotification((uint16_t)port, pAddr, hNotification);
 }
 
+long AdsSyncAddDeviceNotificationsReqEx(long                       port,
+                                        const AmsAddr*             pAddr,
+                                        uint32_t                   numItems,
+                                        const AdsNotificationItem* items,
+                                        uint32_t*                  pNotifications,
+                                        long*                      errors)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (numItems && (!items || !pNotifications || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    for (uint32_t i = 0; i < numItems; ++i) {
+        if (!items[i].pFunc) {
+            return ADSERR_CLIENT_INVALIDPARM;
+        }
+    }
+
+    long status = 0;
+    uint32_t registered = 0;
+    try {
+        std::vector<AdsAddDeviceNotificationRequest> attribs;
+        std::vector<std::shared_ptr<Notification> > notify;
+        std::vector<uint8_t> response;
+        for (uint32_t first = 0; first < numItems; first += ADS_SUMUP_MAX_ITEMS) {
+            const auto count = std::min(numItems - first, ADS_SUMUP_MAX_ITEMS);
+            attribs.clear();
+            notify.clear();
+            for (uint32_t i = first; i < first + count; ++i) {
+                const auto& attrib = items[i].attrib;
+                attribs.emplace_back(items[i].indexGroup, items[i].indexOffset, attrib.cbLength,
+                                     attrib.nTransMode, attrib.nMaxDelay, attrib.nCycleTime);
+                notify.push_back(std::make_shared<Notification>(items[i].pFunc, items[i].hUser, attrib.cbLength,
+                                                                *pAddr, (uint16_t)port));
+            }
+
+            /* request: {list of IGrp, IOffs, Attrib}, response: {list of results, handles} */
+            response.resize(count * 2 * sizeof(uint32_t));
+            uint32_t bytesRead = 0;
+            AmsRequest request {
+                *pAddr,
+                (uint16_t)port,
+                AoEHeader::READ_WRITE,
+                static_cast<uint32_t>(response.size()),
+                response.data(),
+                &bytesRead,
+                sizeof(AoEReadWriteReqHeader)
+            };
+            request.SetPayload(attribs.data(), count * sizeof(AdsAddDeviceNotificationRequest));
+            request.frame.prepend(AoEReadWriteReqHeader {
+                ADSIGRP_SUMUP_ADDDEVNOTE,
+                count,
+                request.bufferLength,
+                request.payloadLength
+            });
+            status = GetRouter().AddNotifications(request, attribs, notify, pNotifications + first,
+                                                  errors + first);
+            if (status) {
+                break;
+            }
+            registered += count;
+        }
+    } catch (const std::bad_alloc&) {
+        status = GLOBALERR_NO_MEMORY;
+    }
+
+    if (status) {
+        /* the items are invalid now, so the caller couldn't delete the notifications of completed requests */
+        uint32_t numRegistered = 0;
+        for (uint32_t i = 0; i < registered; ++i) {
+            if (!errors[i]) {
+                pNotifications[numRegistered++] = pNotifications[i];
+            }
+        }
+        AdsSyncDelDeviceNotificationsReqEx(port, pAddr, numRegistered, pNotifications, errors);
+        std::fill(pNotifications, pNotifications + numItems, 0);
+        std::fill(errors, errors + numItems, status);
+    }
+    return status;
+}
+
+long AdsSyncDelDeviceNotificationsReqEx(long            port,
+                                        const AmsAddr*  pAddr,
+                                        uint32_t        numNotifications,
+                                        const uint32_t* hNotifications,
+                                        long*           errors)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (numNotifications && (!hNotifications || !errors)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    try {
+        return GetRouter().DelNotifications((uint16_t)port, pAddr, hNotifications, numNotifications, errors);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
 long AdsSyncGetTimeoutEx(long port, uint32_t* timeout)
 {
     ASSERT_PORT(port);
@@ -338,3 +639,40 @@ long AdsSyncSetTimeoutEx(long port, uint32_t timeout)
     ASSERT_PORT(port);
     return GetRouter().SetTimeout((uint16_t)port, timeout);
 }
+
+long AdsSyncSetSpinTimeEx(long port, uint32_t spinTime)
+{
+    ASSERT_PORT(port);
+    return GetRouter().SetSpinTime((uint16_t)port, spinTime);
+}
+
+long AdsSyncSetCoalescingEx(long port, bool enable, uint32_t window)
+{
+    ASSERT_PORT(port);
+    return GetRouter().SetCoalescing((uint16_t)port, enable, window);
+}
+
+long AdsSyncSetNotificationBufferEx(long port, uint32_t capacity, ADSNOTIFICATIONOVERFLOW overflow)
+{
+    ASSERT_PORT(port);
+    try {
+        return GetRouter().SetNotificationBuffer((uint16_t)port, capacity, overflow);
+    } catch (const std::bad_alloc&) {
+        return GLOBALERR_NO_MEMORY;
+    }
+}
+
+long AdsSyncSetNotificationDeliveryEx(long port, ADSNOTIFICATIONDELIVERY delivery)
+{
+    ASSERT_PORT(port);
+    return GetRouter().SetNotificationDelivery((uint16_t)port, delivery);
+}
+
+long AdsGetNotificationStatisticsEx(long port, const AmsAddr* pAddr, AdsNotificationStatistics* statistics)
+{
+    ASSERT_PORT_AND_AMSADDR(port, pAddr);
+    if (!statistics) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    return GetRouter().GetNotificationStatistics((uint16_t)port, *pAddr, *statistics);
+}
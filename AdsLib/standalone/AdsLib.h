@@ -38,3 +38,14 @@ long AdsGetLocalAddressEx(long port, AmsAddr* pAddr);
  * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
  */
 long AdsSyncSetTimeoutEx(long port, uint32_t timeout);
+
+/**
+ * Let synchronous ADS functions of this port poll for their response for up to
+ * spinTime microseconds, before they put the calling thread to sleep. This trades
+ * CPU time for lower latency, if responses arrive within a few microseconds.
+ * The standard value is 0, which disables polling.
+ * @param[in] port port number of an Ads port that had previously been opened with AdsPortOpenEx().
+ * @param[in] spinTime time to poll in microseconds.
+ * @return [ADS Return Code](https://infosys.beckhoff.com/content/1031/tcadscommon/html/ads_returncodes.htm?id=1666172286265530469)
+ */
+long AdsSyncSetSpinTimeEx(long port, uint32_t spinTime);
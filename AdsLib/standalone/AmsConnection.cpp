@@ -23,23 +23,63 @@
 #include "AmsConnection.h"
 #include "Log.h"
 
-AmsResponse::AmsResponse()
-    : request(nullptr),
-    errorCode(WAITING_FOR_RESPONSE)
+#include <algorithm>
+#include <vector>
+
+AmsResponse::AmsResponse(AmsRequest& __request, const bool __detached)
+    : request(&__request),
+    invokeId(0),
+    detached(__detached),
+    state(WAITING_FOR_RESPONSE)
 {}
 
 void AmsResponse::Notify(const uint32_t error)
 {
-    std::unique_lock<std::mutex> lock(mutex);
-    errorCode = error;
+    auto expected = WAITING_FOR_RESPONSE;
+    if (state.compare_exchange_strong(expected, error)) {
+        /* Wait() is still spinning and will pick up the result, *this might be gone already */
+        return;
+    }
+
+    /* Wait() is parked, the result has to be published under the lock to keep *this alive until we are done */
+    std::lock_guard<std::mutex> lock(mutex);
+    state.store(error);
     cv.notify_all();
 }
 
-uint32_t AmsResponse::Wait()
+static inline void CpuRelax()
 {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#endif
+}
+
+uint32_t AmsResponse::Wait(const uint32_t spinTime)
+{
+    if (spinTime) {
+        const auto spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(spinTime);
+        do {
+            for (int i = 0; i < 64; ++i) {
+                const auto result = state.load(std::memory_order_acquire);
+                if (result != WAITING_FOR_RESPONSE) {
+                    return result;
+                }
+                CpuRelax();
+            }
+        } while (std::chrono::steady_clock::now() < spinEnd);
+    }
+
     std::unique_lock<std::mutex> lock(mutex);
+    auto expected = WAITING_FOR_RESPONSE;
+    if (!state.compare_exchange_strong(expected, WAITING_PARKED)) {
+        /* result arrived after spinning */
+        return expected;
+    }
 
-    cv.wait_until(lock, request.load()->deadline, [&]() { return !invokeId.load(); });
+    cv.wait_until(lock, request->deadline, [&]() { return state.load() != WAITING_PARKED; });
+    if (state.load() != WAITING_PARKED) {
+        return state.load();
+    }
 
     if (invokeId.exchange(0)) {
         /* invokeId wasn't consumed -> AmsConnection::recv() didn't got a valid response until now */
@@ -47,8 +87,38 @@ uint32_t AmsResponse::Wait()
     }
 
     /* AmsConnection::recv() is currently processing a response and using the user supplied buffer, we need to wait until that finished */
-    cv.wait(lock, [&]() { return errorCode != WAITING_FOR_RESPONSE; });
-    return errorCode;
+    cv.wait(lock, [&]() { return state.load() != WAITING_PARKED; });
+    return state.load();
+}
+
+AmsAsyncResponse::AmsAsyncResponse(std::unique_ptr<AmsRequest> __request, AmsCompletion __completion)
+    : AmsResponse(*__request, true),
+    owner(std::move(__request)),
+    completion(__completion),
+    bytesRead(0),
+    result(0),
+    references(2)
+{
+    owner->bytesRead = &bytesRead;
+}
+
+void AmsAsyncResponse::Notify(const uint32_t error)
+{
+    result = error;
+    Unref();
+}
+
+void AmsAsyncResponse::Sent()
+{
+    Unref();
+}
+
+void AmsAsyncResponse::Unref()
+{
+    if (1 == references.fetch_sub(1)) {
+        completion(result, bytesRead);
+        delete this;
+    }
 }
 
 SharedDispatcher AmsConnection::DispatcherListAdd(const VirtualConnection& connection)
@@ -64,7 +134,15 @@ SharedDispatcher AmsConnection::DispatcherListAdd(const VirtualConnection& conne
                                                                                      connection.second,
                                                                                      std::placeholders::_1,
                                                                                      std::placeholders::_2,
-                                                                                     connection.first))).first->second;
+                                                                                     connection.first),
+                                                                           std::bind(&AmsConnection::DeleteNotifications,
+                                                                                     this,
+                                                                                     connection.second,
+                                                                                     std::placeholders::_1,
+                                                                                     std::placeholders::_2,
+                                                                                     std::placeholders::_3,
+                                                                                     connection.first),
+                                                                           notificationPool)).first->second;
 }
 
 SharedDispatcher AmsConnection::DispatcherListGet(const VirtualConnection& connection)
@@ -78,21 +156,70 @@ SharedDispatcher AmsConnection::DispatcherListGet(const VirtualConnection& conne
     return {};
 }
 
-AmsConnection::AmsConnection(Router& __router, IpV4 __destIp)
+std::vector<SharedDispatcher> AmsConnection::GetDispatchers(const uint16_t port)
+{
+    std::lock_guard<std::recursive_mutex> lock(dispatcherListMutex);
+
+    std::vector<SharedDispatcher> result;
+    for (const auto& d : dispatcherList) {
+        if (d.first.first == port) {
+            result.push_back(d.second);
+        }
+    }
+    return result;
+}
+
+AmsConnection::AmsConnection(Router&              __router,
+                             IpV4                 __destIp,
+                             AmsReactor*          __reactor,
+                             const SocketOptions& options,
+                             NotificationPool*    __notificationPool)
     : router(__router),
-    socket(__destIp, ADS_TCP_SERVER_PORT),
+    socket(__destIp, options.serverPort ? options.serverPort : ADS_TCP_SERVER_PORT, options),
+    reactor(__reactor),
+    notificationPool(__notificationPool),
     refCount(0),
     invokeId(0),
+    pending(std::less<uint32_t>(), pendingPool),
+    deadlines(std::less<std::pair<Timepoint, uint32_t> >(), deadlinesPool),
+    receiving(true),
+    orphaned(false),
+    rxBuffer(new MirrorRingBuffer(RX_CHUNK_SIZE)),
+    rxSmallCycles(0),
     destIp(__destIp),
     ownIp(socket.Connect())
 {
-    receiver = std::thread(&AmsConnection::TryRecv, this);
+    if (!reactor) {
+        receiver = std::thread(&AmsConnection::TryRecv, this);
+    } else if (ownIp) {
+        reactor->Add(this);
+    } else {
+        StopReceiving();
+    }
 }
 
 AmsConnection::~AmsConnection()
 {
+    if (reactor) {
+        reactor->Remove(this);
+        socket.Shutdown();
+        StopReceiving();
+        return;
+    }
     socket.Shutdown();
-    receiver.join();
+    if (receiver.joinable()) {
+        receiver.join();
+    }
+}
+
+bool AmsConnection::Orphan()
+{
+    if (reactor || (receiver.get_id() != std::this_thread::get_id())) {
+        return false;
+    }
+    orphaned = true;
+    socket.Shutdown();
+    return true;
 }
 
 SharedDispatcher AmsConnection::CreateNotifyMapping(uint32_t hNotify, std::shared_ptr<Notification> notification)
@@ -115,35 +242,91 @@ long AmsConnection::DeleteNotification(const AmsAddr& amsAddr, uint32_t hNotify,
     return AdsRequest(request, tmms);
 }
 
-AmsResponse* AmsConnection::Write(AmsRequest& request, const AmsAddr srcAddr)
+long AmsConnection::DeleteNotifications(const AmsAddr&               amsAddr,
+                                        const std::vector<uint32_t>& hNotify,
+                                        const uint32_t               tmms,
+                                        long* const                  errors,
+                                        const uint16_t               port)
+{
+    std::vector<uint32_t> handles;
+    std::vector<uint32_t> results;
+    for (size_t first = 0; first < hNotify.size(); first += ADS_SUMUP_MAX_ITEMS) {
+        const auto count = static_cast<uint32_t>(std::min<size_t>(hNotify.size() - first, ADS_SUMUP_MAX_ITEMS));
+        handles.resize(count);
+        results.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            handles[i] = bhf::ads::htole(hNotify[first + i]);
+        }
+
+        /* request: {list of handles}, response: {list of results} */
+        uint32_t bytesRead = 0;
+        AmsRequest request {
+            amsAddr,
+            port, AoEHeader::READ_WRITE,
+            static_cast<uint32_t>(count * sizeof(uint32_t)), results.data(), &bytesRead,
+            sizeof(AoEReadWriteReqHeader)
+        };
+        request.SetPayload(handles.data(), count * sizeof(uint32_t));
+        request.frame.prepend(AoEReadWriteReqHeader {
+            ADSIGRP_SUMUP_DELDEVNOTE,
+            count,
+            request.bufferLength,
+            request.payloadLength
+        });
+        const auto status = AdsRequest(request, tmms);
+        if (ADSERR_DEVICE_SRVNOTSUPP == status) {
+            for (uint32_t i = 0; i < count; ++i) {
+                errors[first + i] = DeleteNotification(amsAddr, hNotify[first + i], tmms, port);
+            }
+            continue;
+        }
+        if (status) {
+            std::fill(errors + first, errors + hNotify.size(), status);
+            return status;
+        }
+        if (bytesRead < count * sizeof(uint32_t)) {
+            std::fill(errors + first, errors + hNotify.size(), ADSERR_DEVICE_INVALIDSIZE);
+            return ADSERR_DEVICE_INVALIDSIZE;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            errors[first + i] = bhf::ads::letoh(results[i]);
+        }
+    }
+    return 0;
+}
+
+uint32_t AmsConnection::Write(AmsRequest& request, const AmsAddr srcAddr, AmsResponse& response)
 {
+    const auto id = Reserve(&response);
+    if (!id) {
+        return 0;
+    }
+
     const AoEHeader aoeHeader {
         request.destAddr.netId, request.destAddr.port,
         srcAddr.netId, srcAddr.port,
         request.cmdId,
-        static_cast<uint32_t>(request.frame.size()),
-        GetInvokeId()
+        static_cast<uint32_t>(request.frame.size() + request.payloadLength),
+        id
     };
     request.frame.prepend<AoEHeader>(aoeHeader);
 
-    const AmsTcpHeader header { static_cast<uint32_t>(request.frame.size()) };
+    const AmsTcpHeader header { static_cast<uint32_t>(request.frame.size() + request.payloadLength) };
     request.frame.prepend<AmsTcpHeader>(header);
 
-    auto response = Reserve(&request, srcAddr.port);
-
-    if (!response) {
-        return nullptr;
-    }
-
-    response->invokeId.store(aoeHeader.invokeId());
-    if (request.frame.size() != socket.write(request.frame)) {
-        response->Release();
-        return nullptr;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const auto length = request.frame.size() + request.payloadLength;
+    if (length != socket.write(request.frame, request.payload, request.numPayload)) {
+        /* response might be claimed by the receive thread already, which will complete it */
+        if (response.invokeId.exchange(0)) {
+            Release(&response, id);
+            return 0;
+        }
     }
-    return response;
+    return id;
 }
 
-long AmsConnection::AdsRequest(AmsRequest& request, const uint32_t timeout)
+long AmsConnection::AdsRequest(AmsRequest& request, const uint32_t timeout, const uint32_t spinTime)
 {
     AmsAddr srcAddr;
     const auto status = router.GetLocalAddress(request.port, &srcAddr);
@@ -151,14 +334,219 @@ long AmsConnection::AdsRequest(AmsRequest& request, const uint32_t timeout)
         return status;
     }
     request.SetDeadline(timeout);
-    AmsResponse* response = Write(request, srcAddr);
-    if (response) {
-        const auto errorCode = response->Wait();
+    AmsResponse response { request };
+    const auto id = Write(request, srcAddr, response);
+    if (!id) {
+        return -1;
+    }
+
+    const auto errorCode = response.Wait(spinTime);
+    Release(&response, id);
+    return errorCode;
+}
+
+long AmsConnection::AdsRequestAsync(std::unique_ptr<AmsRequest> request,
+                                    const uint32_t              timeout,
+                                    AmsCompletion               completion)
+{
+    AmsAddr srcAddr;
+    const auto status = router.GetLocalAddress(request->port, &srcAddr);
+    if (status) {
+        return status;
+    }
+    request->SetDeadline(timeout);
 
-        response->Release();
-        return errorCode;
+    auto& req = *request;
+    std::unique_ptr<AmsAsyncResponse> response { new AmsAsyncResponse { std::move(request), completion } };
+    if (!Write(req, srcAddr, *response)) {
+        return -1;
     }
-    return -1;
+
+    /* from now on the response is owned by the receive thread */
+    response.release()->Sent();
+    return 0;
+}
+
+bool AmsConnection::CoalescedBatch::Accepts(const size_t additional) const
+{
+    return !full && (requests.size() < ADS_SUMUP_MAX_ITEMS) && (length + additional <= ADS_SUMUP_MAX_LENGTH);
+}
+
+AmsConnection::CoalescingQueue::CoalescingQueue()
+    : open(nullptr),
+    inFlight(0),
+    unsupported(false),
+    users(0)
+{}
+
+long AmsConnection::AdsRequestCoalesced(AmsRequest&    request,
+                                        const uint32_t timeout,
+                                        const uint32_t spinTime,
+                                        const uint32_t window)
+{
+    /* only READ and WRITE requests, which consist of nothing else than an AoERequestHeader and the data to write */
+    const bool isRead = (AoEHeader::READ == request.cmdId) && !request.payloadLength;
+    const bool isWrite = (AoEHeader::WRITE == request.cmdId);
+    if ((!isRead && !isWrite) || (request.frame.size() != sizeof(AoERequestHeader))) {
+        return AdsRequest(request, timeout, spinTime);
+    }
+
+    const size_t length = isRead ? request.bufferLength : request.payloadLength;
+    const CoalescingKey key { VirtualConnection { request.port, request.destAddr }, request.cmdId };
+    CoalescedRequest self { &request, 0, false, false };
+
+    std::unique_lock<std::mutex> lock(coalescingMutex);
+    auto& queue = coalescing[key];
+    ++queue.users;
+    /* called with lock held, queue mustn't be used afterwards */
+    const auto leave = [&]() {
+                           if (!--queue.users && !queue.open && !queue.inFlight && !queue.unsupported) {
+                               coalescing.erase(key);
+                           }
+                       };
+
+    for ( ; queue.open; ) {
+        if (queue.unsupported) {
+            break;
+        }
+        if (queue.open->Accepts(length)) {
+            /* join the batch of another thread and wait until it was sent */
+            queue.open->requests.push_back(&self);
+            queue.open->length += length;
+            if (!queue.open->Accepts(0)) {
+                coalescingCv.notify_all();
+            }
+            coalescingCv.wait(lock, [&]() { return self.done; });
+            leave();
+            lock.unlock();
+            return self.resend ? AdsRequest(request, timeout, spinTime) : self.result;
+        }
+
+        /* we don't fit into the open batch, so it is sent right away and we open the next one */
+        const auto previous = queue.open;
+        previous->full = true;
+        coalescingCv.notify_all();
+        coalescingCv.wait(lock, [&]() { return queue.open != previous; });
+    }
+
+    if (queue.unsupported) {
+        leave();
+        lock.unlock();
+        return AdsRequest(request, timeout, spinTime);
+    }
+
+    /* open a new batch and collect requests of other threads until the window and the previous batch are over */
+    CoalescedBatch batch;
+    batch.requests.push_back(&self);
+    batch.length = length;
+    batch.full = false;
+    queue.open = &batch;
+    const auto windowEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(window);
+    coalescingCv.wait_until(lock, windowEnd, [&]() { return !batch.Accepts(0); });
+    coalescingCv.wait(lock, [&]() { return !batch.Accepts(0) || !queue.inFlight; });
+    queue.open = nullptr;
+    ++queue.inFlight;
+    /* threads waiting for a full batch to be taken may open the next one now */
+    coalescingCv.notify_all();
+    lock.unlock();
+
+    long status = 0;
+    if (batch.requests.size() == 1) {
+        self.result = AdsRequest(request, timeout, spinTime);
+    } else {
+        status = SendCoalesced(batch, timeout, spinTime);
+    }
+
+    lock.lock();
+    --queue.inFlight;
+    if (ADSERR_DEVICE_SRVNOTSUPP == status) {
+        queue.unsupported = true;
+    }
+    for (auto r : batch.requests) {
+        r->done = true;
+    }
+    leave();
+    coalescingCv.notify_all();
+    lock.unlock();
+    return self.resend ? AdsRequest(request, timeout, spinTime) : self.result;
+}
+
+long AmsConnection::SendCoalesced(CoalescedBatch& batch, const uint32_t timeout, const uint32_t spinTime)
+{
+    const auto& first = *batch.requests.front()->request;
+    const bool isRead = (AoEHeader::READ == first.cmdId);
+    const auto count = static_cast<uint32_t>(batch.requests.size());
+
+    /*
+     * request: {list of IGrp, IOffs, Length} followed by {list of data} for writes. The AoERequestHeader
+     * of each request already has this layout, so the frames are sent as they are.
+     */
+    std::vector<SocketBuffer> buffers;
+    for (const auto r : batch.requests) {
+        buffers.push_back(SocketBuffer { r->request->frame.data(), sizeof(AoERequestHeader) });
+    }
+    for (const auto r : batch.requests) {
+        buffers.insert(buffers.end(), r->request->payload, r->request->payload + r->request->numPayload);
+    }
+
+    /* response: {list of results} followed by {list of data} for reads */
+    std::vector<uint8_t> response(count * sizeof(uint32_t) + (isRead ? batch.length : 0));
+    uint32_t bytesRead = 0;
+    AmsRequest request {
+        first.destAddr,
+        first.port, AoEHeader::READ_WRITE,
+        static_cast<uint32_t>(response.size()), response.data(), &bytesRead,
+        sizeof(AoEReadWriteReqHeader)
+    };
+    request.SetPayloadBuffers(buffers.data(), buffers.size());
+    request.frame.prepend(AoEReadWriteReqHeader {
+        static_cast<uint32_t>(isRead ? ADSIGRP_SUMUP_READ : ADSIGRP_SUMUP_WRITE),
+        count,
+        request.bufferLength,
+        request.payloadLength
+    });
+
+    auto status = AdsRequest(request, timeout, spinTime);
+    if (!status && (bytesRead < count * sizeof(uint32_t))) {
+        status = ADSERR_DEVICE_INVALIDSIZE;
+    }
+    if (status) {
+        for (auto r : batch.requests) {
+            r->result = status;
+            r->resend = (ADSERR_DEVICE_SRVNOTSUPP == status);
+        }
+        return status;
+    }
+
+    /* the data area contains the requested length of every read, even of the failed ones */
+    auto data = response.data() + count * sizeof(uint32_t);
+    const auto end = response.data() + bytesRead;
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& r = *batch.requests[i];
+        r.result = bhf::ads::letoh<uint32_t>(response.data() + i * sizeof(uint32_t));
+        if (!isRead) {
+            continue;
+        }
+
+        const auto length = r.request->bufferLength;
+        if (!r.result && (static_cast<size_t>(end - data) < length)) {
+            r.result = ADSERR_DEVICE_INVALIDSIZE;
+        }
+        if (!r.result) {
+            memcpy(r.request->buffer, data, length);
+            if (r.request->bytesRead) {
+                *r.request->bytesRead = length;
+            }
+        }
+        data += std::min<size_t>(length, end - data);
+    }
+    return 0;
+}
+
+size_t AmsConnection::Outstanding()
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return pending.size();
 }
 
 uint32_t AmsConnection::GetInvokeId()
@@ -172,138 +560,251 @@ uint32_t AmsConnection::GetInvokeId()
 
 AmsResponse* AmsConnection::GetPending(const uint32_t id, const uint16_t port)
 {
-    const uint16_t portIndex = port - Router::PORT_BASE;
-    if (portIndex >= Router::NUM_PORTS_MAX) {
-        LOG_WARN("Port 0x" << std::hex << port << " is out of range");
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    const auto it = pending.find(id);
+    if (it == pending.end()) {
+        LOG_WARN("No request pending for invokeId 0x" << std::hex << id);
+        return nullptr;
+    }
+
+    const auto response = it->second;
+    if (response->request->port != port) {
+        LOG_WARN("InvokeId 0x" << std::hex << id << " was sent from port 0x" << response->request->port <<
+                 " but received on 0x" << port);
         return nullptr;
     }
 
+    pending.erase(it);
+    if (response->detached) {
+        deadlines.erase({response->request->deadline, id});
+    }
+
     auto currentId = id;
-    if (queue[portIndex].invokeId.compare_exchange_strong(currentId, 0)) {
-        return &queue[portIndex];
+    if (response->invokeId.compare_exchange_strong(currentId, 0)) {
+        return response;
     }
-    LOG_WARN("InvokeId mismatch: waiting for 0x" << std::hex << currentId << " received 0x" << id);
+    /* AmsResponse::Wait() timed out already and doesn't expect a frame anymore */
     return nullptr;
 }
 
-AmsResponse* AmsConnection::Reserve(AmsRequest* request, const uint16_t port)
+uint32_t AmsConnection::Reserve(AmsResponse* const response)
 {
-    AmsRequest* isFree = nullptr;
-    if (!queue[port - Router::PORT_BASE].request.compare_exchange_strong(isFree, request)) {
-        LOG_WARN("Port: " << port << " already in use as " << isFree);
-        return nullptr;
-    }
-    return &queue[port - Router::PORT_BASE];
-}
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    uint32_t id;
+    do {
+        id = GetInvokeId();
+    } while (pending.count(id));
 
-void AmsResponse::Release()
-{
-    errorCode = WAITING_FOR_RESPONSE;
-    request.store(nullptr);
+    if (response->detached) {
+        if (!receiving) {
+            LOG_WARN("Connection is not receiving anymore, refusing asynchronous request");
+            return 0;
+        }
+        deadlines.emplace(response->request->deadline, id);
+    }
+    pending.emplace(id, response);
+    response->invokeId.store(id);
+    return id;
 }
 
-void AmsConnection::Receive(void* buffer, size_t bytesToRead, timeval* timeout) const
+void AmsConnection::Release(AmsResponse* const response, const uint32_t id)
 {
-    auto pos = reinterpret_cast<uint8_t*>(buffer);
-    while (bytesToRead) {
-        const size_t bytesRead = socket.read(pos, bytesToRead, timeout);
-        bytesToRead -= bytesRead;
-        pos += bytesRead;
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    const auto it = pending.find(id);
+    if ((it != pending.end()) && (it->second == response)) {
+        pending.erase(it);
+        if (response->detached) {
+            deadlines.erase({response->request->deadline, id});
+        }
     }
 }
 
-void AmsConnection::Receive(void* buffer, size_t bytesToRead, const Timepoint& deadline) const
+void AmsConnection::Expire(const Timepoint& now)
 {
-    const auto now = std::chrono::steady_clock::now();
-    const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
-    if (usec <= 0) {
-        throw Socket::TimeoutEx("deadline reached already!!!");
+    std::vector<AmsResponse*> expired;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        while (!deadlines.empty() && (deadlines.begin()->first <= now)) {
+            const auto id = deadlines.begin()->second;
+            deadlines.erase(deadlines.begin());
+
+            const auto it = pending.find(id);
+            if (it == pending.end()) {
+                continue;
+            }
+            const auto response = it->second;
+            pending.erase(it);
+
+            auto currentId = id;
+            if (response->invokeId.compare_exchange_strong(currentId, 0)) {
+                expired.push_back(response);
+            }
+        }
     }
 
-    timeval timeout {(long)(usec / 1000000), (int)(usec % 1000000)};
-    Receive(buffer, bytesToRead, &timeout);
+    for (auto response : expired) {
+        LOG_WARN("Asynchronous request from port " << std::dec << response->request->port << " timed out");
+        response->Notify(ADSERR_CLIENT_SYNCTIMEOUT);
+    }
 }
 
-void AmsConnection::ReceiveJunk(size_t bytesToRead) const
+timeval AmsConnection::NextExpiry()
 {
-    uint8_t buffer[1024];
-    while (bytesToRead > sizeof(buffer)) {
-        Receive(buffer, sizeof(buffer));
-        bytesToRead -= sizeof(buffer);
+    int64_t usec = EXPIRE_INTERVAL_MS * 1000;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (!deadlines.empty()) {
+            const auto now = std::chrono::steady_clock::now();
+            const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadlines.begin()->first - now);
+            usec = std::max<int64_t>(0, std::min<int64_t>(usec, left.count()));
+        }
     }
-    Receive(buffer, bytesToRead);
+    return timeval {(long)(usec / 1000000), (int)(usec % 1000000)};
 }
 
 template<class T>
-void AmsConnection::ReceiveFrame(AmsResponse* const response, size_t bytesLeft, uint32_t aoeError) const
+void AmsConnection::ReceiveFrame(AmsResponse* const response,
+                                 const uint8_t*     payload,
+                                 size_t             bytesLeft,
+                                 uint32_t           aoeError) const
 {
-    AmsRequest* const request = response->request.load();
-    const auto responseId = response->invokeId.load();
-    T header;
+    AmsRequest* const request = response->request;
 
     if (aoeError) {
         response->Notify(aoeError);
-        ReceiveJunk(bytesLeft);
         return;
     }
 
-    if (bytesLeft > sizeof(header) + request->bufferLength) {
-        LOG_WARN("Frame too long: " << std::dec << bytesLeft << '>' << sizeof(header) + request->bufferLength);
+    if ((bytesLeft < sizeof(T)) || (bytesLeft > sizeof(T) + request->bufferLength)) {
+        LOG_WARN("Frame length: " << std::dec << bytesLeft << " doesn't fit into [" << sizeof(T) << ',' <<
+                 sizeof(T) + request->bufferLength << ']');
         response->Notify(ADSERR_DEVICE_INVALIDSIZE);
-        ReceiveJunk(bytesLeft);
         return;
     }
 
-    try {
-        Receive(&header, sizeof(header), request->deadline);
-        bytesLeft -= sizeof(header);
-        Receive(request->buffer, bytesLeft, request->deadline);
+    const T header { payload };
+    bytesLeft -= sizeof(header);
+    if (bytesLeft) {
+        memcpy(request->buffer, payload + sizeof(header), bytesLeft);
+    }
 
-        if (request->bytesRead) {
-            *(request->bytesRead) = bytesLeft;
-        }
-        response->Notify(header.result());
-    } catch (const Socket::TimeoutEx&) {
-        LOG_WARN("InvokeId of response: " << std::dec << responseId << " timed out");
-        response->Notify(ADSERR_CLIENT_SYNCTIMEOUT);
-        ReceiveJunk(bytesLeft);
+    if (request->bytesRead) {
+        *(request->bytesRead) = bytesLeft;
     }
+    response->Notify(header.result());
 }
 
-bool AmsConnection::ReceiveNotification(const AoEHeader& header)
+bool AmsConnection::ReceiveNotification(const AoEHeader& header, uint8_t* data)
 {
     const auto dispatcher = DispatcherListGet(VirtualConnection { header.targetPort(), header.sourceAms() });
     if (!dispatcher) {
-        ReceiveJunk(header.length());
         LOG_WARN("No dispatcher found for notification");
         return false;
     }
 
-    auto& ring = dispatcher->ring;
-    auto bytesLeft = header.length();
-    if (bytesLeft + sizeof(bytesLeft) > ring.BytesFree()) {
-        ReceiveJunk(bytesLeft);
+    if (!dispatcher->Deliver(data, header.length())) {
         LOG_WARN("port " << std::dec << header.targetPort() << " receive buffer was full");
         return false;
     }
+    return true;
+}
+
+void AmsConnection::ReceiveFrame(uint8_t* frame, const size_t length)
+{
+    if (length < sizeof(AoEHeader)) {
+        LOG_WARN("Frame to short to be AoE");
+        return;
+    }
 
-    /** store AoEHeader.length() in ring buffer to support notification parsing */
-    for (size_t i = 0; i < sizeof(bytesLeft); ++i) {
-        *ring.write = (bytesLeft >> (8 * i)) & 0xFF;
-        ring.Write(1);
+    const AoEHeader aoeHeader { frame };
+    const auto payload = frame + sizeof(aoeHeader);
+    if (aoeHeader.length() > length - sizeof(aoeHeader)) {
+        LOG_WARN("AoE length: " << std::dec << aoeHeader.length() << " exceeds frame length: " << length);
+        return;
     }
 
-    auto chunk = ring.WriteChunk();
-    while (bytesLeft > chunk) {
-        Receive(ring.write, chunk);
-        ring.Write(chunk);
-        bytesLeft -= chunk;
-        chunk = ring.WriteChunk();
+    if (aoeHeader.cmdId() == AoEHeader::DEVICE_NOTIFICATION) {
+        ReceiveNotification(aoeHeader, payload);
+        return;
+    }
+
+    auto response = GetPending(aoeHeader.invokeId(), aoeHeader.targetPort());
+    if (!response) {
+        LOG_WARN("No response pending");
+        return;
+    }
+
+    switch (aoeHeader.cmdId()) {
+    case AoEHeader::READ_DEVICE_INFO:
+    case AoEHeader::WRITE:
+    case AoEHeader::READ_STATE:
+    case AoEHeader::WRITE_CONTROL:
+    case AoEHeader::ADD_DEVICE_NOTIFICATION:
+    case AoEHeader::DEL_DEVICE_NOTIFICATION:
+        ReceiveFrame<AoEResponseHeader>(response, payload, aoeHeader.length(), aoeHeader.errorCode());
+        return;
+
+    case AoEHeader::READ:
+    case AoEHeader::READ_WRITE:
+        ReceiveFrame<AoEReadResponseHeader>(response, payload, aoeHeader.length(), aoeHeader.errorCode());
+        return;
+
+    default:
+        LOG_WARN("Unkown AMS command id");
+        response->Notify(ADSERR_CLIENT_SYNCRESINVALID);
+    }
+}
+
+void AmsConnection::Receive()
+{
+    rxBuffer->Write(socket.receive(rxBuffer->write, rxBuffer->WriteChunk()));
+
+    /* process all frames, which are complete. The mirror mapping keeps them contiguous, even at the wrap around. */
+    while (rxBuffer->BytesAvailable() >= sizeof(AmsTcpHeader)) {
+        const AmsTcpHeader amsTcpHeader { rxBuffer->read };
+        const size_t frameLength = sizeof(amsTcpHeader) + amsTcpHeader.length();
+        if (frameLength > RX_MAX_FRAME_SIZE) {
+            /* we lost track of the frame boundaries, nothing behind this header can be trusted anymore */
+            LOG_ERROR("AMS/TCP length: " << std::dec << amsTcpHeader.length() << " exceeds maximum frame size");
+            throw std::runtime_error("frame exceeds RX_MAX_FRAME_SIZE, closing connection");
+        }
+        if (rxBuffer->BytesAvailable() < frameLength) {
+            if (frameLength > rxBuffer->Capacity()) {
+                /* frame doesn't fit into our buffer, move the incomplete frame into one at least twice as large */
+                const auto available = rxBuffer->BytesAvailable();
+                const size_t maxCapacity = RX_MAX_FRAME_SIZE;
+                const auto capacity = std::min(maxCapacity, std::max(frameLength, 2 * rxBuffer->Capacity()));
+                std::unique_ptr<MirrorRingBuffer> larger;
+                try {
+                    larger.reset(new MirrorRingBuffer(capacity));
+                } catch (const std::bad_alloc&) {
+                    /* the rest of the frame can't be received, so the stream can't be resynchronized */
+                    LOG_ERROR("Out of memory for a frame of " << std::dec << frameLength << " bytes");
+                    throw std::runtime_error("receive buffer couldn't grow, closing connection");
+                }
+                memcpy(larger->write, rxBuffer->read, available);
+                larger->Write(available);
+                rxBuffer.swap(larger);
+            }
+            return;
+        }
+        if (frameLength > RX_CHUNK_SIZE) {
+            rxSmallCycles = 0;
+        }
+        ReceiveFrame(rxBuffer->read + sizeof(amsTcpHeader), amsTcpHeader.length());
+        rxBuffer->Read(frameLength);
+    }
+
+    /* keep a grown buffer for the next large frame, but release it, once large frames stopped */
+    if ((rxBuffer->Capacity() > RX_CHUNK_SIZE) && (++rxSmallCycles > RX_SHRINK_CYCLES) &&
+        !rxBuffer->BytesAvailable()) {
+        rxSmallCycles = 0;
+        try {
+            rxBuffer.reset(new MirrorRingBuffer(RX_CHUNK_SIZE));
+        } catch (const std::bad_alloc&) {
+            /* the grown buffer still works, try to shrink it again later */
+        }
     }
-    Receive(ring.write, bytesLeft);
-    ring.Write(bytesLeft);
-    dispatcher->Notify();
-    return true;
 }
 
 void AmsConnection::TryRecv()
@@ -313,52 +814,30 @@ void AmsConnection::TryRecv()
     } catch (const std::runtime_error& e) {
         LOG_INFO(e.what());
     }
+    StopReceiving();
+    if (orphaned) {
+        receiver.detach();
+        delete this;
+    }
+}
+
+void AmsConnection::StopReceiving()
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        receiving = false;
+    }
+    /* nobody will receive a response for outstanding asynchronous requests anymore */
+    Expire(Timepoint::max());
 }
 
 void AmsConnection::Recv()
 {
-    AmsTcpHeader amsTcpHeader;
-    AoEHeader aoeHeader;
     for ( ; ownIp; ) {
-        Receive(amsTcpHeader);
-        if (amsTcpHeader.length() < sizeof(aoeHeader)) {
-            LOG_WARN("Frame to short to be AoE");
-            ReceiveJunk(amsTcpHeader.length());
-            continue;
-        }
-
-        Receive(aoeHeader);
-        if (aoeHeader.cmdId() == AoEHeader::DEVICE_NOTIFICATION) {
-            ReceiveNotification(aoeHeader);
-            continue;
-        }
-
-        auto response = GetPending(aoeHeader.invokeId(), aoeHeader.targetPort());
-        if (!response) {
-            LOG_WARN("No response pending");
-            ReceiveJunk(aoeHeader.length());
-            continue;
-        }
-
-        switch (aoeHeader.cmdId()) {
-        case AoEHeader::READ_DEVICE_INFO:
-        case AoEHeader::WRITE:
-        case AoEHeader::READ_STATE:
-        case AoEHeader::WRITE_CONTROL:
-        case AoEHeader::ADD_DEVICE_NOTIFICATION:
-        case AoEHeader::DEL_DEVICE_NOTIFICATION:
-            ReceiveFrame<AoEResponseHeader>(response, aoeHeader.length(), aoeHeader.errorCode());
-            continue;
-
-        case AoEHeader::READ:
-        case AoEHeader::READ_WRITE:
-            ReceiveFrame<AoEReadResponseHeader>(response, aoeHeader.length(), aoeHeader.errorCode());
-            continue;
-
-        default:
-            LOG_WARN("Unkown AMS command id");
-            response->Notify(ADSERR_CLIENT_SYNCRESINVALID);
-            ReceiveJunk(aoeHeader.length());
+        Expire(std::chrono::steady_clock::now());
+        auto timeout = NextExpiry();
+        if (socket.Poll(&timeout)) {
+            Receive();
         }
     }
 }
@@ -32,24 +32,50 @@ bool operator==(const AmsAddr& lhs, const AmsAddr& rhs)
 
 AmsPort::AmsPort()
     : tmms(DEFAULT_TIMEOUT),
+    spinTime(0),
+    coalesce(false),
+    coalesceWindow(0),
+    notificationCapacity(NotificationDispatcher::DEFAULT_CAPACITY),
+    notificationOverflow(ADSOVERFLOW_DROPNEWEST),
+    notificationDelivery(ADSDELIVERY_QUEUED),
     port(0)
 {}
 
 void AmsPort::AddNotification(const AmsAddr ams, const uint32_t hNotify, SharedDispatcher dispatcher)
 {
+    dispatcher->Configure(notificationCapacity, notificationOverflow, notificationDelivery);
     std::lock_guard<std::mutex> lock(mutex);
     dispatcherList.emplace(NotifyUUID {ams, hNotify}, dispatcher);
 }
 
+void AmsPort::Erase(std::map<NotificationDispatcher*, DispatcherBatch>& batches, const uint32_t tmms)
+{
+    std::vector<long> errors;
+    for (auto& b : batches) {
+        errors.resize(b.second.second.size());
+        b.second.first->Erase(b.second.second, tmms, errors.data());
+    }
+}
+
 void AmsPort::Close()
 {
     std::lock_guard<std::mutex> lock(mutex);
 
+    std::map<NotificationDispatcher*, DispatcherBatch> batches;
     for (auto& d: dispatcherList) {
-        d.second->Erase(d.first.second, tmms);
+        auto& batch = batches[d.second.get()];
+        batch.first = d.second;
+        batch.second.push_back(d.first.second);
     }
+    Erase(batches, tmms);
     dispatcherList.clear();
     tmms = DEFAULT_TIMEOUT;
+    spinTime = 0;
+    coalesce = false;
+    coalesceWindow = 0;
+    notificationCapacity = NotificationDispatcher::DEFAULT_CAPACITY;
+    notificationOverflow = ADSOVERFLOW_DROPNEWEST;
+    notificationDelivery = ADSDELIVERY_QUEUED;
     port = 0;
 }
 
@@ -65,6 +91,37 @@ long AmsPort::DelNotification(const AmsAddr ams, uint32_t hNotify)
     return ADSERR_CLIENT_REMOVEHASH;
 }
 
+long AmsPort::DelNotifications(const AmsAddr ams, const uint32_t* hNotify, const uint32_t numNotify, long* errors)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<NotificationDispatcher*, DispatcherBatch> batches;
+    std::map<uint32_t, uint32_t> index;
+    for (uint32_t i = 0; i < numNotify; ++i) {
+        auto it = dispatcherList.find({ams, hNotify[i]});
+        if (it == dispatcherList.end()) {
+            errors[i] = ADSERR_CLIENT_REMOVEHASH;
+            continue;
+        }
+        auto& batch = batches[it->second.get()];
+        batch.first = it->second;
+        batch.second.push_back(hNotify[i]);
+        index[hNotify[i]] = i;
+        dispatcherList.erase(it);
+    }
+
+    long status = 0;
+    std::vector<long> results;
+    for (auto& b : batches) {
+        results.resize(b.second.second.size());
+        const auto error = b.second.first->Erase(b.second.second, tmms, results.data());
+        status = status ? status : error;
+        for (size_t i = 0; i < results.size(); ++i) {
+            errors[index[b.second.second[i]]] = results[i];
+        }
+    }
+    return status;
+}
+
 bool AmsPort::IsOpen() const
 {
     return !!port;
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: MIT
+/**
+   Copyright (c) 2021 Beckhoff Automation GmbH & Co. KG
+ */
+
+#include "AmsReactor.h"
+
+#if defined(__linux__)
+#include "AmsConnection.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static const int MAX_EVENTS = 64;
+
+AmsReactor::Loop::Loop()
+    : epollFd(epoll_create1(EPOLL_CLOEXEC)),
+    wakeFd(eventfd(0, EFD_CLOEXEC)),
+    active(nullptr)
+{
+    if ((epollFd < 0) || (wakeFd < 0)) {
+        const auto error = errno;
+        close(epollFd);
+        close(wakeFd);
+        throw std::system_error(error, std::system_category());
+    }
+
+    /* the wakeFd is registered with a nullptr, which is never a valid connection */
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    thread = std::thread(&AmsReactor::Loop::Run, this);
+}
+
+AmsReactor::Loop::~Loop()
+{
+    Stop();
+    close(wakeFd);
+    close(epollFd);
+}
+
+void AmsReactor::Loop::Stop()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    const uint64_t stop = 1;
+    if (sizeof(stop) != write(wakeFd, &stop, sizeof(stop))) {
+        LOG_ERROR("Failed to stop reactor thread");
+    }
+    thread.join();
+}
+
+bool AmsReactor::Loop::Acquire(AmsConnection* const connection)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    /* connection might have been removed, after epoll_wait() returned */
+    if (!connections.count(connection)) {
+        return false;
+    }
+    active = connection;
+    return true;
+}
+
+void AmsReactor::Loop::Release(AmsConnection* const connection, const bool closed)
+{
+    if (closed) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->socket.Handle(), nullptr);
+            connections.erase(connection);
+        }
+        /* still active, so nobody destroys connection, while its outstanding requests are completed */
+        connection->StopReceiving();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    active = nullptr;
+    idle.notify_all();
+}
+
+void AmsReactor::Loop::DestroyRetired()
+{
+    /* destructors complete outstanding requests, whose callbacks might retire even more connections */
+    while (!retired.empty()) {
+        std::vector<std::unique_ptr<AmsConnection> > doomed;
+        doomed.swap(retired);
+    }
+}
+
+void AmsReactor::Loop::Run()
+{
+    epoll_event events[MAX_EVENTS];
+    auto nextExpiry = std::chrono::steady_clock::now();
+    int timeout = AmsConnection::EXPIRE_INTERVAL_MS;
+
+    for ( ;; ) {
+        const int numEvents = epoll_wait(epollFd, events, MAX_EVENTS, timeout);
+        if ((numEvents < 0) && (errno != EINTR)) {
+            LOG_ERROR("epoll_wait() failed with error: " << std::dec << std::strerror(errno));
+        }
+
+        for (int i = 0; i < numEvents; ++i) {
+            const auto connection = static_cast<AmsConnection*>(events[i].data.ptr);
+            if (!connection) {
+                /* retired connections are destroyed by ~AmsReactor(), after all loops were stopped */
+                return;
+            }
+
+            if (!Acquire(connection)) {
+                continue;
+            }
+
+            bool closed = false;
+            if (events[i].events & EPOLLIN) {
+                try {
+                    connection->Receive();
+                } catch (const std::runtime_error& e) {
+                    LOG_INFO(e.what());
+                    closed = true;
+                }
+            } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                LOG_INFO("connection closed by remote");
+                closed = true;
+            }
+            Release(connection, closed);
+        }
+
+        /* check the deadlines of asynchronous requests with the same granularity as a receive thread would */
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= nextExpiry) {
+            auto next = std::chrono::microseconds(AmsConnection::EXPIRE_INTERVAL_MS * 1000);
+            /* completions of expired requests might remove connections, so we iterate over a copy */
+            std::set<AmsConnection*> current;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = connections;
+            }
+            for (const auto connection : current) {
+                if (!Acquire(connection)) {
+                    continue;
+                }
+                connection->Expire(now);
+                const auto left = connection->NextExpiry();
+                next = std::min(next, std::chrono::microseconds((int64_t)left.tv_sec * 1000000 + left.tv_usec));
+                Release(connection, false);
+            }
+            nextExpiry = now + next;
+        }
+        DestroyRetired();
+
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(nextExpiry - now);
+        timeout = std::max<int>(0, static_cast<int>(left.count()) + 1);
+    }
+}
+
+AmsReactor::AmsReactor(const size_t numThreads)
+{
+    for (size_t i = 0; (i < std::max<size_t>(1, numThreads)) && (i < MAX_THREADS); ++i) {
+        loops.emplace_back(new Loop {});
+    }
+}
+
+AmsReactor::~AmsReactor()
+{
+    /* stop all loops first, the retired connections still need the reactor to remove themselves */
+    for (const auto& loop : loops) {
+        loop->Stop();
+    }
+    for (const auto& loop : loops) {
+        loop->DestroyRetired();
+    }
+}
+
+void AmsReactor::Add(AmsConnection* const connection)
+{
+    Loop* loop = loops.front().get();
+    size_t least = SIZE_MAX;
+    for (const auto& l : loops) {
+        std::lock_guard<std::mutex> lock(l->mutex);
+        if (l->connections.size() < least) {
+            least = l->connections.size();
+            loop = l.get();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(loop->mutex);
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = connection;
+    if (epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, connection->socket.Handle(), &event)) {
+        throw std::system_error(errno, std::system_category());
+    }
+    loop->connections.insert(connection);
+}
+
+void AmsReactor::Remove(AmsConnection* const connection)
+{
+    for (const auto& loop : loops) {
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        if (loop->connections.erase(connection)) {
+            epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, connection->socket.Handle(), nullptr);
+        }
+
+        /* the loop thread itself never waits, it only destroys connections, which are not active, see Retire() */
+        if (std::this_thread::get_id() != loop->thread.get_id()) {
+            loop->idle.wait(lock, [&]() { return loop->active != connection; });
+        }
+    }
+}
+
+bool AmsReactor::Retire(std::vector<std::unique_ptr<AmsConnection> >& connections)
+{
+    for (const auto& loop : loops) {
+        if (std::this_thread::get_id() == loop->thread.get_id()) {
+            for (auto& c : connections) {
+                loop->retired.push_back(std::move(c));
+            }
+            connections.clear();
+            return true;
+        }
+    }
+    return false;
+}
+#else
+#include "AmsConnection.h"
+
+#include <stdexcept>
+
+AmsReactor::AmsReactor(size_t)
+{
+    throw std::runtime_error("AmsReactor requires epoll, which is not available on this platform");
+}
+
+AmsReactor::~AmsReactor()
+{}
+
+AmsReactor::Loop::~Loop()
+{}
+
+void AmsReactor::Add(AmsConnection*)
+{}
+
+void AmsReactor::Remove(AmsConnection*)
+{}
+
+bool AmsReactor::Retire(std::vector<std::unique_ptr<AmsConnection> >&)
+{
+    return false;
+}
+#endif
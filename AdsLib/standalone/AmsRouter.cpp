@@ -24,12 +24,66 @@
 #include "Log.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
+/** upper limit for the number of threads AddRoutes() uses to connect in parallel */
+static const size_t MAX_CONNECT_THREADS = 64;
 
 AmsRouter::AmsRouter(AmsNetId netId)
-    : localAddr(netId)
+    : localAddr(netId),
+    connecting(0),
+    closing(0)
 {}
 
-long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip)
+long AmsRouter::SetReceiveThreads(const uint32_t numThreads)
+{
+    if (numThreads > AmsReactor::MAX_THREADS) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!connections.empty() || connecting || closing) {
+        /* existing connections are bound to the current receive mode */
+        return ADSERR_DEVICE_INVALIDSTATE;
+    }
+    if (numThreads) {
+        /* a loop thread waiting for room in a notification buffer would stall all of its connections */
+        for (const auto& p : ports) {
+            if (p.IsOpen() && (ADSOVERFLOW_BLOCK == p.notificationOverflow)) {
+                return ADSERR_DEVICE_INVALIDSTATE;
+            }
+        }
+    }
+
+    reactor.reset();
+    if (numThreads) {
+        try {
+            reactor.reset(new AmsReactor { numThreads });
+        } catch (const std::runtime_error& e) {
+            LOG_ERROR(e.what());
+            return ADSERR_DEVICE_SRVNOTSUPP;
+        }
+    }
+    return 0;
+}
+
+long AmsRouter::SetNotificationThreads(const uint32_t numThreads)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!connections.empty() || connecting || closing) {
+        /* the dispatchers of existing connections are bound to the current mode */
+        return ADSERR_DEVICE_INVALIDSTATE;
+    }
+
+    notificationPool.reset();
+    if (numThreads) {
+        notificationPool.reset(new NotificationPool { numThreads });
+    }
+    return 0;
+}
+
+long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip, const SocketOptions& options, const size_t numConnections)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
 
@@ -43,35 +97,163 @@ long AmsRouter::AddRoute(AmsNetId ams, const IpV4& ip)
     }
 
     auto conn = connections.find(ip);
+    if ((conn != connections.end()) && (std::max<size_t>(1, numConnections) != NumConnections(ip))) {
+        /* the connections to this target are shared with other routes, delete those first to reconfigure */
+        return ROUTERERR_PORTALREADYINUSE;
+    }
     if (conn == connections.end()) {
-        conn = connections.emplace(ip, std::unique_ptr<AmsConnection>(new AmsConnection { *this, ip })).first;
+        conn = connections.emplace(ip, std::unique_ptr<AmsConnection>(new AmsConnection { *this, ip, reactor.get(), options, notificationPool.get() })).first;
+        requestedConnections[ip] = std::max<size_t>(1, numConnections);
 
         /** in case no local AmsNetId was set previously, we derive one */
         if (!localAddr) {
             localAddr = AmsNetId {conn->second->ownIp};
         }
+
+        auto& bulk = bulkConnections[ip];
+        for (size_t i = 1; (i < numConnections) && conn->second->ownIp; ++i) {
+            std::unique_ptr<AmsConnection> stripe { new AmsConnection { *this, ip, reactor.get(), options, notificationPool.get() } };
+            if (stripe->ownIp) {
+                bulk.push_back(std::move(stripe));
+            } else {
+                LOG_WARN("Additional connection " << std::dec << i << " failed, using only " << bulk.size() + 1);
+                break;
+            }
+        }
     }
 
-    conn->second->refCount++;
-    mapping[ams] = conn->second.get();
-    return !conn->second->ownIp;
+    return MapRoute(ams, conn->second.get());
 }
 
-void AmsRouter::DelRoute(const AmsNetId& ams)
+long AmsRouter::MapRoute(const AmsNetId ams, AmsConnection* const conn)
 {
+    conn->refCount++;
+    mapping[ams] = conn;
+    return !conn->ownIp;
+}
+
+std::vector<long> AmsRouter::AddRoutes(const std::vector<std::pair<AmsNetId, IpV4> >& routes,
+                                       const SocketOptions&                          options)
+{
+    std::vector<long> errors(routes.size(), 0);
+    std::vector<IpV4> targets;
+    AmsReactor* pollReactor;
+    NotificationPool* pollPool;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        for (size_t i = 0; i < routes.size(); ++i) {
+            const auto oldConnection = GetConnection(routes[i].first);
+            if (oldConnection && !(routes[i].second == oldConnection->destIp)) {
+                errors[i] = ROUTERERR_PORTALREADYINUSE;
+            } else if (!connections.count(routes[i].second) &&
+                       (std::find(targets.begin(), targets.end(), routes[i].second) == targets.end())) {
+                targets.push_back(routes[i].second);
+            }
+        }
+        pollReactor = reactor.get();
+        pollPool = notificationPool.get();
+        ++connecting;
+    }
+
+    /* connect to all new targets in parallel, without blocking the router */
+    std::vector<std::unique_ptr<AmsConnection> > fresh(targets.size());
+    std::vector<long> connectErrors(targets.size(), 0);
+    std::atomic<size_t> next(0);
+    const auto connect = [&]() {
+                             for (size_t i = next++; i < targets.size(); i = next++) {
+                                 try {
+                                     fresh[i].reset(new AmsConnection { *this, targets[i], pollReactor, options, pollPool });
+                                 } catch (const std::bad_alloc&) {
+                                     connectErrors[i] = GLOBALERR_NO_MEMORY;
+                                 } catch (const std::runtime_error&) {
+                                     connectErrors[i] = GLOBALERR_TARGET_PORT;
+                                 }
+                             }
+                         };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(targets.size(), MAX_CONNECT_THREADS); ++i) {
+        threads.emplace_back(connect);
+    }
+    connect();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    /* connections which lost the race against a concurrent AddRoute() are destroyed without holding the lock */
+    std::vector<std::unique_ptr<AmsConnection> > duplicates;
     std::lock_guard<std::recursive_mutex> lock(mutex);
+    --connecting;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (!fresh[i]) {
+            continue;
+        }
+        if (connections.count(targets[i])) {
+            duplicates.push_back(std::move(fresh[i]));
+            continue;
+        }
 
-    auto route = mapping.find(ams);
-    if (route != mapping.end()) {
-        AmsConnection* conn = route->second;
-        if (0 == --conn->refCount) {
-            mapping.erase(route);
-            DeleteIfLastConnection(conn);
+        /** in case no local AmsNetId was set previously, we derive one */
+        if (!localAddr) {
+            localAddr = AmsNetId {fresh[i]->ownIp};
         }
+        connections.emplace(targets[i], std::move(fresh[i]));
     }
+
+    for (size_t i = 0; i < routes.size(); ++i) {
+        if (errors[i]) {
+            continue;
+        }
+        const auto oldConnection = GetConnection(routes[i].first);
+        if (oldConnection && !(routes[i].second == oldConnection->destIp)) {
+            errors[i] = ROUTERERR_PORTALREADYINUSE;
+            continue;
+        }
+        const auto conn = connections.find(routes[i].second);
+        if (conn == connections.end()) {
+            const auto target = std::find(targets.begin(), targets.end(), routes[i].second) - targets.begin();
+            errors[i] = connectErrors[target];
+            continue;
+        }
+        errors[i] = MapRoute(routes[i].first, conn->second.get());
+    }
+    return errors;
 }
 
-void AmsRouter::DeleteIfLastConnection(const AmsConnection* conn)
+void AmsRouter::DelRoute(const AmsNetId& ams)
+{
+    std::vector<std::unique_ptr<AmsConnection> > unused;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        auto route = mapping.find(ams);
+        if (route != mapping.end()) {
+            AmsConnection* conn = route->second;
+            if (0 == --conn->refCount) {
+                mapping.erase(route);
+                DeleteIfLastConnection(conn, unused);
+            }
+        }
+
+        /* called from a callback on a reactor thread, which might still use one of the connections */
+        if (unused.empty() || (reactor && reactor->Retire(unused))) {
+            return;
+        }
+        /* called from a callback on the receive thread of one of the connections, which can't join itself */
+        for (auto& conn : unused) {
+            if (conn->Orphan()) {
+                conn.release();
+            }
+        }
+        ++closing;
+    }
+
+    /* receive threads might still run callbacks, which need the lock, while we wait for them to stop */
+    unused.clear();
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    --closing;
+}
+
+void AmsRouter::DeleteIfLastConnection(const AmsConnection* conn, std::vector<std::unique_ptr<AmsConnection> >& unused)
 {
     if (conn) {
         for (const auto& r : mapping) {
@@ -79,7 +261,17 @@ void AmsRouter::DeleteIfLastConnection(const AmsConnection* conn)
                 return;
             }
         }
-        connections.erase(conn->destIp);
+        const auto bulk = bulkConnections.find(conn->destIp);
+        if (bulk != bulkConnections.end()) {
+            for (auto& stripe : bulk->second) {
+                unused.push_back(std::move(stripe));
+            }
+            bulkConnections.erase(bulk);
+        }
+        const auto it = connections.find(conn->destIp);
+        unused.push_back(std::move(it->second));
+        connections.erase(it);
+        requestedConnections.erase(conn->destIp);
     }
 }
 
@@ -102,6 +294,9 @@ long AmsRouter::ClosePort(uint16_t port)
         return ADSERR_CLIENT_PORTNOTOPEN;
     }
     ports[port - PORT_BASE].Close();
+    for (const auto& dispatcher : GetDispatchers(port)) {
+        dispatcher->Reset();
+    }
     return 0;
 }
 
@@ -148,6 +343,96 @@ long AmsRouter::SetTimeout(uint16_t port, uint32_t timeout)
     return 0;
 }
 
+long AmsRouter::SetSpinTime(uint16_t port, uint32_t spinTime)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+
+    ports[port - PORT_BASE].spinTime = spinTime;
+    return 0;
+}
+
+long AmsRouter::SetCoalescing(uint16_t port, bool enable, uint32_t window)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+
+    ports[port - PORT_BASE].coalesce = enable;
+    ports[port - PORT_BASE].coalesceWindow = window;
+    return 0;
+}
+
+long AmsRouter::SetNotificationBuffer(uint16_t port, uint32_t capacity, ADSNOTIFICATIONOVERFLOW overflow)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+    if ((overflow != ADSOVERFLOW_DROPNEWEST) && (overflow != ADSOVERFLOW_DROPOLDEST) &&
+        (overflow != ADSOVERFLOW_BLOCK)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+    if ((ADSOVERFLOW_BLOCK == overflow) && reactor) {
+        return ADSERR_DEVICE_INVALIDSTATE;
+    }
+
+    auto& p = ports[port - PORT_BASE];
+    p.notificationCapacity = capacity;
+    p.notificationOverflow = overflow;
+    for (const auto& dispatcher : GetDispatchers(port)) {
+        dispatcher->Configure(capacity, overflow, p.notificationDelivery);
+    }
+    return 0;
+}
+
+long AmsRouter::SetNotificationDelivery(uint16_t port, ADSNOTIFICATIONDELIVERY delivery)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX)) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+    if ((delivery != ADSDELIVERY_QUEUED) && (delivery != ADSDELIVERY_DIRECT)) {
+        return ADSERR_CLIENT_INVALIDPARM;
+    }
+
+    auto& p = ports[port - PORT_BASE];
+    p.notificationDelivery = delivery;
+    for (const auto& dispatcher : GetDispatchers(port)) {
+        dispatcher->Configure(p.notificationCapacity, p.notificationOverflow, delivery);
+    }
+    return 0;
+}
+
+long AmsRouter::GetNotificationStatistics(uint16_t port, const AmsAddr& addr, AdsNotificationStatistics& statistics)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if ((port < PORT_BASE) || (port >= PORT_BASE + NUM_PORTS_MAX) || !ports[port - PORT_BASE].IsOpen()) {
+        return ADSERR_CLIENT_PORTNOTOPEN;
+    }
+
+    const auto ads = GetConnection(addr.netId);
+    if (!ads) {
+        return GLOBALERR_MISSING_ROUTE;
+    }
+    const auto dispatcher = ads->DispatcherListGet(VirtualConnection { port, addr });
+    statistics = dispatcher ? dispatcher->Statistics() : AdsNotificationStatistics {};
+    return 0;
+}
+
+std::vector<SharedDispatcher> AmsRouter::GetDispatchers(const uint16_t port)
+{
+    std::vector<SharedDispatcher> result;
+    for (const auto& conn : connections) {
+        const auto dispatchers = conn.second->GetDispatchers(port);
+        result.insert(result.end(), dispatchers.begin(), dispatchers.end());
+    }
+    return result;
+}
+
 AmsConnection* AmsRouter::GetConnection(const AmsNetId& amsDest)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex);
@@ -167,17 +452,67 @@ std::map<IpV4, std::unique_ptr<AmsConnection> >::iterator AmsRouter::__GetConnec
     return connections.end();
 }
 
+size_t AmsRouter::NumConnections(const IpV4& ip) const
+{
+    const auto it = requestedConnections.find(ip);
+    return (it == requestedConnections.end()) ? 1 : it->second;
+}
+
+AmsConnection* AmsRouter::SelectConnection(const AmsRequest& request)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    const auto it = __GetConnection(request.destAddr.netId);
+    if (it == connections.end()) {
+        return nullptr;
+    }
+
+    if (static_cast<size_t>(request.bufferLength) + request.payloadLength < BULK_THRESHOLD) {
+        return it->second.get();
+    }
+
+    const auto bulk = bulkConnections.find(it->first);
+    if ((bulk == bulkConnections.end()) || bulk->second.empty()) {
+        return it->second.get();
+    }
+
+    /* spread large requests over the bulk connections, preferring the least busy one */
+    AmsConnection* best = bulk->second.front().get();
+    size_t bestOutstanding = best->Outstanding();
+    for (const auto& conn : bulk->second) {
+        const auto outstanding = conn->Outstanding();
+        if (outstanding < bestOutstanding) {
+            best = conn.get();
+            bestOutstanding = outstanding;
+        }
+    }
+    return best;
+}
+
 long AmsRouter::AdsRequest(AmsRequest& request)
 {
     if (request.bytesRead) {
         *request.bytesRead = 0;
     }
 
-    auto ads = GetConnection(request.destAddr.netId);
+    auto ads = SelectConnection(request);
+    if (!ads) {
+        return GLOBALERR_MISSING_ROUTE;
+    }
+    const auto& port = ports[request.port - Router::PORT_BASE];
+    if (port.coalesce && (static_cast<size_t>(request.bufferLength) + request.payloadLength < BULK_THRESHOLD)) {
+        return ads->AdsRequestCoalesced(request, port.tmms, port.spinTime, port.coalesceWindow);
+    }
+    return ads->AdsRequest(request, port.tmms, port.spinTime);
+}
+
+long AmsRouter::AdsRequestAsync(std::unique_ptr<AmsRequest> request, AmsCompletion completion)
+{
+    auto ads = SelectConnection(*request);
     if (!ads) {
         return GLOBALERR_MISSING_ROUTE;
     }
-    return ads->AdsRequest(request, ports[request.port - Router::PORT_BASE].tmms);
+    const auto timeout = ports[request->port - Router::PORT_BASE].tmms;
+    return ads->AdsRequestAsync(std::move(request), timeout, completion);
 }
 
 long AmsRouter::AddNotification(AmsRequest& request, uint32_t* pNotification, std::shared_ptr<Notification> notify)
@@ -201,8 +536,71 @@ long AmsRouter::AddNotification(AmsRequest& request, uint32_t* pNotification, st
     return status;
 }
 
+long AmsRouter::AddNotifications(AmsRequest&                                         request,
+                                 const std::vector<AdsAddDeviceNotificationRequest>& attribs,
+                                 const std::vector<std::shared_ptr<Notification> >&  notify,
+                                 uint32_t*                                           pNotifications,
+                                 long*                                               errors)
+{
+    auto ads = GetConnection(request.destAddr.netId);
+    if (!ads) {
+        return GLOBALERR_MISSING_ROUTE;
+    }
+
+    auto& port = ports[request.port - Router::PORT_BASE];
+    const long status = ads->AdsRequest(request, port.tmms);
+    if (ADSERR_DEVICE_SRVNOTSUPP == status) {
+        /* older runtimes don't support ADSIGRP_SUMUP_ADDDEVNOTE, so the notifications are added one by one */
+        for (size_t i = 0; i < notify.size(); ++i) {
+            uint8_t buffer[sizeof(uint32_t)];
+            AmsRequest single {
+                request.destAddr,
+                request.port,
+                AoEHeader::ADD_DEVICE_NOTIFICATION,
+                sizeof(buffer),
+                buffer,
+                nullptr,
+                sizeof(AdsAddDeviceNotificationRequest)
+            };
+            single.frame.prepend(attribs[i]);
+            pNotifications[i] = 0;
+            errors[i] = AddNotification(single, &pNotifications[i], notify[i]);
+        }
+        return 0;
+    }
+    if (status) {
+        return status;
+    }
+    if (*request.bytesRead < notify.size() * 2 * sizeof(uint32_t)) {
+        return ADSERR_DEVICE_INVALIDSIZE;
+    }
+
+    /* response: {list of results, handles} */
+    const auto response = static_cast<const uint8_t*>(request.buffer);
+    for (size_t i = 0; i < notify.size(); ++i) {
+        errors[i] = bhf::ads::letoh<uint32_t>(response + i * 2 * sizeof(uint32_t));
+        pNotifications[i] = 0;
+        if (!errors[i]) {
+            pNotifications[i] = bhf::ads::letoh<uint32_t>(response + (i * 2 + 1) * sizeof(uint32_t));
+            auto dispatcher = ads->CreateNotifyMapping(pNotifications[i], notify[i]);
+            port.AddNotification(request.destAddr, pNotifications[i], dispatcher);
+        }
+    }
+    return 0;
+}
+
 long AmsRouter::DelNotification(uint16_t port, const AmsAddr* pAddr, uint32_t hNotification)
 {
     auto& p = ports[port - Router::PORT_BASE];
     return p.DelNotification(*pAddr, hNotification);
 }
+
+long AmsRouter::DelNotifications(uint16_t        port,
+                                 const AmsAddr*  pAddr,
+                                 const uint32_t* hNotifications,
+                                 uint32_t        count,
+                                 long*           errors)
+{
+    auto& p = ports[port - Router::PORT_BASE];
+    return p.DelNotifications(*pAddr, hNotifications, count, errors);
+}
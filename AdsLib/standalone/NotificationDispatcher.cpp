@@ -22,85 +22,506 @@
 
 #include "NotificationDispatcher.h"
 #include "Log.h"
+#include "wrap_endian.h"
+#include <algorithm>
 #include <future>
 
-NotificationDispatcher::NotificationDispatcher(DeleteNotificationCallback callback)
+NotificationDispatcher::NotificationDispatcher(DeleteNotificationCallback  callback,
+                                               DeleteNotificationsCallback bulkCallback,
+                                               NotificationPool*           __pool)
     : deleteNotification(callback)
-    , ring(4 * 1024 * 1024)
+    , deleteNotifications(bulkCallback)
+    , pool(__pool)
+    , table(new Table(0))
+    , lookup(table.get())
+    , retired(false)
     , stopExecution(false)
-    , thread(&NotificationDispatcher::Run, this)
-{}
+    , pendingBegin(0)
+    , scheduled(false)
+    , busy(false)
+    , capacity(DEFAULT_CAPACITY)
+    , overflow(ADSOVERFLOW_DROPNEWEST)
+    , delivery(ADSDELIVERY_QUEUED)
+    , statistics()
+{
+    if (!pool) {
+        thread = std::thread(&NotificationDispatcher::Run, this);
+    }
+}
 
 NotificationDispatcher::~NotificationDispatcher()
 {
-    stopExecution = true;
-    sem.release();
-    thread.join();
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopExecution = true;
+    }
+    posted.notify_all();
+    drained.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+/** marks erased slots, it is never dereferenced */
+static char deletedSlot;
+static Notification* const DELETED = reinterpret_cast<Notification*>(&deletedSlot);
+
+NotificationDispatcher::Table::Table(const size_t minCapacity)
+    : used(0),
+    shift(32 - 4)
+{
+    while ((size_t(1) << (32 - shift)) < minCapacity) {
+        --shift;
+    }
+    mask = (size_t(1) << (32 - shift)) - 1;
+    slots.reset(new Slot[mask + 1]);
+    for (size_t i = 0; i <= mask; ++i) {
+        slots[i].hNotify.store(0, std::memory_order_relaxed);
+        slots[i].notification.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+size_t NotificationDispatcher::Table::Index(const uint32_t hNotify) const
+{
+    /* handles are often consecutive, Fibonacci hashing spreads them over the table */
+    return (hNotify * 2654435769U) >> shift;
+}
+
+const Notification* NotificationDispatcher::Table::Find(const uint32_t hNotify) const
+{
+    /* an empty slot ends the search, there is always one, because the table is at most half full */
+    for (auto i = Index(hNotify); ; i = (i + 1) & mask) {
+        const auto notification = slots[i].notification.load(std::memory_order_acquire);
+        if (!notification) {
+            return nullptr;
+        }
+        if ((DELETED != notification) && (hNotify == slots[i].hNotify.load(std::memory_order_relaxed))) {
+            return notification;
+        }
+    }
+}
+
+void NotificationDispatcher::Table::Insert(const uint32_t hNotify, Notification* const notification)
+{
+    auto i = Index(hNotify);
+    while (slots[i].notification.load(std::memory_order_relaxed)) {
+        i = (i + 1) & mask;
+    }
+    /* readers check notification first, so hNotify has to be valid, before it is published */
+    slots[i].hNotify.store(hNotify, std::memory_order_relaxed);
+    slots[i].notification.store(notification, std::memory_order_release);
+    ++used;
+}
+
+void NotificationDispatcher::Table::Remove(const uint32_t hNotify)
+{
+    for (auto i = Index(hNotify); slots[i].notification.load(std::memory_order_relaxed); i = (i + 1) & mask) {
+        const auto notification = slots[i].notification.load(std::memory_order_relaxed);
+        if ((DELETED != notification) && (hNotify == slots[i].hNotify.load(std::memory_order_relaxed))) {
+            slots[i].notification.store(DELETED, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+bool NotificationDispatcher::Table::Full() const
+{
+    return 2 * (used + 1) > mask + 1;
 }
 
 void NotificationDispatcher::Emplace(uint32_t hNotify, std::shared_ptr<Notification> notification)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    notifications.emplace(hNotify, notification);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto inserted = notifications.emplace(hNotify, notification);
+        if (!inserted.second) {
+            return;
+        }
+
+        if (!table->Full()) {
+            table->Insert(hNotify, notification.get());
+            return;
+        }
+
+        /* erased slots are dropped by the copy, so it might even shrink */
+        std::unique_ptr<Table> larger(new Table(4 * notifications.size()));
+        for (const auto& n : notifications) {
+            larger->Insert(n.first, n.second.get());
+        }
+        lookup.store(larger.get(), std::memory_order_release);
+        table.swap(larger);
+        retiredTables.push_back(std::move(larger));
+        retired.store(true, std::memory_order_release);
+    }
+    ReclaimIdle();
+}
+
+void NotificationDispatcher::Remove(const uint32_t hNotify)
+{
+    auto it = notifications.find(hNotify);
+    if (it == notifications.end()) {
+        return;
+    }
+    table->Remove(hNotify);
+    retiredNotifications.push_back(std::move(it->second));
+    notifications.erase(it);
+    retired.store(true, std::memory_order_release);
 }
 
 long NotificationDispatcher::Erase(uint32_t hNotify, uint32_t tmms)
 {
     const auto status = deleteNotification(hNotify, tmms);
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    notifications.erase(hNotify);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Remove(hNotify);
+    }
+    ReclaimIdle();
     return status;
 }
 
-std::shared_ptr<Notification> NotificationDispatcher::Find(uint32_t hNotify)
+long NotificationDispatcher::Erase(const std::vector<uint32_t>& hNotify, uint32_t tmms, long* errors)
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
-    auto it = notifications.find(hNotify);
-    if (it != notifications.end()) {
-        return it->second;
+    const auto status = deleteNotifications(hNotify, tmms, errors);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& h : hNotify) {
+            Remove(h);
+        }
     }
-    return {};
+    ReclaimIdle();
+    return status;
 }
 
-void NotificationDispatcher::Notify()
+void NotificationDispatcher::Reclaim()
 {
-    sem.release();
+    if (!retired.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    /* the reader is done with this batch, so nothing refers to retired objects anymore */
+    std::vector<std::shared_ptr<Notification> > notificationsToRelease;
+    std::vector<std::unique_ptr<Table> > tablesToRelease;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        notificationsToRelease.swap(retiredNotifications);
+        tablesToRelease.swap(retiredTables);
+        retired.store(false, std::memory_order_relaxed);
+    }
+}
+
+void NotificationDispatcher::ReclaimIdle()
+{
+    if (!retired.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Notification> > notificationsToRelease;
+    std::vector<std::unique_ptr<Table> > tablesToRelease;
+    {
+        /* no reader can start, while pendingMutex is held, and it would only see the current table anyway */
+        std::lock_guard<std::mutex> pendingLock(pendingMutex);
+        if (busy) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        notificationsToRelease.swap(retiredNotifications);
+        tablesToRelease.swap(retiredTables);
+        retired.store(false, std::memory_order_relaxed);
+    }
+}
+
+void NotificationDispatcher::Configure(const uint32_t                __capacity,
+                                       const ADSNOTIFICATIONOVERFLOW __overflow,
+                                       const ADSNOTIFICATIONDELIVERY __delivery)
+{
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        capacity = __capacity;
+        overflow = __overflow;
+        delivery = __delivery;
+    }
+    /* a blocked receiver might fit now or has to drop instead */
+    drained.notify_all();
+}
+
+void NotificationDispatcher::Reset()
+{
+    Configure(DEFAULT_CAPACITY, ADSOVERFLOW_DROPNEWEST, ADSDELIVERY_QUEUED);
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    statistics = AdsNotificationStatistics {};
+}
+
+AdsNotificationStatistics NotificationDispatcher::Statistics()
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    auto result = statistics;
+    result.pendingBytes = pending.size() - pendingBegin;
+    return result;
 }
 
 void NotificationDispatcher::Run()
 {
     for ( ; ; ) {
-        sem.acquire();
-        if (stopExecution) {
+        {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            posted.wait(lock, [this]() {
+                return stopExecution || (pending.size() > pendingBegin);
+            });
+            if (stopExecution) {
+                return;
+            }
+        }
+        Dispatch();
+    }
+}
+
+/** number of samples within a notification frame, truncated frames are counted as far as they go */
+static uint64_t CountSamples(const uint8_t* const frame, const uint32_t length)
+{
+    uint64_t count = 0;
+    size_t pos = 2 * sizeof(uint32_t);
+    if (pos > length) {
+        return count;
+    }
+    const auto numStamps = bhf::ads::letoh<uint32_t>(frame + sizeof(uint32_t));
+    for (uint32_t stamp = 0; (stamp < numStamps) && (pos + sizeof(uint64_t) + sizeof(uint32_t) <= length); ++stamp) {
+        const auto numSamples = bhf::ads::letoh<uint32_t>(frame + pos + sizeof(uint64_t));
+        pos += sizeof(uint64_t) + sizeof(uint32_t);
+        for (uint32_t sample = 0; (sample < numSamples) && (pos + 2 * sizeof(uint32_t) <= length); ++sample) {
+            pos += 2 * sizeof(uint32_t) + bhf::ads::letoh<uint32_t>(frame + pos + sizeof(uint32_t));
+            ++count;
+        }
+    }
+    return count;
+}
+
+void NotificationDispatcher::Drop(const uint8_t* const frame, const uint32_t length)
+{
+    ++statistics.droppedFrames;
+    statistics.droppedSamples += CountSamples(frame, length);
+}
+
+bool NotificationDispatcher::Post(const uint8_t* const frame, const uint32_t length)
+{
+    uint8_t prefix[sizeof(length)];
+    memcpy(prefix, &length, sizeof(length));
+    const auto required = sizeof(prefix) + length;
+
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    while (pending.size() - pendingBegin + required > capacity) {
+        if ((ADSOVERFLOW_DROPOLDEST == overflow) && (pending.size() > pendingBegin)) {
+            uint32_t oldest;
+            memcpy(&oldest, pending.data() + pendingBegin, sizeof(oldest));
+            Drop(pending.data() + pendingBegin + sizeof(oldest), oldest);
+            pendingBegin += sizeof(oldest) + oldest;
+            continue;
+        }
+
+        /* a frame larger than capacity will never fit, waiting for it would block forever */
+        if ((ADSOVERFLOW_BLOCK == overflow) && (required <= capacity) && !stopExecution) {
+            drained.wait(lock);
+            continue;
+        }
+        Drop(frame, length);
+        return false;
+    }
+
+    /* reclaim the space of dropped frames, once it makes up most of the buffer */
+    if (pendingBegin > pending.size() / 2) {
+        pending.erase(pending.begin(), pending.begin() + pendingBegin);
+        pendingBegin = 0;
+    }
+    pending.insert(pending.end(), prefix, prefix + sizeof(prefix));
+    pending.insert(pending.end(), frame, frame + length);
+    statistics.peakBytes = std::max<uint64_t>(statistics.peakBytes, pending.size() - pendingBegin);
+
+    if (!pool) {
+        posted.notify_one();
+    } else if (!scheduled) {
+        scheduled = true;
+        pool->Schedule(shared_from_this());
+    }
+    return true;
+}
+
+bool NotificationDispatcher::Deliver(uint8_t* const frame, const uint32_t length)
+{
+    bool queued;
+    {
+        /*
+         * only the receiving thread posts frames, so the queue can't fill up behind our back.
+         * A scheduled Dispatch() might still run, even if its frames were dropped meanwhile.
+         */
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        queued = (ADSDELIVERY_DIRECT != delivery) || busy || scheduled || (pending.size() > pendingBegin);
+        if (!queued) {
+            busy = true;
+        }
+    }
+    if (queued) {
+        return Post(frame, length);
+    }
+    DispatchFrame(frame, length, nullptr);
+    Reclaim();
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    busy = false;
+    return true;
+}
+
+void NotificationDispatcher::Dispatch()
+{
+    size_t begin;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (pending.size() == pendingBegin) {
+            /* ADSOVERFLOW_DROPOLDEST dropped the frames, this Dispatch() was scheduled for */
+            scheduled = false;
             return;
         }
-        auto fullLength = ring.ReadFromLittleEndian<uint32_t>();
-        const auto length = ring.ReadFromLittleEndian<uint32_t>();
-        (void)length;
-        const auto numStamps = ring.ReadFromLittleEndian<uint32_t>();
-        fullLength -= sizeof(length) + sizeof(numStamps);
-        for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
-            const auto timestamp = ring.ReadFromLittleEndian<uint64_t>();
-            const auto numSamples = ring.ReadFromLittleEndian<uint32_t>();
-            fullLength -= sizeof(timestamp) + sizeof(numSamples);
-            for (uint32_t sample = 0; sample < numSamples; ++sample) {
-                const auto hNotify = ring.ReadFromLittleEndian<uint32_t>();
-                const auto size = ring.ReadFromLittleEndian<uint32_t>();
-                fullLength -= sizeof(hNotify) + sizeof(size);
-                const auto notification = Find(hNotify);
-                if (notification) {
-                    if (size != notification->Size()) {
-                        LOG_WARN("Notification sample size: " << size << " doesn't match: " << notification->Size());
-                        goto cleanup;
-                    }
-                    notification->Notify(timestamp, ring);
-                } else {
-                    ring.Read(size);
+        dispatching.swap(pending);
+        begin = pendingBegin;
+        pendingBegin = 0;
+        busy = true;
+    }
+    drained.notify_all();
+
+    uint32_t length;
+    for (size_t pos = begin; pos + sizeof(length) <= dispatching.size(); pos += length) {
+        memcpy(&length, dispatching.data() + pos, sizeof(length));
+        pos += sizeof(length);
+        DispatchFrame(dispatching.data() + pos, length, &aligned);
+    }
+    Reclaim();
+
+    if (dispatching.capacity() > MAX_IDLE_CAPACITY) {
+        std::vector<uint8_t>().swap(dispatching);
+    } else {
+        dispatching.clear();
+    }
+    if (aligned.capacity() * sizeof(uint64_t) > MAX_IDLE_CAPACITY) {
+        std::vector<uint64_t>().swap(aligned);
+    }
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    busy = false;
+    if (pool) {
+        if (pending.size() == pendingBegin) {
+            scheduled = false;
+        } else {
+            /* requeue instead of looping, so a busy dispatcher doesn't starve the others */
+            pool->Schedule(shared_from_this());
+        }
+    }
+}
+
+void NotificationDispatcher::DispatchFrame(uint8_t* const frame, const uint32_t length,
+                                           std::vector<uint64_t>* const aligned)
+{
+    const auto handles = lookup.load(std::memory_order_acquire);
+    const auto end = frame + length;
+    auto pos = frame;
+    auto available = [&](size_t n) {
+        return static_cast<size_t>(end - pos) >= n;
+    };
+
+    if (!available(sizeof(uint32_t) + sizeof(uint32_t))) {
+        LOG_WARN("Notification frame too short: " << length);
+        return;
+    }
+    pos += sizeof(uint32_t);
+    const auto numStamps = bhf::ads::letoh<uint32_t>(pos);
+    pos += sizeof(numStamps);
+    for (uint32_t stamp = 0; stamp < numStamps; ++stamp) {
+        if (!available(sizeof(uint64_t) + sizeof(uint32_t))) {
+            LOG_WARN("Notification frame truncated");
+            return;
+        }
+        const auto timestamp = bhf::ads::letoh<uint64_t>(pos);
+        pos += sizeof(timestamp);
+        const auto numSamples = bhf::ads::letoh<uint32_t>(pos);
+        pos += sizeof(numSamples);
+        for (uint32_t sample = 0; sample < numSamples; ++sample) {
+            if (!available(sizeof(uint32_t) + sizeof(uint32_t))) {
+                LOG_WARN("Notification frame truncated");
+                return;
+            }
+            const auto hNotify = bhf::ads::letoh<uint32_t>(pos);
+            pos += sizeof(hNotify);
+            const auto size = bhf::ads::letoh<uint32_t>(pos);
+            pos += sizeof(size);
+            if (!available(size)) {
+                LOG_WARN("Notification sample size: " << size << " exceeds frame");
+                return;
+            }
+            /* Notify() overwrites hNotify, size and the bytes before them with the header */
+            const auto notification = handles->Find(hNotify);
+            if (notification) {
+                if (size != notification->Size()) {
+                    LOG_WARN("Notification sample size: " << size << " doesn't match: " << notification->Size());
+                    return;
                 }
-                fullLength -= size;
+                notification->Notify(timestamp, pos, aligned);
+            }
+            pos += size;
+        }
+    }
+}
+
+NotificationPool::NotificationPool(const size_t numThreads)
+    : stop(false)
+{
+    try {
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back(&NotificationPool::Run, this);
+        }
+    } catch (...) {
+        Stop();
+        throw;
+    }
+}
+
+NotificationPool::~NotificationPool()
+{
+    Stop();
+}
+
+void NotificationPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void NotificationPool::Schedule(SharedDispatcher dispatcher)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(std::move(dispatcher));
+    }
+    cv.notify_one();
+}
+
+void NotificationPool::Run()
+{
+    for ( ; ; ) {
+        SharedDispatcher dispatcher;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() {
+                return stop || !ready.empty();
+            });
+            if (stop) {
+                return;
             }
+            dispatcher = std::move(ready.front());
+            ready.pop_front();
         }
-cleanup:
-        ring.Read(fullLength);
+        dispatcher->Dispatch();
     }
 }
@@ -7,6 +7,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace bhf
 {
@@ -19,7 +20,7 @@ inline T letoh(const void* buffer)
     const auto bytes = reinterpret_cast<const uint8_t*>(buffer);
     T result = 0;
     for (size_t i = 0; i < sizeof(T); ++i) {
-        result += (bytes[i] << (8 * i));
+        result |= static_cast<T>(static_cast<T>(bytes[i]) << (8 * i));
     }
     return result;
 }
@@ -42,5 +43,104 @@ T htole(const T value)
 {
     return letoh(value);
 }
+
+inline uint8_t ByteSwap(const uint8_t value)
+{
+    return value;
+}
+
+#if defined(__GNUC__)
+inline uint16_t ByteSwap(const uint16_t value)
+{
+    return __builtin_bswap16(value);
+}
+
+inline uint32_t ByteSwap(const uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+inline uint64_t ByteSwap(const uint64_t value)
+{
+    return __builtin_bswap64(value);
+}
+#else
+inline uint16_t ByteSwap(const uint16_t value)
+{
+    return static_cast<uint16_t>((value << 8) | (value >> 8));
+}
+
+inline uint32_t ByteSwap(const uint32_t value)
+{
+    return (value << 24) | ((value << 8) & 0xFF0000) | ((value >> 8) & 0xFF00) | (value >> 24);
+}
+
+inline uint64_t ByteSwap(const uint64_t value)
+{
+    return (static_cast<uint64_t>(ByteSwap(static_cast<uint32_t>(value))) << 32) |
+           ByteSwap(static_cast<uint32_t>(value >> 32));
+}
+#endif
+
+template<size_t N>
+struct UnsignedOfSize;
+template<>
+struct UnsignedOfSize<1> { using type = uint8_t; };
+template<>
+struct UnsignedOfSize<2> { using type = uint16_t; };
+template<>
+struct UnsignedOfSize<4> { using type = uint32_t; };
+template<>
+struct UnsignedOfSize<8> { using type = uint64_t; };
+
+/**
+ * Reverse the byte order of count values of src into dst, which may be the same, but
+ * mustn't overlap otherwise. Works for floating point types, too. The loop contains
+ * no branches and no aliasing, so compilers vectorize it for large arrays.
+ */
+template<class T>
+inline void SwapBytes(T* dst, const void* src, const size_t count)
+{
+    using Bits = typename UnsignedOfSize<sizeof(T)>::type;
+    const auto in = static_cast<const uint8_t*>(src);
+    auto out = reinterpret_cast<uint8_t*>(dst);
+    for (size_t i = 0; i < count; ++i) {
+        Bits bits;
+        memcpy(&bits, in + i * sizeof(T), sizeof(T));
+        bits = ByteSwap(bits);
+        memcpy(out + i * sizeof(T), &bits, sizeof(T));
+    }
+}
+
+constexpr bool IsBigEndian()
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** convert count little endian values of src (possibly unaligned) into host byte order */
+template<class T>
+inline void letoh(T* dst, const void* src, const size_t count)
+{
+    if (IsBigEndian()) {
+        SwapBytes(dst, src, count);
+    } else if (dst != src) {
+        memcpy(dst, src, count * sizeof(T));
+    }
+}
+
+/** convert count values of src into little endian at dst (possibly unaligned) */
+template<class T>
+inline void htole(void* dst, const T* src, const size_t count)
+{
+    if (IsBigEndian()) {
+        SwapBytes(static_cast<T*>(dst), src, count);
+    } else if (dst != src) {
+        memcpy(dst, src, count * sizeof(T));
+    }
+}
 }
 }
@@ -31,6 +31,9 @@
 #include <netdb.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
 typedef int SOCKET;
 #define INVALID_SOCKET ((int)-1)
@@ -41,6 +44,13 @@ typedef int SOCKET;
 #define WSAENOTSOCK EBADF
 #define CONNECTION_CLOSED ENOTCONN
 #define CONNECTION_ABORTED ECONNABORTED
+#define CONNECT_IN_PROGRESS EINPROGRESS
+#define CONNECT_TIMEDOUT ETIMEDOUT
+#ifdef IOV_MAX
+#define MAX_IOV IOV_MAX
+#else
+#define MAX_IOV 1024
+#endif
 inline int InitSocketLibrary(void)
 {
     return 0;
@@ -65,4 +75,6 @@ typedef int socklen_t;
 #define SHUT_RDWR SD_BOTH
 #define CONNECTION_CLOSED WSAESHUTDOWN
 #define CONNECTION_ABORTED WSAECONNABORTED
+#define CONNECT_IN_PROGRESS WSAEWOULDBLOCK
+#define CONNECT_TIMEDOUT WSAETIMEDOUT
 #endif
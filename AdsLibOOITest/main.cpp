@@ -6,6 +6,8 @@
 
 #include <array>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 #include <thread>
@@ -15,6 +17,25 @@ using namespace fructose;
 
 static const AmsNetId serverNetId {192, 168, 0, 231, 1, 1};
 
+struct LibVersion {
+    uint16_t iMajor;
+    uint16_t iMinor;
+    uint16_t iBuild;
+    uint16_t iRevision;
+    uint32_t nFlags;
+    char sVersion[24];
+};
+
+template<>
+struct AdsLayout<LibVersion> {
+    using Fields = AdsFields<ADS_FIELD(LibVersion, iMajor),
+                             ADS_FIELD(LibVersion, iMinor),
+                             ADS_FIELD(LibVersion, iBuild),
+                             ADS_FIELD(LibVersion, iRevision),
+                             ADS_FIELD(LibVersion, nFlags),
+                             ADS_FIELD(LibVersion, sVersion)>;
+};
+
 static size_t g_NumNotifications = 0;
 static void NotifyCallback(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification, uint32_t hUser)
 {
@@ -270,6 +291,427 @@ struct TestAds : test_base<TestAds> {
         }
     }
 
+    void testAdsGetHandles(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        std::vector<long> errors;
+        auto handles = route.GetHandles({"MAIN.byByte", "xxx", "MAIN.moreBytes"}, &errors);
+        fructose_assert(3 == handles.size());
+        fructose_assert(3 == errors.size());
+        fructose_assert(0 == errors[0]);
+        fructose_assert(!!handles[0]);
+        fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND == errors[1]);
+        fructose_assert(!handles[1]);
+        fructose_assert(0 == errors[2]);
+        fructose_assert(!!handles[2]);
+
+        uint32_t value = 0;
+        uint32_t bytesRead = 0;
+        fructose_assert(0 == route.ReadReqEx2(ADSIGRP_SYM_VALBYHND, *handles[0], sizeof(value), &value, &bytesRead));
+        fructose_assert(sizeof(value) == bytesRead);
+
+        // release in bulk, other handles are released as usual
+        handles.push_back(route.GetHandle(0x4020));
+        fructose_assert(0 == route.ReleaseHandles(handles));
+        for (const auto& handle : handles) {
+            fructose_assert(!handle);
+        }
+
+        // provide invalid symbolName without errors
+        try {
+            route.GetHandles({"MAIN.byByte", "xxx"});
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND == ex.errorCode);
+        }
+    }
+
+    void testAdsSharedHandle(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const auto handle = route.GetSharedHandle("MAIN.byByte");
+        fructose_assert(handle == route.GetSharedHandle("MAIN.byByte"));
+        fructose_assert(handle == route.GetSharedHandle("main.bybyte"));
+        fructose_assert(handle != route.GetSharedHandle("MAIN.moreBytes"));
+
+        // variables with the same name share one handle
+        const AdsVariable<uint32_t> first {route, "MAIN.byByte"};
+        const AdsVariable<uint32_t> second {route, "MAIN.byByte"};
+        first = 0xDEADBEEF;
+        fructose_assert(0xDEADBEEF == second);
+
+        // invalidated handles are acquired again on their next use
+        handle->Invalidate();
+        fructose_assert(0xDEADBEEF == second);
+        first = 0;
+        fructose_assert(0 == second);
+    }
+
+    void testAdsSharedHandleOutlivesDevice(const std::string&)
+    {
+        // the cache keeps working, after its device was moved
+        std::shared_ptr<AdsSharedHandle> orphan;
+        {
+            AdsDevice original {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+            orphan = original.GetSharedHandle("MAIN.byByte");
+            const AdsDevice moved {std::move(original)};
+            orphan->Invalidate();
+            fructose_assert(moved.GetSharedHandle("MAIN.byByte")->Get() == orphan->Get());
+        }
+
+        // the only device of the target is gone, but its route stays until the last handle is released
+        orphan->Invalidate();
+        fructose_assert(0 != orphan->Get());
+        fructose_assert(1028 == orphan->Size());
+        orphan.reset();
+
+        // the route was deleted together with the handle and can be added again
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        fructose_assert(0 != route.GetSharedHandle("MAIN.byByte")->Get());
+    }
+
+    void testAdsSharedHandleSymbolVersion(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const AdsVariable<uint32_t> variable {route, "MAIN.byByte"};
+        const auto handle = route.GetSharedHandle("MAIN.byByte");
+        variable = 0xDEADBEEF;
+        uint8_t symbolVersion = 0;
+        uint32_t bytesRead = 0;
+        fructose_assert(0 == route.ReadReqEx2(ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion,
+                                              &bytesRead));
+
+        // handles became invalid, before a new symbol version was notified: the request is retried
+        auto previous = handle->Get();
+        fructose_assert(0 == route.WriteReqEx(ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion));
+        fructose_assert(0xDEADBEEF == variable);
+        fructose_assert(previous != handle->Get());
+
+        // a notified symbol version replaces the handles without a failed request
+        previous = handle->Get();
+        ++symbolVersion;
+        fructose_assert(0 == route.WriteReqEx(ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion));
+        const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ((previous == handle->Get()) && (std::chrono::steady_clock::now() < timeout)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        fructose_assert(previous != handle->Get());
+        fructose_assert(0xDEADBEEF == variable);
+        variable = 0;
+    }
+
+    void testAdsSymbolTable(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const AdsSymbolTable symbols {route};
+        fructose_assert(symbols.NumSymbols() > 0);
+        fructose_assert(symbols.NumDataTypes() > 0);
+
+        // names are compared case insensitive
+        AdsSymbol symbol;
+        fructose_assert(symbols.Find("main.BYBYTE", symbol));
+        fructose_assert(std::string("MAIN.byByte") == symbol.name);
+        fructose_assert(std::string("ARRAY [0..1027] OF BYTE") == symbol.type);
+        fructose_assert(0x4020 == symbol.indexGroup);
+        fructose_assert(0 == symbol.indexOffset);
+        fructose_assert(1028 == symbol.size);
+
+        AdsDataType array;
+        fructose_assert(symbols.FindType(symbol.type, array));
+        fructose_assert(std::string("BYTE") == array.type);
+        fructose_assert(1 == array.dimensions.size());
+        fructose_assert(0 == array.dimensions[0].lBound);
+        fructose_assert(1028 == array.dimensions[0].elements);
+
+        AdsDataType version;
+        fructose_assert(symbols.FindType("ST_LibVersion", version));
+        fructose_assert(6 == version.fields.size());
+        fructose_assert(std::string("sVersion") == version.fields[5].name);
+        fructose_assert(12 == version.fields[5].offset);
+        fructose_assert(24 == version.fields[5].size);
+
+        // reads by location return the same data as reads by handle
+        const AdsVariable<uint32_t> byName {route, "MAIN.byByte"};
+        const AdsVariable<uint32_t> byLocation {route, symbols.Get("MAIN.byByte")};
+        byName = 0xDEADBEEF;
+        fructose_assert(0xDEADBEEF == byLocation);
+        byName = 0;
+
+        // provide unknown names
+        fructose_assert(!symbols.Find("xxx", symbol));
+        fructose_assert(!symbols.FindType("xxx", version));
+        try {
+            symbols.Get("xxx");
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND == ex.errorCode);
+        }
+    }
+
+    void testAdsSymbolTableCache(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const std::string cacheFile {"AdsLibOOITest.symbols"};
+        std::remove(cacheFile.c_str());
+
+        // first construction uploads the tables and writes the cache
+        AdsSymbol uploaded;
+        std::string uploadedName;
+        std::string uploadedType;
+        {
+            const AdsSymbolTable symbols {route, cacheFile};
+            fructose_assert(!symbols.FromCache());
+            fructose_assert(symbols.Find("MAIN.byByte", uploaded));
+
+            // the strings belong to the table
+            uploadedName = uploaded.name;
+            uploadedType = uploaded.type;
+        }
+
+        // as long as the symbol version doesn't change, the cache is reused
+        {
+            const AdsSymbolTable symbols {route, cacheFile};
+            fructose_assert(symbols.FromCache());
+            const auto symbol = symbols.Get("main.bybyte");
+            fructose_assert(uploadedName == symbol.name);
+            fructose_assert(uploadedType == symbol.type);
+            fructose_assert(uploaded.indexGroup == symbol.indexGroup);
+            fructose_assert(uploaded.indexOffset == symbol.indexOffset);
+            fructose_assert(uploaded.size == symbol.size);
+            AdsDataType version;
+            fructose_assert(symbols.FindType("ST_LibVersion", version));
+            fructose_assert(6 == version.fields.size());
+        }
+
+        // a corrupted cache is replaced
+        {
+            std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+            file << "garbage";
+        }
+        {
+            const AdsSymbolTable symbols {route, cacheFile};
+            fructose_assert(!symbols.FromCache());
+            fructose_assert(symbols.Find("MAIN.byByte", uploaded));
+        }
+        fructose_assert(AdsSymbolTable(route, cacheFile).FromCache());
+
+        // a fully occupied index would let lookups of unknown names loop forever
+        size_t numSlots = 1;
+        while (numSlots < 2 * AdsSymbolTable(route, cacheFile).NumSymbols()) {
+            numSlots *= 2;
+        }
+        {
+            std::fstream file(cacheFile, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-static_cast<std::streamoff>(numSlots * sizeof(uint32_t)), std::ios::end);
+            const uint32_t firstSymbol = 1;
+            for (size_t i = 0; i < numSlots; ++i) {
+                file.write(reinterpret_cast<const char*>(&firstSymbol), sizeof(firstSymbol));
+            }
+        }
+        {
+            const AdsSymbolTable symbols {route, cacheFile};
+            fructose_assert(!symbols.FromCache());
+            AdsSymbol symbol;
+            fructose_assert(!symbols.Find("xxx", symbol));
+        }
+
+        // index entries beyond the symbols are rejected, too
+        {
+            std::fstream file(cacheFile, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(-static_cast<std::streamoff>(sizeof(uint32_t)), std::ios::end);
+            const uint32_t outOfRange = 0xFFFFFFFF;
+            file.write(reinterpret_cast<const char*>(&outOfRange), sizeof(outOfRange));
+        }
+        fructose_assert(!AdsSymbolTable(route, cacheFile).FromCache());
+        fructose_assert(AdsSymbolTable(route, cacheFile).FromCache());
+
+        // a new symbol version, e.g. after an online change, invalidates the cache
+        uint8_t symbolVersion = 0;
+        uint32_t bytesRead = 0;
+        fructose_assert(0 == route.ReadReqEx2(ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion,
+                                              &bytesRead));
+        ++symbolVersion;
+        fructose_assert(0 == route.WriteReqEx(ADSIGRP_SYM_VERSION, 0, sizeof(symbolVersion), &symbolVersion));
+        fructose_assert(!AdsSymbolTable(route, cacheFile).FromCache());
+        fructose_assert(AdsSymbolTable(route, cacheFile).FromCache());
+        std::remove(cacheFile.c_str());
+    }
+
+    void testAdsDecodePlan(const std::string&)
+    {
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const AdsSymbolTable symbols {route};
+
+        const AdsDecodePlan version {symbols, "ST_LibVersion"};
+        fructose_assert(36 == version.Size());
+        fructose_assert(6 == version.NumSlots());
+        fructose_assert(AdsValueKind::UNSIGNED == version.Field("iMinor").kind);
+        fructose_assert(1 == version.Field("iMinor").slot);
+        fructose_assert(AdsValueKind::STRING == version.Field("sversion").kind);
+        fructose_assert(12 == version.Field("sVersion").offset);
+
+        // arrays of structures are decoded in bulk
+        std::array<uint8_t, 72> data {};
+        data[2] = 0x34;
+        data[3] = 0x12;
+        data[36 + 8] = 0xFF;
+        data[36 + 11] = 0x80;
+        data[36 + 12] = 'x';
+        std::array<AdsValue, 12> values;
+        version.Decode(data.data(), data.size(), values.data(), 2);
+        fructose_assert(0x1234 == values[1].u);
+        fructose_assert(0x800000FF == values[6 + 4].u);
+        fructose_assert(std::string("x") == reinterpret_cast<const char*>(values[6 + 5].bytes.data));
+        fructose_assert(24 == values[6 + 5].bytes.length);
+        try {
+            version.Decode(data.data(), data.size() - 1, values.data(), 2);
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_INVALIDSIZE == ex.errorCode);
+        }
+
+        // notification samples
+        std::array<uint8_t, sizeof(AdsNotificationHeader) + 36> sample {};
+        reinterpret_cast<AdsNotificationHeader*>(sample.data())->cbSampleSize = 36;
+        sample[sizeof(AdsNotificationHeader)] = 7;
+        fructose_assert(1 == version.Decode(*reinterpret_cast<const AdsNotificationHeader*>(sample.data()),
+                                            values.data(), values.size() / version.NumSlots()));
+        fructose_assert(7 == values[0].u);
+
+        // arrays of primitives are a single field
+        const AdsDecodePlan bytes {symbols, "ARRAY [0..1027] OF BYTE"};
+        fructose_assert(1 == bytes.Fields().size());
+        fructose_assert(1028 == bytes.NumSlots());
+        fructose_assert(1028 == bytes.Field("").count);
+
+        // the element of an array of structures is compiled once for all elements
+        const AdsDecodePlan task {symbols, "PlcTaskSystemInfo"};
+        const AdsDecodePlan tasks {symbols, "ARRAY [1..1] OF PlcTaskSystemInfo"};
+        fructose_assert(task.Fields().size() == tasks.Fields().size());
+        fructose_assert(task.NumSlots() == tasks.NumSlots());
+        const auto dcTaskTime = tasks.Field("[1].DcTaskTime");
+        fructose_assert(std::string("[].DcTaskTime") == dcTaskTime.path);
+        fructose_assert(AdsValueKind::SIGNED == dcTaskTime.kind);
+        fructose_assert(8 == dcTaskTime.width);
+        fructose_assert(task.Field("DcTaskTime").offset == dcTaskTime.offset);
+        fructose_assert(task.Field("DcTaskTime").slot == dcTaskTime.slot);
+        fructose_assert(1 == dcTaskTime.arrays.size());
+        fructose_assert(task.Size() == dcTaskTime.arrays[0].stride);
+        fructose_assert(task.NumSlots() == dcTaskTime.arrays[0].slotStride);
+        fructose_assert(AdsValueKind::STRING == tasks.Field("[1].TaskName").kind);
+        try {
+            tasks.Field("[2].DcTaskTime");
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND == ex.errorCode);
+        }
+
+        // repeating the element gives the same values as decoding the elements on their own
+        std::vector<uint8_t> taskData(2 * task.Size());
+        for (size_t i = 0; i < taskData.size(); ++i) {
+            taskData[i] = static_cast<uint8_t>(i * 7);
+        }
+        std::vector<AdsValue> expected(2 * task.NumSlots());
+        std::vector<AdsValue> repeated(expected.size());
+        task.Decode(taskData.data(), taskData.size(), expected.data(), 2);
+        tasks.Decode(taskData.data(), taskData.size(), repeated.data(), 2);
+        for (const auto& field : task.Fields()) {
+            for (size_t e = 0; e < 2; ++e) {
+                const auto slot = e * task.NumSlots() + field.slot;
+                const bool numeric = (AdsValueKind::SIGNED == field.kind) || (AdsValueKind::UNSIGNED == field.kind) ||
+                                     (AdsValueKind::FLOAT == field.kind);
+                if (numeric) {
+                    fructose_loop_assert(slot, expected[slot].u == repeated[slot].u);
+                } else {
+                    fructose_loop_assert(slot, expected[slot].bytes.data == repeated[slot].bytes.data);
+                }
+            }
+        }
+
+        // read through AdsVariable
+        const AdsVariable<uint32_t> variable {route, "MAIN.byByte"};
+        variable = 0x5678;
+        std::vector<uint8_t> buffer;
+        std::vector<AdsValue> elements(version.NumSlots());
+        variable.Read(version, buffer, elements.data());
+        fructose_assert(0x5678 == elements[0].u);
+        variable = 0;
+
+        try {
+            AdsDecodePlan {symbols, "xxx"};
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_SYMBOLNOTFOUND == ex.errorCode);
+        }
+    }
+
+    void testAdsLayout(const std::string&)
+    {
+        static_assert(36 == AdsCodec<LibVersion>::Size(), "packed size of ST_LibVersion");
+        static_assert(72 == AdsCodec<std::array<LibVersion, 2> >::Size(), "packed size of an array of ST_LibVersion");
+
+        // conversion from and to the little endian PLC representation
+        std::array<uint8_t, AdsCodec<LibVersion>::Size()> data {{0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00,
+                                                                 0x78, 0x56, 0x34, 0x12}};
+        for (size_t i = 12; i < data.size(); ++i) {
+            data[i] = 'a' + i - 12;
+        }
+        LibVersion version {};
+        AdsCodec<LibVersion>::Decode(data.data(), version);
+        fructose_assert(1 == version.iMajor);
+        fructose_assert(2 == version.iMinor);
+        fructose_assert(3 == version.iBuild);
+        fructose_assert(4 == version.iRevision);
+        fructose_assert(0x12345678 == version.nFlags);
+        fructose_assert(std::equal(data.begin() + 12, data.end(), version.sVersion));
+        std::array<uint8_t, AdsCodec<LibVersion>::Size()> encoded {};
+        AdsCodec<LibVersion>::Encode(version, encoded.data());
+        fructose_assert(data == encoded);
+
+        // bulk byte swapping
+        std::array<uint32_t, 33> values;
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = 0x11223344 + i;
+        }
+        bhf::ads::SwapBytes(values.data(), values.data(), values.size());
+        fructose_assert(0x44332211 == values[0]);
+        fructose_assert(0x64332211 == values[32]);
+        const std::array<double, 3> reals {{1.5, -2.25, 1e300}};
+        std::array<double, 3> swapped;
+        bhf::ads::SwapBytes(swapped.data(), reals.data(), reals.size());
+        bhf::ads::SwapBytes(swapped.data(), swapped.data(), swapped.size());
+        fructose_assert(reals == swapped);
+
+        // the packed layout is validated against the PLC symbol
+        AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
+        const AdsVariable<LibVersion> libVersion {route, "Global_Version.stLibVersion_Tc2_System"};
+        const LibVersion current = libVersion;
+        fructose_assert(current.iMajor < 100);
+        /* the second variable reuses the handle and the size of the first one */
+        const AdsVariable<LibVersion> sameVersion {route, "Global_Version.stLibVersion_Tc2_System"};
+        const LibVersion same = sameVersion;
+        fructose_assert(current.iMajor == same.iMajor);
+        try {
+            AdsVariable<LibVersion> invalid {route, "MAIN.byByte"};
+            fructose_assert(false);
+        } catch (const AdsException& ex) {
+            fructose_assert(ADSERR_DEVICE_INVALIDSIZE == ex.errorCode);
+        }
+
+        // structures are written field by field
+        const AdsVariable<LibVersion> byLocation {route, 0x4020, 0};
+        version.sVersion[0] = 'v';
+        byLocation = version;
+        const AdsVariable<uint16_t> header {route, 0x4020, 0};
+        const std::array<uint16_t, 2> minor = header;
+        fructose_assert(1 == minor[0]);
+        fructose_assert(2 == minor[1]);
+        const LibVersion readBack = byLocation;
+        fructose_assert(0x12345678 == readBack.nFlags);
+        fructose_assert('v' == readBack.sVersion[0]);
+        byLocation = LibVersion {};
+    }
+
     void testAdsWriteReqEx(const std::string&)
     {
         AdsDevice route {"ads-server", serverNetId, AMSPORT_R0_PLC_TC3};
@@ -588,6 +1030,14 @@ int main()
     adsTest.add_test("testAdsReadDeviceInfoReqEx", &TestAds::testAdsReadDeviceInfoReqEx);
     adsTest.add_test("testAdsReadStateReqEx", &TestAds::testAdsReadStateReqEx);
     adsTest.add_test("testAdsReadWriteReqEx2", &TestAds::testAdsReadWriteReqEx2);
+    adsTest.add_test("testAdsGetHandles", &TestAds::testAdsGetHandles);
+    adsTest.add_test("testAdsSharedHandle", &TestAds::testAdsSharedHandle);
+    adsTest.add_test("testAdsSharedHandleOutlivesDevice", &TestAds::testAdsSharedHandleOutlivesDevice);
+    adsTest.add_test("testAdsSharedHandleSymbolVersion", &TestAds::testAdsSharedHandleSymbolVersion);
+    adsTest.add_test("testAdsSymbolTable", &TestAds::testAdsSymbolTable);
+    adsTest.add_test("testAdsSymbolTableCache", &TestAds::testAdsSymbolTableCache);
+    adsTest.add_test("testAdsDecodePlan", &TestAds::testAdsDecodePlan);
+    adsTest.add_test("testAdsLayout", &TestAds::testAdsLayout);
     adsTest.add_test("testAdsWriteReqEx", &TestAds::testAdsWriteReqEx);
     adsTest.add_test("testAdsWriteControlReqEx", &TestAds::testAdsWriteControlReqEx);
     adsTest.add_test("testAdsNotification", &TestAds::testAdsNotification);
@@ -6,9 +6,16 @@
 #include <AdsLib.h>
 
 #include "AmsRouter.h"
+#include "MirrorRingBuffer.h"
+#include "RingBuffer.h"
 
+#include <algorithm>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#if defined(__linux__)
+#include <dirent.h>
+#endif
 
 #include <fructose/fructose.h>
 using namespace fructose;
@@ -86,6 +93,310 @@ struct TestAmsAddr : test_base<TestAmsAddr> {
     }
 };
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Closes the wrapped socket, when it goes out of scope.
+ */
+struct ScopedSocket {
+    explicit ScopedSocket(SOCKET s)
+        : sock(s)
+    {}
+
+    ~ScopedSocket()
+    {
+        if (INVALID_SOCKET != sock) {
+            closesocket(sock);
+        }
+    }
+
+    ScopedSocket(const ScopedSocket&) = delete;
+    ScopedSocket& operator=(const ScopedSocket&) = delete;
+
+    const SOCKET sock;
+};
+
+/**
+ * Minimal AMS server on a loopback address and an ephemeral port, which answers
+ * every request successfully and returns zeros for reads. It is used to measure
+ * the latency of AdsLib itself without a PLC in the loop. Point a route to it by
+ * setting SocketOptions::serverPort to Port(). Notifications are only sent on
+ * demand, see Notify().
+ */
+struct LoopbackResponder {
+    LoopbackResponder(const char* ip)
+        : listener(socket(AF_INET, SOCK_STREAM, 0)),
+        port(0),
+        paused(false),
+        announcedLength(0),
+        rejectSum(false)
+    {
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = 0;
+        addr.sin_addr.s_addr = htonl(IpV4 {ip}.value);
+        socklen_t len = sizeof(addr);
+        if ((INVALID_SOCKET == listener.sock) ||
+            bind(listener.sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+            listen(listener.sock, 8) ||
+            getsockname(listener.sock, reinterpret_cast<sockaddr*>(&addr), &len)) {
+            throw std::runtime_error("LoopbackResponder failed to listen on " + std::string(ip));
+        }
+        port = ntohs(addr.sin_port);
+        /* a fixed receive window, so Pause() blocks writers early instead of buffering megabytes */
+        const int windowSize = 64 * 1024;
+        setsockopt(listener.sock, SOL_SOCKET, SO_RCVBUF, (const char*)&windowSize, sizeof(windowSize));
+        acceptor = std::thread(&LoopbackResponder::Accept, this);
+    }
+
+    ~LoopbackResponder()
+    {
+        Resume();
+        shutdown(listener.sock, SHUT_RDWR);
+        acceptor.join();
+        for (auto& client : clients) {
+            shutdown(client->sock, SHUT_RDWR);
+        }
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    uint16_t Port() const
+    {
+        return port;
+    }
+
+    /**
+     * Stop reading requests, so the socket buffers of the client fill up. Connections,
+     * which are already waiting for a request, will still serve the next one.
+     */
+    void Pause()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = true;
+    }
+
+    void Resume()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = false;
+        resumed.notify_all();
+    }
+
+    /** announce length in the AMS/TCP header of all following responses instead of their real length */
+    void Corrupt(const uint32_t length)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        announcedLength = length;
+    }
+
+    /** answer all ADSIGRP_SUMUP_* requests with ADSERR_DEVICE_SRVNOTSUPP like older runtimes do */
+    void RejectSumCommands()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rejectSum = true;
+    }
+
+    /** number of requests served by each connection in the order they were accepted */
+    std::vector<size_t> Served()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return served;
+    }
+
+    /**
+     * Send one notification frame with numSamples samples of sampleSize bytes to the client,
+     * which added hNotify. Every byte of the samples is set to the low byte of hNotify.
+     * @return false, if hNotify is unknown or the frame couldn't be sent
+     */
+    bool Notify(const uint32_t hNotify, const uint32_t sampleSize, const uint32_t numSamples)
+    {
+        Subscription subscription;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!hNotify || (hNotify > subscriptions.size())) {
+                return false;
+            }
+            subscription = subscriptions[hNotify - 1];
+        }
+
+        /* length, number of stamps and one stamp with its timestamp, number of samples and the samples */
+        const uint32_t length = 2 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) +
+                                numSamples * (2 * sizeof(uint32_t) + sampleSize);
+        std::vector<uint8_t> frame(sizeof(AmsTcpHeader) + sizeof(AoEHeader) + length, static_cast<uint8_t>(hNotify));
+        const AmsTcpHeader tcpHeader { static_cast<uint32_t>(sizeof(AoEHeader) + length) };
+        const AoEHeader aoe {
+            subscription.client.netId, subscription.client.port,
+            subscription.server.netId, subscription.server.port,
+            AoEHeader::DEVICE_NOTIFICATION, length, 0
+        };
+        auto pos = frame.data();
+        memcpy(pos, &tcpHeader, sizeof(tcpHeader));
+        pos += sizeof(tcpHeader);
+        memcpy(pos, &aoe, sizeof(aoe));
+        pos += sizeof(aoe);
+        auto put = [&pos](const uint32_t value) {
+                       const auto le = bhf::ads::htole(value);
+                       memcpy(pos, &le, sizeof(le));
+                       pos += sizeof(le);
+                   };
+        put(length - sizeof(uint32_t));
+        put(1);
+        put(0);
+        put(0);
+        put(numSamples);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            put(hNotify);
+            put(sampleSize);
+            pos += sampleSize;
+        }
+
+        std::lock_guard<std::mutex> lock(sending);
+        return frame.size() ==
+               (size_t)send(subscription.sock, reinterpret_cast<const char*>(frame.data()), frame.size(), MSG_NOSIGNAL);
+    }
+
+private:
+    /** the client of a notification, which Notify() sends its samples to */
+    struct Subscription {
+        SOCKET sock;
+        AmsAddr client;
+        AmsAddr server;
+    };
+
+    const ScopedSocket listener;
+    uint16_t port;
+    std::mutex mutex;
+    std::condition_variable resumed;
+    bool paused;
+    uint32_t announcedLength;
+    bool rejectSum;
+    std::vector<size_t> served;
+
+    /** hNotify of the notifications added by clients is their index + 1 */
+    std::vector<Subscription> subscriptions;
+
+    /** serializes responses and notifications on the same connection */
+    std::mutex sending;
+    std::thread acceptor;
+    std::vector<std::unique_ptr<ScopedSocket> > clients;
+    std::vector<std::thread> workers;
+
+    void Accept()
+    {
+        for ( ;; ) {
+            const SOCKET client = accept(listener.sock, nullptr, nullptr);
+            if (INVALID_SOCKET == client) {
+                return;
+            }
+            clients.emplace_back(new ScopedSocket {client});
+            const int enable = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                index = served.size();
+                served.push_back(0);
+            }
+            workers.emplace_back(&LoopbackResponder::Serve, this, client, index);
+        }
+    }
+
+    static bool ReadAll(SOCKET sock, uint8_t* buffer, size_t length)
+    {
+        while (length) {
+            const auto n = recv(sock, reinterpret_cast<char*>(buffer), length, 0);
+            if (n <= 0) {
+                return false;
+            }
+            buffer += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    void WaitWhilePaused()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        resumed.wait(lock, [&]() { return !paused; });
+    }
+
+    void Serve(SOCKET sock, const size_t index)
+    {
+        std::vector<uint8_t> request(sizeof(AmsTcpHeader) + sizeof(AoEHeader));
+        std::vector<uint8_t> response;
+        for ( ;; ) {
+            WaitWhilePaused();
+            if (!ReadAll(sock, request.data(), sizeof(AmsTcpHeader))) {
+                break;
+            }
+            const AmsTcpHeader tcpHeader { request.data() };
+            request.resize(sizeof(AmsTcpHeader) + tcpHeader.length());
+            if ((tcpHeader.length() < sizeof(AoEHeader)) ||
+                !ReadAll(sock, request.data() + sizeof(AmsTcpHeader), tcpHeader.length())) {
+                break;
+            }
+            const AoEHeader aoe { request.data() + sizeof(AmsTcpHeader) };
+            const uint8_t* const payload = request.data() + sizeof(AmsTcpHeader) + sizeof(AoEHeader);
+
+            uint32_t readLength = 0;
+            if ((aoe.cmdId() == AoEHeader::READ) || (aoe.cmdId() == AoEHeader::READ_WRITE)) {
+                readLength = bhf::ads::letoh<uint32_t>(payload + 8);
+            }
+            const bool hasLength = (aoe.cmdId() == AoEHeader::READ) || (aoe.cmdId() == AoEHeader::READ_WRITE);
+            const bool hasHandle = (aoe.cmdId() == AoEHeader::ADD_DEVICE_NOTIFICATION);
+            const uint32_t bodyLength = sizeof(uint32_t) + (hasLength ? sizeof(uint32_t) + readLength : 0) +
+                                        (hasHandle ? sizeof(uint32_t) : 0);
+
+            response.assign(sizeof(AmsTcpHeader) + sizeof(AoEHeader) + bodyLength, 0);
+            const AmsTcpHeader responseTcp { static_cast<uint32_t>(sizeof(AoEHeader) + bodyLength) };
+            const AoEHeader responseAoe {
+                aoe.sourceAddr(), aoe.sourcePort(),
+                aoe.targetAddr(), aoe.targetPort(),
+                aoe.cmdId(), bodyLength, aoe.invokeId()
+            };
+            memcpy(response.data(), &responseTcp, sizeof(responseTcp));
+            memcpy(response.data() + sizeof(responseTcp), &responseAoe, sizeof(responseAoe));
+            /* mark as response, the stateFlags are located behind the cmdId */
+            const auto stateFlags = bhf::ads::htole(AoEHeader::AMS_RESPONSE);
+            memcpy(response.data() + sizeof(responseTcp) + 18, &stateFlags, sizeof(stateFlags));
+            if (hasLength) {
+                const auto length = bhf::ads::htole(readLength);
+                memcpy(response.data() + sizeof(responseTcp) + sizeof(responseAoe) + 4, &length, sizeof(length));
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++served[index];
+                if (announcedLength) {
+                    const AmsTcpHeader corrupt { announcedLength };
+                    memcpy(response.data(), &corrupt, sizeof(corrupt));
+                }
+                const auto group = bhf::ads::letoh<uint32_t>(payload);
+                if (rejectSum && (aoe.cmdId() == AoEHeader::READ_WRITE) &&
+                    (group >= ADSIGRP_SUMUP_READ) && (group <= ADSIGRP_SUMUP_DELDEVNOTE)) {
+                    const auto result = bhf::ads::htole<uint32_t>(ADSERR_DEVICE_SRVNOTSUPP);
+                    memcpy(response.data() + sizeof(responseTcp) + sizeof(responseAoe), &result, sizeof(result));
+                }
+                if (hasHandle) {
+                    subscriptions.push_back(Subscription { sock, aoe.sourceAms(), AmsAddr { aoe.targetAddr(),
+                                                                                           aoe.targetPort() } });
+                    const auto hNotify = bhf::ads::htole<uint32_t>(subscriptions.size());
+                    memcpy(response.data() + sizeof(responseTcp) + sizeof(responseAoe) + 4, &hNotify,
+                           sizeof(hNotify));
+                }
+            }
+            std::lock_guard<std::mutex> lock(sending);
+            if (response.size() !=
+                (size_t)send(sock, reinterpret_cast<const char*>(response.data()), response.size(), MSG_NOSIGNAL)) {
+                break;
+            }
+        }
+    }
+};
+
 struct TestAmsRouter : test_base<TestAmsRouter> {
     std::ostream& out;
 
@@ -151,6 +462,83 @@ struct TestAmsRouter : test_base<TestAmsRouter> {
         fructose_assert(!!testee.GetConnection(netId_2));
     }
 
+    void testAmsRouterAddRoutes(const std::string&)
+    {
+        static const AmsNetId netId_1 { 192, 168, 0, 231, 1, 1 };
+        static const AmsNetId netId_2 { 127, 0, 0, 1, 2, 1 };
+        static const AmsNetId netId_3 { 127, 0, 0, 1, 3, 1 };
+        static const IpV4 ip_local("127.0.0.1");
+        AmsRouter testee;
+
+        fructose_assert(0 == testee.AddRoute(netId_1, ip_local));
+        const auto errors = testee.AddRoutes({ {netId_1, ip_remote}, {netId_2, ip_remote}, {netId_3, ip_remote} },
+                                             SocketOptions {});
+        fructose_assert_eq(3U, errors.size());
+
+        // existent Ams with new Ip is rejected, like with AddRoute()
+        fructose_assert_eq(ROUTERERR_PORTALREADYINUSE, errors[0]);
+        fructose_assert(ip_local == testee.GetConnection(netId_1)->destIp);
+
+        // new Ams with the same Ip share one connection
+        fructose_assert_eq(0, errors[1]);
+        fructose_assert_eq(0, errors[2]);
+        fructose_assert(!!testee.GetConnection(netId_2));
+        fructose_assert(ip_remote == testee.GetConnection(netId_2)->destIp);
+        fructose_assert(testee.GetConnection(netId_2) == testee.GetConnection(netId_3));
+    }
+
+    void testAmsRouterBulkConnections(const std::string&)
+    {
+        static const AmsNetId netId {127, 0, 0, 20, 1, 1};
+        static const AmsNetId sharing {127, 0, 0, 20, 2, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        static const IpV4 ip("127.0.0.20");
+        LoopbackResponder responder {"127.0.0.20"};
+        responder.Pause();
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        AmsRouter testee;
+
+        // routes to the same Ip share their connections, so they have to agree on the number
+        fructose_assert(0 == testee.AddRoute(netId, ip, options, 3));
+        fructose_assert(ROUTERERR_PORTALREADYINUSE == testee.AddRoute(sharing, ip, options, 2));
+        fructose_assert(0 == testee.AddRoute(sharing, ip, options, 3));
+
+        // while the first large read is outstanding, the second one has to pick another connection
+        const auto port = testee.OpenPort();
+        std::vector<uint8_t> buffers[2];
+        std::promise<long> done[2];
+        for (size_t i = 0; i < 2; ++i) {
+            buffers[i].resize(32 * 1024);
+            const auto length = static_cast<uint32_t>(buffers[i].size());
+            std::unique_ptr<AmsRequest> request { new AmsRequest {
+                                                      target, port, AoEHeader::READ,
+                                                      length, buffers[i].data(), nullptr,
+                                                      sizeof(AoERequestHeader)
+                                                  } };
+            request->frame.prepend(AoERequestHeader { 0x4020U, 0U, length });
+            fructose_loop_assert(i, 0 == testee.AdsRequestAsync(std::move(request), [&done, i](long status, uint32_t) {
+                done[i].set_value(status);
+            }));
+        }
+        responder.Resume();
+        fructose_assert(0 == done[0].get_future().get());
+        fructose_assert(0 == done[1].get_future().get());
+
+        // small requests stay on the first connection
+        uint32_t small;
+        AmsRequest request { target, port, AoEHeader::READ, sizeof(small), &small, nullptr, sizeof(AoERequestHeader) };
+        request.frame.prepend(AoERequestHeader { 0x4020U, 0U, static_cast<uint32_t>(sizeof(small)) });
+        fructose_assert(0 == testee.AdsRequest(request));
+
+        const auto served = responder.Served();
+        fructose_assert_eq(3U, served.size());
+        fructose_assert_eq(1U, served[0]);
+        fructose_assert_eq(1U, served[1]);
+        fructose_assert_eq(1U, served[2]);
+        fructose_assert(0 == testee.ClosePort(port));
+    }
+
     void testAmsRouterSetLocalAddress(const std::string&)
     {
         const AmsNetId newNetId {1, 2, 3, 4, 5, 6};
@@ -227,6 +615,139 @@ struct TestIpV4 : test_base<TestIpV4> {
     }
 };
 
+#if defined(__linux__)
+struct TestTcpSocket : test_base<TestTcpSocket> {
+    std::ostream& out;
+
+    TestTcpSocket(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    static size_t NumOpenFiles()
+    {
+        size_t count = 0;
+        const auto dir = opendir("/proc/self/fd");
+        while (readdir(dir)) {
+            ++count;
+        }
+        closedir(dir);
+        return count;
+    }
+
+    void testConnectTimeout(const std::string&)
+    {
+        static const char* const blackhole = "127.0.0.30";
+        static const uint32_t timeout = 200;
+
+        /* the accept queue of the listener holds a single connection, further handshakes are dropped */
+        const ScopedSocket listener {socket(AF_INET, SOCK_STREAM, 0)};
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(IpV4 {blackhole}.value);
+        socklen_t len = sizeof(addr);
+        fructose_assert(0 == bind(listener.sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        fructose_assert(0 == listen(listener.sock, 0));
+        fructose_assert(0 == getsockname(listener.sock, reinterpret_cast<sockaddr*>(&addr), &len));
+        const ScopedSocket queued {socket(AF_INET, SOCK_STREAM, 0)};
+        fructose_assert(0 == connect(queued.sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+
+        SocketOptions options;
+        options.connectTimeout = timeout;
+        options.serverPort = ntohs(addr.sin_port);
+        const auto openFiles = NumOpenFiles();
+        const auto start = std::chrono::steady_clock::now();
+        {
+            TcpSocket blackholed {IpV4 {blackhole}, options.serverPort, options};
+            fructose_assert_exception(blackholed.Connect(), std::system_error);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        fructose_assert(elapsed >= std::chrono::milliseconds(timeout));
+        fructose_assert(elapsed < std::chrono::milliseconds(10 * timeout));
+        fructose_assert_eq(openFiles, NumOpenFiles());
+
+        /* a route to the unreachable target fails without leaving a connection behind */
+        AmsRouter testee;
+        const AmsNetId netId {127, 0, 0, 30, 1, 1};
+        fructose_assert_exception(testee.AddRoute(netId, IpV4 {blackhole}, options), std::runtime_error);
+        fructose_assert(!testee.GetConnection(netId));
+        fructose_assert_eq(openFiles, NumOpenFiles());
+    }
+};
+#endif
+
+struct TestFrame : test_base<TestFrame> {
+    std::ostream& out;
+
+    TestFrame(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    void testFrameInline(const std::string&)
+    {
+        Frame frame {64};
+        const auto begin = reinterpret_cast<const uint8_t*>(&frame);
+        fructose_assert((frame.rawData() >= begin) && (frame.rawData() < begin + sizeof(frame)));
+    }
+
+    struct CacheObservation {
+        size_t initial;
+        size_t afterFirst;
+        bool reused;
+        bool distinct;
+        size_t afterSecond;
+    };
+
+    void testFrameCacheReuse(const std::string&)
+    {
+        /* each thread has its own cache, a fresh one starts empty */
+        const auto observed = std::async(std::launch::async, []() {
+            CacheObservation o;
+            o.initial = Frame::cachedBytes();
+            const uint8_t* first;
+            {
+                Frame frame {1000};
+                first = frame.rawData();
+            }
+            o.afterFirst = Frame::cachedBytes();
+            {
+                Frame smaller {800};
+                Frame concurrent {1000};
+                o.reused = (first == smaller.rawData());
+                o.distinct = (first != concurrent.rawData());
+            }
+            o.afterSecond = Frame::cachedBytes();
+            return o;
+        }).get();
+        fructose_assert_eq(0U, observed.initial);
+        fructose_assert_eq(1000U, observed.afterFirst);
+        fructose_assert(observed.reused);
+        fructose_assert(observed.distinct);
+        fructose_assert_eq(2000U, observed.afterSecond);
+    }
+
+    void testFrameCacheBound(const std::string&)
+    {
+        const auto retained = std::async(std::launch::async, []() {
+            std::vector<size_t> bytes;
+            {
+                Frame huge {1024 * 1024};
+            }
+            bytes.push_back(Frame::cachedBytes());
+            {
+                std::vector<std::unique_ptr<Frame> > frames;
+                for (int i = 0; i < 8; ++i) {
+                    frames.emplace_back(new Frame {64 * 1024});
+                }
+            }
+            bytes.push_back(Frame::cachedBytes());
+            return bytes;
+        }).get();
+        fructose_assert_eq(0U, retained[0]);
+        fructose_assert(retained[1] > 0);
+        fructose_assert(retained[1] <= Frame::MAX_CACHED_BYTES);
+    }
+};
+
 struct TestRingBuffer : test_base<TestRingBuffer> {
     static const int NUM_TEST_LOOPS = 1024;
     std::ostream& out;
@@ -273,6 +794,763 @@ struct TestRingBuffer : test_base<TestRingBuffer> {
             testee.ReadFromLittleEndian<uint8_t>();
         }
     }
+
+    /* every test runs against the double mapping and the copying fallback */
+    void testMirrorBytesFree(const std::string&)
+    {
+        for (const bool map : { true, false }) {
+            MirrorRingBuffer testee { 1, map };
+            const auto capacity = testee.Capacity();
+            fructose_assert(capacity >= 1);
+            fructose_assert(0 == testee.BytesAvailable());
+            fructose_assert(capacity == testee.BytesFree());
+            fructose_assert(capacity == testee.WriteChunk());
+
+            for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+                memset(testee.write, 0xA5, capacity);
+                testee.Write(capacity);
+                fructose_assert(capacity == testee.BytesAvailable());
+                fructose_assert(0 == testee.WriteChunk());
+                testee.Read(capacity - 1);
+                fructose_assert(0xA5 == testee.ReadFromLittleEndian<uint8_t>());
+                fructose_assert(testee.write == testee.read);
+            }
+        }
+        fructose_assert(!MirrorRingBuffer(1, false).Mirrored());
+    }
+
+    void testMirrorContiguous(const std::string&)
+    {
+        for (const bool map : { true, false }) {
+            MirrorRingBuffer testee { 1, map };
+            const auto capacity = testee.Capacity();
+            std::vector<uint8_t> record(capacity / 3 + 7);
+            std::vector<uint8_t> previous;
+
+            /* records are written at varying positions behind the previous one, so many of them wrap around */
+            for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+                for (size_t j = 0; j < record.size(); ++j) {
+                    record[j] = static_cast<uint8_t>(i + j);
+                }
+                fructose_loop_assert(i, record.size() <= testee.WriteChunk());
+                memcpy(testee.write, record.data(), record.size());
+                testee.Write(record.size());
+                if (!previous.empty()) {
+                    fructose_loop_assert(i, !memcmp(testee.read, previous.data(), previous.size()));
+                    testee.Read(previous.size());
+                }
+                fructose_loop_assert(i, !memcmp(testee.read, record.data(), record.size()));
+                previous = record;
+            }
+        }
+    }
+
+    void testMirrorReadFromLittleEndian(const std::string&)
+    {
+        for (const bool map : { true, false }) {
+            MirrorRingBuffer testee { 1, map };
+            const auto capacity = testee.Capacity();
+            testee.Write(capacity - 2);
+            testee.Read(capacity - 2);
+
+            /* the value starts two bytes before the wrap around */
+            const uint8_t value[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08 };
+            memcpy(testee.write, value, sizeof(value));
+            testee.Write(sizeof(value));
+            fructose_assert_eq(0x0807060504030201ULL, testee.ReadFromLittleEndian<uint64_t>());
+            fructose_assert(0 == testee.BytesAvailable());
+
+            /* another value is received in two pieces, split exactly at the wrap around */
+            const uint8_t other[] = { 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18 };
+            testee.Write(capacity - 8);
+            testee.Read(capacity - 8);
+            memcpy(testee.write, other, 2);
+            testee.Write(2);
+            memcpy(testee.write, other + 2, sizeof(other) - 2);
+            testee.Write(sizeof(other) - 2);
+            fructose_assert_eq(0x1817161514131211ULL, testee.ReadFromLittleEndian<uint64_t>());
+            fructose_assert(0 == testee.BytesAvailable());
+
+            /* both values are received at once, the second one is read behind the wrap around */
+            testee.Write(capacity - 10);
+            testee.Read(capacity - 10);
+            memcpy(testee.write, value, sizeof(value));
+            memcpy(testee.write + sizeof(value), other, sizeof(other));
+            testee.Write(sizeof(value) + sizeof(other));
+            fructose_assert_eq(0x0807060504030201ULL, testee.ReadFromLittleEndian<uint64_t>());
+            fructose_assert_eq(0x1817161514131211ULL, testee.ReadFromLittleEndian<uint64_t>());
+            fructose_assert(0 == testee.BytesAvailable());
+        }
+    }
+};
+
+static const uint32_t POOL_HANDLES_PER_DISPATCHER = 4;
+static const uint32_t POOL_DISPATCHERS = 16;
+static const uint32_t POOL_FRAMES = 1000;
+static uint32_t g_PoolLastSample[POOL_DISPATCHERS * POOL_HANDLES_PER_DISPATCHER];
+static std::atomic<size_t> g_PoolReceived(0);
+static std::atomic<size_t> g_PoolOutOfOrder(0);
+static void PoolCallback(const AmsAddr*, const AdsNotificationHeader* pNotification, uint32_t hUser)
+{
+    uint32_t value;
+    memcpy(&value, pNotification + 1, sizeof(value));
+    if (value != g_PoolLastSample[hUser] + 1) {
+        ++g_PoolOutOfOrder;
+    }
+    g_PoolLastSample[hUser] = value;
+    ++g_PoolReceived;
+}
+
+static const uint32_t LOOKUP_HANDLES = 20000;
+static std::atomic<size_t> g_LookupReceived(0);
+static std::atomic<bool> g_LookupWrongHandle(false);
+static void LookupCallback(const AmsAddr*, const AdsNotificationHeader* pNotification, uint32_t hUser)
+{
+    if (pNotification->hNotification != hUser) {
+        g_LookupWrongHandle = true;
+    }
+    ++g_LookupReceived;
+}
+
+struct DirectSample {
+    std::thread::id thread;
+    const uint8_t* data;
+    AdsNotificationHeader header;
+    uint32_t value;
+};
+static std::mutex g_DirectMutex;
+static std::vector<DirectSample> g_DirectSamples;
+static void DirectCallback(const AmsAddr*, const AdsNotificationHeader* pNotification, uint32_t)
+{
+    DirectSample sample;
+    sample.thread = std::this_thread::get_id();
+    sample.data = reinterpret_cast<const uint8_t*>(pNotification + 1);
+    memcpy(&sample.header, pNotification, sizeof(sample.header));
+    memcpy(&sample.value, sample.data, sizeof(sample.value));
+    std::lock_guard<std::mutex> lock(g_DirectMutex);
+    g_DirectSamples.push_back(sample);
+}
+
+/** counts the samples of all notifications, so tests can wait for them instead of sleeping */
+static std::mutex g_CountMutex;
+static std::condition_variable g_CountChanged;
+static size_t g_CountedSamples;
+static void CountingCallback(const AmsAddr*, const AdsNotificationHeader*, uint32_t)
+{
+    std::lock_guard<std::mutex> lock(g_CountMutex);
+    ++g_CountedSamples;
+    g_CountChanged.notify_all();
+}
+
+/** @return false, if less than count samples were counted within five seconds */
+static bool WaitForSamples(const size_t count)
+{
+    std::unique_lock<std::mutex> lock(g_CountMutex);
+    return g_CountChanged.wait_for(lock, std::chrono::seconds(5), [count]() {
+        return g_CountedSamples >= count;
+    });
+}
+
+/** the first callback blocks the dispatcher, until the gate is opened */
+static std::mutex g_GateMutex;
+static std::condition_variable g_GateChanged;
+static bool g_GateOpen;
+static std::vector<uint32_t> g_GateValues;
+static void GateCallback(const AmsAddr*, const AdsNotificationHeader* pNotification, uint32_t)
+{
+    uint32_t value;
+    memcpy(&value, pNotification + 1, sizeof(value));
+    std::unique_lock<std::mutex> lock(g_GateMutex);
+    g_GateValues.push_back(value);
+    g_GateChanged.notify_all();
+    g_GateChanged.wait(lock, []() {
+        return g_GateOpen;
+    });
+}
+
+struct TestNotificationDispatcher : test_base<TestNotificationDispatcher> {
+    std::ostream& out;
+
+    TestNotificationDispatcher(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    static void Append(std::vector<uint8_t>& frame, const void* value, size_t length)
+    {
+        const auto bytes = static_cast<const uint8_t*>(value);
+        frame.insert(frame.end(), bytes, bytes + length);
+    }
+
+    /** one stamp with a sample of every handle of dispatcher d, all carrying value */
+    static std::vector<uint8_t> Frame(uint32_t d, uint32_t value)
+    {
+        return Frame(d * POOL_HANDLES_PER_DISPATCHER, POOL_HANDLES_PER_DISPATCHER, value);
+    }
+
+    /** one stamp with a sample of count consecutive handles starting at first, all carrying value */
+    static std::vector<uint8_t> Frame(uint32_t first, uint32_t count, uint32_t value)
+    {
+        const uint32_t numStamps = 1;
+        const uint64_t timestamp = 132000000000000000ULL;
+        const uint32_t numSamples = count;
+        const uint32_t size = sizeof(value);
+        std::vector<uint8_t> frame(sizeof(uint32_t));
+        Append(frame, &numStamps, sizeof(numStamps));
+        Append(frame, &timestamp, sizeof(timestamp));
+        Append(frame, &numSamples, sizeof(numSamples));
+        for (uint32_t hNotify = first; hNotify < first + count; ++hNotify) {
+            Append(frame, &hNotify, sizeof(hNotify));
+            Append(frame, &size, sizeof(size));
+            Append(frame, &value, sizeof(value));
+        }
+        const auto length = static_cast<uint32_t>(frame.size() - sizeof(uint32_t));
+        memcpy(frame.data(), &length, sizeof(length));
+        return frame;
+    }
+
+    void testOrderPerHandle(const std::string&)
+    {
+        NotificationPool pool { 4 };
+        std::vector<SharedDispatcher> dispatchers;
+        for (uint32_t d = 0; d < POOL_DISPATCHERS; ++d) {
+            dispatchers.push_back(std::make_shared<NotificationDispatcher>(
+                                      [](uint32_t, uint32_t) { return 0L; },
+                                      [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; },
+                                      &pool));
+            for (uint32_t h = 0; h < POOL_HANDLES_PER_DISPATCHER; ++h) {
+                const auto hNotify = d * POOL_HANDLES_PER_DISPATCHER + h;
+                dispatchers.back()->Emplace(hNotify,
+                                            std::make_shared<Notification>(&PoolCallback, hNotify, 4, server,
+                                                                           static_cast<uint16_t>(30000 + d)));
+            }
+        }
+
+        for (uint32_t value = 1; value <= POOL_FRAMES; ++value) {
+            for (uint32_t d = 0; d < POOL_DISPATCHERS; ++d) {
+                const auto frame = Frame(d, value);
+                fructose_loop_assert(value, dispatchers[d]->Post(frame.data(), static_cast<uint32_t>(frame.size())));
+            }
+        }
+
+        const size_t expected = POOL_FRAMES * POOL_DISPATCHERS * POOL_HANDLES_PER_DISPATCHER;
+        for (int i = 0; (i < 1000) && (g_PoolReceived < expected); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        fructose_assert_eq(expected, g_PoolReceived.load());
+        fructose_assert_eq(0U, g_PoolOutOfOrder.load());
+        for (const auto& last : g_PoolLastSample) {
+            fructose_assert_eq(POOL_FRAMES, last);
+        }
+    }
+
+    /**
+     * Block the dispatcher within the callback of frame 1, fill its buffer with
+     * frames 2 and 3 and post frame 4 into the full buffer.
+     * @return values seen by the callbacks
+     */
+    std::vector<uint32_t> Overflow(ADSNOTIFICATIONOVERFLOW overflow, bool& posted, AdsNotificationStatistics& stats)
+    {
+        g_GateOpen = false;
+        g_GateValues.clear();
+        NotificationDispatcher testee {
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; }
+        };
+        testee.Emplace(0, std::make_shared<Notification>(&GateCallback, 0, 4, server, 30000));
+        const auto frameSize = Frame(0, 0).size();
+        testee.Configure(static_cast<uint32_t>(2 * (sizeof(uint32_t) + frameSize)), overflow, ADSDELIVERY_QUEUED);
+
+        const auto post = [&](uint32_t value) {
+                              const auto frame = Frame(0, value);
+                              return testee.Post(frame.data(), static_cast<uint32_t>(frame.size()));
+                          };
+        fructose_assert(post(1));
+        {
+            std::unique_lock<std::mutex> lock(g_GateMutex);
+            g_GateChanged.wait(lock, []() {
+                return !g_GateValues.empty();
+            });
+        }
+        fructose_assert(post(2));
+        fructose_assert(post(3));
+
+        auto fourth = std::async(std::launch::async, post, 4);
+        if (ADSOVERFLOW_BLOCK == overflow) {
+            fructose_assert(std::future_status::timeout == fourth.wait_for(std::chrono::milliseconds(50)));
+        } else {
+            fourth.wait();
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_GateMutex);
+            g_GateOpen = true;
+        }
+        g_GateChanged.notify_all();
+        posted = fourth.get();
+
+        for (int i = 0; (i < 1000) && testee.Statistics().pendingBytes; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        stats = testee.Statistics();
+        std::lock_guard<std::mutex> lock(g_GateMutex);
+        return g_GateValues;
+    }
+
+    void testOverflowDropNewest(const std::string&)
+    {
+        bool posted;
+        AdsNotificationStatistics stats;
+        const auto values = Overflow(ADSOVERFLOW_DROPNEWEST, posted, stats);
+        fructose_assert(!posted);
+        fructose_assert((std::vector<uint32_t> { 1, 2, 3 }) == values);
+        fructose_assert_eq(1U, stats.droppedFrames);
+        fructose_assert_eq(POOL_HANDLES_PER_DISPATCHER, stats.droppedSamples);
+        fructose_assert_eq(2 * (sizeof(uint32_t) + Frame(0, 0).size()), stats.peakBytes);
+    }
+
+    void testOverflowDropOldest(const std::string&)
+    {
+        bool posted;
+        AdsNotificationStatistics stats;
+        const auto values = Overflow(ADSOVERFLOW_DROPOLDEST, posted, stats);
+        fructose_assert(posted);
+        fructose_assert((std::vector<uint32_t> { 1, 3, 4 }) == values);
+        fructose_assert_eq(1U, stats.droppedFrames);
+        fructose_assert_eq(POOL_HANDLES_PER_DISPATCHER, stats.droppedSamples);
+    }
+
+    void testOverflowBlock(const std::string&)
+    {
+        bool posted;
+        AdsNotificationStatistics stats;
+        const auto values = Overflow(ADSOVERFLOW_BLOCK, posted, stats);
+        fructose_assert(posted);
+        fructose_assert((std::vector<uint32_t> { 1, 2, 3, 4 }) == values);
+        fructose_assert_eq(0U, stats.droppedFrames);
+        fructose_assert_eq(0U, stats.droppedSamples);
+        fructose_assert_eq(0U, stats.pendingBytes);
+    }
+
+    /** wait until the dispatcher delivered count samples, or a second passed */
+    static size_t WaitForLookups(size_t count)
+    {
+        for (int i = 0; (i < 1000) && (g_LookupReceived < count); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return g_LookupReceived.exchange(0);
+    }
+
+    static std::shared_ptr<Notification> LookupNotification(uint32_t hNotify)
+    {
+        auto notification = std::make_shared<Notification>(&LookupCallback, hNotify, 4, server, 30000);
+        notification->hNotify(hNotify);
+        return notification;
+    }
+
+    void testLookupManyHandles(const std::string&)
+    {
+        NotificationDispatcher testee {
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; }
+        };
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; ++h) {
+            testee.Emplace(h, LookupNotification(h));
+        }
+        const auto frame = Frame(0, LOOKUP_HANDLES, 0);
+        const auto length = static_cast<uint32_t>(frame.size());
+        g_LookupReceived = 0;
+        fructose_assert(testee.Post(frame.data(), length));
+        fructose_assert_eq(size_t(LOOKUP_HANDLES), WaitForLookups(LOOKUP_HANDLES));
+
+        // erase every second handle, while the dispatcher looks them up
+        std::vector<uint32_t> even;
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; h += 2) {
+            even.push_back(h);
+        }
+        auto posting = std::async(std::launch::async, [&]() {
+            for (int i = 0; i < 20; ++i) {
+                testee.Post(frame.data(), length);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        for (const auto& h : even) {
+            fructose_loop_assert(h, 0 == testee.Erase(h, 0));
+        }
+        posting.wait();
+        WaitForLookups(20 * LOOKUP_HANDLES);
+
+        fructose_assert(testee.Post(frame.data(), length));
+        fructose_assert_eq(size_t(LOOKUP_HANDLES / 2), WaitForLookups(LOOKUP_HANDLES / 2));
+        fructose_assert(!g_LookupWrongHandle);
+
+        // handles can be added again, after they were erased
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; h += 2) {
+            testee.Emplace(h, LookupNotification(h));
+        }
+        fructose_assert(testee.Post(frame.data(), length));
+        fructose_assert_eq(size_t(LOOKUP_HANDLES), WaitForLookups(LOOKUP_HANDLES));
+        fructose_assert(!g_LookupWrongHandle);
+    }
+
+    void testDeliverDirect(const std::string&)
+    {
+        NotificationDispatcher testee {
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; }
+        };
+        for (uint32_t h = 0; h < POOL_HANDLES_PER_DISPATCHER; ++h) {
+            auto notification = std::make_shared<Notification>(&DirectCallback, h, 4, server, 30000);
+            notification->hNotify(h);
+            testee.Emplace(h, notification);
+        }
+        testee.Configure(NotificationDispatcher::DEFAULT_CAPACITY, ADSOVERFLOW_DROPNEWEST, ADSDELIVERY_DIRECT);
+
+        // callbacks run on this thread and see the samples within the frame itself
+        g_DirectSamples.clear();
+        auto frame = Frame(0, 0xC0FFEE);
+        fructose_assert(testee.Deliver(frame.data(), static_cast<uint32_t>(frame.size())));
+        fructose_assert_eq(POOL_HANDLES_PER_DISPATCHER, g_DirectSamples.size());
+        for (uint32_t h = 0; h < g_DirectSamples.size(); ++h) {
+            const auto& sample = g_DirectSamples[h];
+            fructose_loop_assert(h, std::this_thread::get_id() == sample.thread);
+            fructose_loop_assert(h, sample.data >= frame.data());
+            fructose_loop_assert(h, sample.data + sizeof(uint32_t) <= frame.data() + frame.size());
+            fructose_loop_assert(h, 132000000000000000ULL == sample.header.nTimeStamp);
+            fructose_loop_assert(h, h == sample.header.hNotification);
+            fructose_loop_assert(h, 4 == sample.header.cbSampleSize);
+            fructose_loop_assert(h, 0xC0FFEE == sample.value);
+        }
+
+        // queued delivery still builds the same headers, but keeps every sample aligned
+        g_DirectSamples.clear();
+        testee.Configure(NotificationDispatcher::DEFAULT_CAPACITY, ADSOVERFLOW_DROPNEWEST, ADSDELIVERY_QUEUED);
+        frame = Frame(0, 0xC0FFEE);
+        fructose_assert(testee.Deliver(frame.data(), static_cast<uint32_t>(frame.size())));
+        for (int i = 0; (i < 1000) && testee.Statistics().pendingBytes; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard<std::mutex> lock(g_DirectMutex);
+        fructose_assert_eq(POOL_HANDLES_PER_DISPATCHER, g_DirectSamples.size());
+        for (uint32_t h = 0; h < g_DirectSamples.size(); ++h) {
+            const auto& sample = g_DirectSamples[h];
+            fructose_loop_assert(h, std::this_thread::get_id() != sample.thread);
+            fructose_loop_assert(h, 0 == reinterpret_cast<uintptr_t>(sample.data) % sizeof(uint64_t));
+            fructose_loop_assert(h, h == sample.header.hNotification);
+            fructose_loop_assert(h, 0xC0FFEE == sample.value);
+        }
+    }
+
+    void testDeliverDirectWhileScheduled(const std::string&)
+    {
+        // the only worker of the pool is blocked by another dispatcher
+        g_GateOpen = false;
+        g_GateValues.clear();
+        NotificationPool pool { 1 };
+        const auto blocker = std::make_shared<NotificationDispatcher>(
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; },
+            &pool);
+        blocker->Emplace(0, std::make_shared<Notification>(&GateCallback, 0, 4, server, 30000));
+        const auto blocking = Frame(0, 1, 1);
+        fructose_assert(blocker->Post(blocking.data(), static_cast<uint32_t>(blocking.size())));
+        {
+            std::unique_lock<std::mutex> lock(g_GateMutex);
+            g_GateChanged.wait(lock, []() {
+                return !g_GateValues.empty();
+            });
+        }
+
+        // ADSOVERFLOW_DROPOLDEST drops the scheduled frame together with an oversized one
+        const auto testee = std::make_shared<NotificationDispatcher>(
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; },
+            &pool);
+        auto notification = std::make_shared<Notification>(&DirectCallback, 1, 4, server, 30001);
+        notification->hNotify(1);
+        testee->Emplace(1, notification);
+        const auto scheduled = Frame(1, 1, 0xC0FFEE);
+        fructose_assert(testee->Post(scheduled.data(), static_cast<uint32_t>(scheduled.size())));
+        testee->Configure(static_cast<uint32_t>(sizeof(uint32_t) + scheduled.size()), ADSOVERFLOW_DROPOLDEST,
+                          ADSDELIVERY_QUEUED);
+        const auto oversized = Frame(1, 2, 0xBAD);
+        fructose_assert(!testee->Post(oversized.data(), static_cast<uint32_t>(oversized.size())));
+        fructose_assert_eq(2U, testee->Statistics().droppedFrames);
+
+        // the stale Dispatch() is still scheduled, so direct delivery has to queue behind it
+        g_DirectSamples.clear();
+        testee->Configure(NotificationDispatcher::DEFAULT_CAPACITY, ADSOVERFLOW_DROPNEWEST, ADSDELIVERY_DIRECT);
+        auto direct = Frame(1, 1, 0xD1EC7);
+        fructose_assert(testee->Deliver(direct.data(), static_cast<uint32_t>(direct.size())));
+        {
+            std::lock_guard<std::mutex> lock(g_DirectMutex);
+            fructose_assert(g_DirectSamples.empty());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_GateMutex);
+            g_GateOpen = true;
+        }
+        g_GateChanged.notify_all();
+        for (int i = 0; (i < 1000) && testee->Statistics().pendingBytes; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard<std::mutex> lock(g_DirectMutex);
+        fructose_assert_eq(1U, g_DirectSamples.size());
+        fructose_assert(std::this_thread::get_id() != g_DirectSamples[0].thread);
+        fructose_assert(0xD1EC7 == g_DirectSamples[0].value);
+    }
+
+    void testReclaimWithoutReader(const std::string&)
+    {
+        NotificationDispatcher testee {
+            [](uint32_t, uint32_t) { return 0L; },
+            [](const std::vector<uint32_t>&, uint32_t, long*) { return 0L; }
+        };
+
+        // no frame is dispatched, so erased notifications are released by Erase() itself
+        const auto notification = LookupNotification(1);
+        testee.Emplace(1, notification);
+        fructose_assert_eq(2, notification.use_count());
+        testee.Erase(1, 0);
+        fructose_assert_eq(1, notification.use_count());
+
+        // the same holds for many notifications, while their tables are replaced
+        std::vector<std::shared_ptr<Notification> > many;
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; ++h) {
+            many.push_back(LookupNotification(h));
+            testee.Emplace(h, many.back());
+        }
+        std::vector<long> errors(LOOKUP_HANDLES);
+        std::vector<uint32_t> handles;
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; ++h) {
+            handles.push_back(h);
+        }
+        testee.Erase(handles, 0, errors.data());
+        for (uint32_t h = 0; h < LOOKUP_HANDLES; ++h) {
+            fructose_loop_assert(h, 1 == many[h].use_count());
+        }
+    }
+};
+
+struct TestAmsReactor : test_base<TestAmsReactor> {
+    std::ostream& out;
+
+    TestAmsReactor(std::ostream& outstream)
+        : out(outstream)
+    {}
+
+    static void PromiseCallback(long status, uint32_t, void* pUser)
+    {
+        static_cast<std::promise<long>*>(pUser)->set_value(status);
+    }
+
+    struct DeleteRouteContext {
+        AmsNetId netId;
+        long port;
+        std::promise<long> done;
+    };
+
+    static void DeleteRouteCallback(long status, uint32_t, void* pUser)
+    {
+        auto context = static_cast<DeleteRouteContext*>(pUser);
+        bhf::ads::DelLocalRoute(context->netId);
+        const auto closed = AdsPortCloseEx(context->port);
+        context->done.set_value(closed ? closed : status);
+    }
+
+    static std::string LoopbackIp(const uint8_t host)
+    {
+        return "127.0.0." + std::to_string(host);
+    }
+
+    /** route the AmsNetId 127.0.0.<host>.1.1 to a responder on 127.0.0.<host> */
+    static long AddResponderRoute(const uint8_t host, const LoopbackResponder& responder)
+    {
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        return bhf::ads::AddLocalRoute(AmsNetId {127, 0, 0, host, 1, 1}, LoopbackIp(host).c_str(), options);
+    }
+
+    void testReactorThreadLimit(const std::string&)
+    {
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == bhf::ads::SetReceiveThreads(AmsReactor::MAX_THREADS + 1));
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(AmsReactor::MAX_THREADS));
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+
+        // a blocked loop thread would stall all of its connections, so ADSOVERFLOW_BLOCK is rejected
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 == AdsSyncSetNotificationBufferEx(port, 1024, ADSOVERFLOW_BLOCK));
+        fructose_assert(ADSERR_DEVICE_INVALIDSTATE == bhf::ads::SetReceiveThreads(1));
+        fructose_assert(0 == AdsSyncSetNotificationBufferEx(port, 1024, ADSOVERFLOW_DROPNEWEST));
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(1));
+        fructose_assert(ADSERR_DEVICE_INVALIDSTATE == AdsSyncSetNotificationBufferEx(port, 1024, ADSOVERFLOW_BLOCK));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+    }
+
+    void testReactorManyConnections(const std::string&)
+    {
+        static const uint8_t FIRST_HOST = 10;
+        static const uint8_t NUM_TARGETS = 4;
+        static const size_t NUM_REQUESTS = 500;
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(1));
+        {
+            std::vector<std::unique_ptr<LoopbackResponder> > responders;
+            for (uint8_t i = 0; i < NUM_TARGETS; ++i) {
+                responders.emplace_back(new LoopbackResponder {LoopbackIp(FIRST_HOST + i).c_str()});
+                fructose_loop_assert(i, 0 == AddResponderRoute(FIRST_HOST + i, *responders.back()));
+            }
+
+            /* all targets share the one loop thread, which has to serve them concurrently */
+            std::atomic<size_t> failed(0);
+            std::vector<std::thread> threads;
+            for (uint8_t i = 0; i < NUM_TARGETS; ++i) {
+                threads.emplace_back([&failed, i]() {
+                    const AmsAddr target { {127, 0, 0, static_cast<uint8_t>(FIRST_HOST + i), 1, 1}, AMSPORT_R0_PLC_TC3 };
+                    const long port = AdsPortOpenEx();
+                    for (size_t n = 0; n < NUM_REQUESTS; ++n) {
+                        uint32_t buffer = 0xDEADBEEF;
+                        uint32_t bytesRead = 0;
+                        if (AdsSyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead) ||
+                            (sizeof(buffer) != bytesRead) || buffer) {
+                            ++failed;
+                        }
+                        std::promise<long> async;
+                        if (AdsAsyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, &PromiseCallback,
+                                               &async) ||
+                            async.get_future().get()) {
+                            ++failed;
+                        }
+                    }
+                    if (AdsPortCloseEx(port)) {
+                        ++failed;
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            fructose_assert_eq(0U, failed.load());
+
+            for (uint8_t i = 0; i < NUM_TARGETS; ++i) {
+                bhf::ads::DelLocalRoute(AmsNetId {127, 0, 0, static_cast<uint8_t>(FIRST_HOST + i), 1, 1});
+            }
+        }
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+    }
+
+    void DeleteRouteFromCallback(const uint8_t doomedHost, const uint8_t survivorHost)
+    {
+        LoopbackResponder doomed {LoopbackIp(doomedHost).c_str()};
+        LoopbackResponder survivor {LoopbackIp(survivorHost).c_str()};
+        fructose_assert(0 == AddResponderRoute(doomedHost, doomed));
+        fructose_assert(0 == AddResponderRoute(survivorHost, survivor));
+
+        /* the completion handler destroys the connection, which is just receiving its response */
+        DeleteRouteContext context { {127, 0, 0, doomedHost, 1, 1}, AdsPortOpenEx(), std::promise<long> {} };
+        const AmsAddr doomedAddr { context.netId, AMSPORT_R0_PLC_TC3 };
+        uint32_t buffer;
+        fructose_assert(0 == AdsAsyncReadReqEx2(context.port, &doomedAddr, 0x4020, 0, sizeof(buffer), &buffer,
+                                                &DeleteRouteCallback, &context));
+        auto done = context.done.get_future();
+        fructose_assert(std::future_status::ready == done.wait_for(std::chrono::seconds(5)));
+        fructose_assert(0 == done.get());
+
+        /* the route is gone, but the other connection is still served */
+        const long port = AdsPortOpenEx();
+        uint32_t bytesRead;
+        fructose_assert(GLOBALERR_MISSING_ROUTE ==
+                        AdsSyncReadReqEx2(port, &doomedAddr, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead));
+        const AmsAddr survivorAddr { {127, 0, 0, survivorHost, 1, 1}, AMSPORT_R0_PLC_TC3 };
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &survivorAddr, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(survivorAddr.netId);
+    }
+
+    void testDeleteRouteFromCallback(const std::string&)
+    {
+        /* without a reactor the callback runs on the receive thread of the connection it destroys */
+        DeleteRouteFromCallback(25, 26);
+    }
+
+    void testReactorDeleteRouteFromCallback(const std::string&)
+    {
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(1));
+        DeleteRouteFromCallback(14, 15);
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+    }
+
+    void OversizedFrame(const uint8_t host)
+    {
+        LoopbackResponder corrupt {LoopbackIp(host).c_str()};
+        fructose_assert(0 == AddResponderRoute(host, corrupt));
+        const AmsAddr target { {127, 0, 0, host, 1, 1}, AMSPORT_R0_PLC_TC3 };
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 5000));
+
+        /* a header announcing gigabytes closes the connection, instead of waiting for or allocating them */
+        corrupt.Corrupt(0xFFFFFFF0);
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t buffer;
+        std::promise<long> async;
+        fructose_assert(0 == AdsAsyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer,
+                                                &PromiseCallback, &async));
+        auto result = async.get_future();
+        fructose_assert(std::future_status::ready == result.wait_for(std::chrono::seconds(2)));
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == result.get());
+        fructose_assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(5000));
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(target.netId);
+    }
+
+    void testOversizedFrame(const std::string&)
+    {
+        OversizedFrame(17);
+    }
+
+    void testReactorOversizedFrame(const std::string&)
+    {
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(1));
+        OversizedFrame(18);
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+    }
+
+    void testReactorTimeout(const std::string&)
+    {
+        static const uint8_t SILENT = 16;
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(1));
+        {
+            LoopbackResponder silent {LoopbackIp(SILENT).c_str()};
+            silent.Pause();
+            fructose_assert(0 == AddResponderRoute(SILENT, silent));
+            const AmsAddr target { {127, 0, 0, SILENT, 1, 1}, AMSPORT_R0_PLC_TC3 };
+            const long port = AdsPortOpenEx();
+            fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+
+            uint32_t buffer;
+            uint32_t bytesRead;
+            fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT ==
+                            AdsSyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead));
+
+            /* asynchronous requests are expired by the loop thread */
+            const auto start = std::chrono::steady_clock::now();
+            std::promise<long> async;
+            fructose_assert(0 == AdsAsyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer,
+                                                    &PromiseCallback, &async));
+            auto result = async.get_future();
+            fructose_assert(std::future_status::ready == result.wait_for(std::chrono::seconds(2)));
+            fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == result.get());
+            fructose_assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+            fructose_assert(0 == AdsPortCloseEx(port));
+            bhf::ads::DelLocalRoute(target.netId);
+        }
+        fructose_assert(0 == bhf::ads::SetReceiveThreads(0));
+    }
 };
 
 struct TestAds : test_base<TestAds> {
@@ -389,6 +1667,146 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    void testAdsSumReadReqEx(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // more items than fit into one sum request
+        static const uint32_t NUM_ITEMS = ADS_SUMUP_MAX_ITEMS + 3;
+        std::vector<uint32_t> values(NUM_ITEMS);
+        std::vector<AdsReadItem> items(NUM_ITEMS);
+        std::vector<long> errors(NUM_ITEMS);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            const uint32_t offset = i * sizeof(i);
+            fructose_loop_assert(i, 0 == AdsSyncWriteReqEx(port, &server, 0x4020, offset, sizeof(i), &i));
+            values[i] = 0xDEADBEEF;
+            items[i] = AdsReadItem { 0x4020, offset, sizeof(values[i]), &values[i] };
+        }
+
+        // provide invalid indexGroup for one item
+        items[1].indexGroup = 0;
+        fructose_assert(0 == AdsSyncSumReadReqEx(port, &server, NUM_ITEMS, items.data(), errors.data()));
+        fructose_assert(ADSERR_DEVICE_SRVNOTSUPP == errors[1]);
+        fructose_assert(0xDEADBEEF == values[1]);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            if (i != 1) {
+                fructose_loop_assert(i, 0 == errors[i]);
+                fructose_loop_assert(i, i == values[i]);
+            }
+        }
+
+        // provide nullptr to errors
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncSumReadReqEx(port, &server, NUM_ITEMS, items.data(), nullptr));
+
+        // provide unknown AmsAddr
+        AmsAddr unknown { { 1, 2, 3, 4, 5, 6 }, AMSPORT_R0_PLC_TC3 };
+        fructose_assert(GLOBALERR_MISSING_ROUTE ==
+                        AdsSyncSumReadReqEx(port, &unknown, NUM_ITEMS, items.data(), errors.data()));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsSumWriteReqEx(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // more items than fit into one sum request
+        static const uint32_t NUM_ITEMS = ADS_SUMUP_MAX_ITEMS + 3;
+        std::vector<uint32_t> values(NUM_ITEMS);
+        std::vector<AdsWriteItem> items(NUM_ITEMS);
+        std::vector<long> errors(NUM_ITEMS);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            values[i] = NUM_ITEMS - i;
+            items[i] = AdsWriteItem { 0x4020, static_cast<uint32_t>(i * sizeof(i)), sizeof(values[i]), &values[i] };
+        }
+
+        // provide invalid indexGroup for one item
+        items[1].indexGroup = 0;
+        fructose_assert(0 == AdsSyncSumWriteReqEx(port, &server, NUM_ITEMS, items.data(), errors.data()));
+        fructose_assert(ADSERR_DEVICE_SRVNOTSUPP == errors[1]);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            if (i != 1) {
+                uint32_t buffer = 0;
+                fructose_loop_assert(i, 0 == errors[i]);
+                fructose_loop_assert(i, 0 == AdsSyncReadReqEx2(port, &server, 0x4020, items[i].indexOffset,
+                                                               sizeof(buffer), &buffer, nullptr));
+                fructose_loop_assert(i, values[i] == buffer);
+            }
+        }
+
+        // provide nullptr to errors
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncSumWriteReqEx(port, &server, NUM_ITEMS, items.data(), nullptr));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsSumSplitByLength(const std::string&)
+    {
+        static const AmsNetId netId {127, 0, 0, 21, 1, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {"127.0.0.21"};
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, "127.0.0.21", options));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // two items fit into ADS_SUMUP_MAX_LENGTH, the third one needs a second request
+        static const uint32_t NUM_ITEMS = 3;
+        static const uint32_t ITEM_LENGTH = ADS_SUMUP_MAX_LENGTH * 2 / 5;
+        std::vector<uint8_t> data(NUM_ITEMS * ITEM_LENGTH, 0xA5);
+        std::vector<AdsWriteItem> writeItems;
+        std::vector<AdsReadWriteItem> readWriteItems;
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            const auto buffer = data.data() + i * ITEM_LENGTH;
+            writeItems.push_back(AdsWriteItem { 0x4020, i * ITEM_LENGTH, ITEM_LENGTH, buffer });
+            readWriteItems.push_back(AdsReadWriteItem { 0x4020, i * ITEM_LENGTH, ITEM_LENGTH, buffer, 4, buffer });
+        }
+        std::vector<long> errors(NUM_ITEMS, -1);
+        fructose_assert(0 == AdsSyncSumWriteReqEx(port, &target, NUM_ITEMS, writeItems.data(), errors.data()));
+        fructose_assert(1 == responder.Served().size());
+        fructose_assert(2 == responder.Served()[0]);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            fructose_loop_assert(i, 0 == errors[i]);
+        }
+
+        // the read direction alone exceeds ADS_SUMUP_MAX_LENGTH
+        std::vector<uint32_t> bytesRead(NUM_ITEMS, 1);
+        errors.assign(NUM_ITEMS, -1);
+        fructose_assert(0 ==
+                        AdsSyncSumReadWriteReqEx(port, &target, NUM_ITEMS, readWriteItems.data(), errors.data(),
+                                                 bytesRead.data()));
+        fructose_assert(4 == responder.Served()[0]);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            fructose_loop_assert(i, 0 == errors[i]);
+            fructose_loop_assert(i, 0 == bytesRead[i]);
+        }
+
+        // so does the response of a sum read
+        std::vector<AdsReadItem> readItems;
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            readItems.push_back(AdsReadItem { 0x4020, i * ITEM_LENGTH, ITEM_LENGTH, data.data() + i * ITEM_LENGTH });
+        }
+        errors.assign(NUM_ITEMS, -1);
+        fructose_assert(0 == AdsSyncSumReadReqEx(port, &target, NUM_ITEMS, readItems.data(), errors.data()));
+        fructose_assert(6 == responder.Served()[0]);
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            fructose_loop_assert(i, 0 == errors[i]);
+        }
+        fructose_assert(std::all_of(data.begin(), data.end(), [](uint8_t b) { return 0 == b; }));
+
+        // items with a length need a buffer
+        readItems[1].buffer = nullptr;
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncSumReadReqEx(port, &target, NUM_ITEMS, readItems.data(), errors.data()));
+        fructose_assert(6 == responder.Served()[0]);
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+    }
+
     void testAdsReadReqEx2LargeBuffer(const std::string&)
     {
         char handleName[] = "MAIN.moreBytes";
@@ -413,6 +1831,123 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    struct AsyncResult {
+        std::promise<long> status;
+        uint32_t bytesRead;
+    };
+
+    static void AsyncCallback(long status, uint32_t bytesRead, void* pUser)
+    {
+        auto result = static_cast<AsyncResult*>(pUser);
+        result->bytesRead = bytesRead;
+        result->status.set_value(status);
+    }
+
+    /**
+     * @return error, if the request wasn't sent, otherwise the status of its completion or
+     * ADSERR_CLIENT_SYNCTIMEOUT, if the completion got lost
+     */
+    static long WaitForCompletion(const long error, std::unique_ptr<AsyncResult>& result)
+    {
+        if (error) {
+            return error;
+        }
+        auto status = result->status.get_future();
+        if (std::future_status::ready != status.wait_for(std::chrono::seconds(5))) {
+            /* a late completion still needs the result, so it is leaked instead of freed */
+            result.release();
+            return ADSERR_CLIENT_SYNCTIMEOUT;
+        }
+        return status.get();
+    }
+
+    void testAdsAsyncReadWriteReqEx(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        for (int i = 0; i < NUM_TEST_LOOPS; ++i) {
+            const uint32_t outBuffer = 0xDEADBEEF + i;
+            std::unique_ptr<AsyncResult> write {new AsyncResult};
+            fructose_loop_assert(i, 0 == WaitForCompletion(AdsAsyncWriteReqEx(port, &server, 0x4020, 0,
+                                                                              sizeof(outBuffer), &outBuffer,
+                                                                              &AsyncCallback, write.get()), write));
+
+            /* static, so a lost completion can't write into the stack of a later test */
+            static uint32_t buffer;
+            buffer = 0;
+            std::unique_ptr<AsyncResult> read {new AsyncResult};
+            const auto status = WaitForCompletion(AdsAsyncReadReqEx2(port, &server, 0x4020, 0, sizeof(buffer),
+                                                                     &buffer, &AsyncCallback, read.get()), read);
+            fructose_loop_assert(i, 0 == status);
+            if (!status) {
+                fructose_loop_assert(i, sizeof(buffer) == read->bytesRead);
+                fructose_loop_assert(i, outBuffer == buffer);
+            }
+        }
+
+        // provide nullptr to callback
+        uint32_t buffer;
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsAsyncReadReqEx2(port, &server, 0x4020, 0, sizeof(buffer), &buffer, nullptr, nullptr));
+
+        // provide unknown AmsAddr
+        AmsAddr unknown { { 1, 2, 3, 4, 5, 6 }, AMSPORT_R0_PLC_TC3 };
+        fructose_assert(GLOBALERR_MISSING_ROUTE ==
+                        AdsAsyncReadReqEx2(port, &unknown, 0x4020, 0, sizeof(buffer), &buffer, &AsyncCallback,
+                                           nullptr));
+
+        const uint32_t outBuffer = 0;
+        fructose_assert(0 == AdsSyncWriteReqEx(port, &server, 0x4020, 0, sizeof(outBuffer), &outBuffer));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    struct CountedResult {
+        std::atomic<int> calls;
+        std::atomic<long> status;
+    };
+
+    static void CountedCallback(long status, uint32_t, void* pUser)
+    {
+        auto result = static_cast<CountedResult*>(pUser);
+        result->status = status;
+        ++result->calls;
+    }
+
+    void testAdsAsyncCompletionDuringWrite(const std::string&)
+    {
+        static const AmsNetId paused {127, 0, 0, 6, 1, 1};
+        static const AmsAddr target {paused, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {"127.0.0.6"};
+        /* the responder doesn't read, so the write blocks until the request timed out */
+        responder.Pause();
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(paused, "127.0.0.6", options));
+
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetTimeoutEx(port, 100));
+
+        std::vector<uint8_t> data(16 * 1024 * 1024, 0xA5);
+        CountedResult result;
+        result.calls = 0;
+        result.status = 0;
+        auto writer = std::async(std::launch::async, [&]() {
+            return AdsAsyncWriteReqEx(port, &target, 0x4020, 0, data.size(), data.data(), &CountedCallback, &result);
+        });
+        fructose_assert(std::future_status::timeout == writer.wait_for(std::chrono::milliseconds(500)));
+        fructose_assert(0 == result.calls.load());
+
+        responder.Resume();
+        fructose_assert(0 == writer.get());
+        fructose_assert(1 == result.calls.load());
+        fructose_assert(ADSERR_CLIENT_SYNCTIMEOUT == result.status.load());
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(paused);
+    }
+
     void testAdsReadDeviceInfoReqEx(const std::string&)
     {
         static const char NAME[] = "Plc30 App";
@@ -789,6 +2324,327 @@ struct TestAds : test_base<TestAds> {
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 
+    void testAdsNotifications(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        static const uint32_t MAX_NOTIFICATIONS_PER_PORT = 1024;
+        static const uint32_t LEAKED_NOTIFICATIONS = MAX_NOTIFICATIONS_PER_PORT / 2;
+        std::vector<AdsNotificationItem> items(MAX_NOTIFICATIONS_PER_PORT);
+        std::vector<uint32_t> notification(MAX_NOTIFICATIONS_PER_PORT);
+        std::vector<long> errors(MAX_NOTIFICATIONS_PER_PORT);
+        for (uint32_t hUser = 0; hUser < MAX_NOTIFICATIONS_PER_PORT; ++hUser) {
+            items[hUser] = AdsNotificationItem { 0x4020, 4, { 1, ADSTRANS_SERVERCYCLE, 0, {1000000} }, &NotifyCallback,
+                                                 hUser };
+        }
+
+        // provide nullptr to callback
+        items[1].pFunc = nullptr;
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncAddDeviceNotificationsReqEx(port, &server, MAX_NOTIFICATIONS_PER_PORT, items.data(),
+                                                           notification.data(), errors.data()));
+        items[1].pFunc = &NotifyCallback;
+
+        // provide invalid indexGroup for one item
+        items[2].indexGroup = 0;
+        fructose_assert(0 == AdsSyncAddDeviceNotificationsReqEx(port, &server, MAX_NOTIFICATIONS_PER_PORT, items.data(),
+                                                                notification.data(), errors.data()));
+        fructose_assert(ADSERR_DEVICE_SRVNOTSUPP == errors[2]);
+        fructose_assert(0 == notification[2]);
+        for (uint32_t hUser = 0; hUser < MAX_NOTIFICATIONS_PER_PORT; ++hUser) {
+            if (hUser != 2) {
+                fructose_loop_assert(hUser, 0 == errors[hUser]);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // delete nonexisting notification
+        notification[2] = 0xDEADBEEF;
+        const auto numDeleted = MAX_NOTIFICATIONS_PER_PORT - LEAKED_NOTIFICATIONS;
+        fructose_assert(0 == AdsSyncDelDeviceNotificationsReqEx(port, &server, numDeleted, notification.data(),
+                                                                errors.data()));
+        fructose_assert(ADSERR_CLIENT_REMOVEHASH == errors[2]);
+        for (uint32_t hUser = 0; hUser < numDeleted; ++hUser) {
+            if (hUser != 2) {
+                fructose_loop_assert(hUser, 0 == errors[hUser]);
+            }
+        }
+
+        // the leaked notifications are deleted in bulk by AdsPortCloseEx()
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsNotificationsFallback(const std::string&)
+    {
+        static const AmsNetId netId {127, 0, 0, 28, 1, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {"127.0.0.28"};
+        responder.RejectSumCommands();
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, "127.0.0.28", options));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        // without ADSIGRP_SUMUP_ADDDEVNOTE the notifications are added one by one
+        static const uint32_t NUM_ITEMS = 3;
+        std::vector<AdsNotificationItem> items;
+        for (uint32_t hUser = 0; hUser < NUM_ITEMS; ++hUser) {
+            items.push_back(AdsNotificationItem { 0x4020, 4, { 1, ADSTRANS_SERVERCYCLE, 0, {1000000} }, &NotifyCallback,
+                                                  hUser });
+        }
+        std::vector<uint32_t> notification(NUM_ITEMS);
+        std::vector<long> errors(NUM_ITEMS, -1);
+        fructose_assert(0 == AdsSyncAddDeviceNotificationsReqEx(port, &target, NUM_ITEMS, items.data(),
+                                                                notification.data(), errors.data()));
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            fructose_loop_assert(i, 0 == errors[i]);
+            fructose_loop_assert(i, i + 1 == notification[i]);
+        }
+        fructose_assert(1 + NUM_ITEMS == responder.Served()[0]);
+
+        // so are they deleted without ADSIGRP_SUMUP_DELDEVNOTE
+        errors.assign(NUM_ITEMS, -1);
+        fructose_assert(0 == AdsSyncDelDeviceNotificationsReqEx(port, &target, NUM_ITEMS, notification.data(),
+                                                                errors.data()));
+        for (uint32_t i = 0; i < NUM_ITEMS; ++i) {
+            fructose_loop_assert(i, 0 == errors[i]);
+        }
+        fructose_assert(2 * (1 + NUM_ITEMS) == responder.Served()[0]);
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+    }
+
+    void testAdsCoalescing(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsSyncSetCoalescingEx(0, true, 1000));
+        fructose_assert(0 == AdsSyncSetCoalescingEx(port, true, 1000));
+
+        // concurrent requests are merged, but each thread gets its own results
+        static const uint32_t NUM_THREADS = 32;
+        struct Results {
+            long write;
+            long read;
+            uint32_t bytesRead;
+            uint32_t value;
+            long invalid;
+            long reset;
+        } results[NUM_THREADS];
+        std::thread threads[NUM_THREADS];
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            threads[i] = std::thread([this, port, i, &results]() {
+                const uint32_t offset = i * sizeof(uint32_t);
+                const uint32_t value = 0xC0A1E5CE + i;
+                auto& r = results[i];
+                r.value = 0;
+                r.bytesRead = 0;
+                r.write = AdsSyncWriteReqEx(port, &server, 0x4020, offset, sizeof(value), &value);
+                r.read = AdsSyncReadReqEx2(port, &server, 0x4020, offset, sizeof(r.value), &r.value, &r.bytesRead);
+
+                // an invalid request fails without affecting the others
+                uint32_t buffer;
+                r.invalid = AdsSyncReadReqEx2(port, &server, 0, offset, sizeof(buffer), &buffer, nullptr);
+
+                const uint32_t zero = 0;
+                r.reset = AdsSyncWriteReqEx(port, &server, 0x4020, offset, sizeof(zero), &zero);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            fructose_loop_assert(i, 0 == results[i].write);
+            fructose_loop_assert(i, 0 == results[i].read);
+            fructose_loop_assert(i, sizeof(uint32_t) == results[i].bytesRead);
+            fructose_loop_assert(i, 0xC0A1E5CE + i == results[i].value);
+            fructose_loop_assert(i, ADSERR_DEVICE_SRVNOTSUPP == results[i].invalid);
+            fructose_loop_assert(i, 0 == results[i].reset);
+        }
+        fructose_assert(0 == AdsSyncSetCoalescingEx(port, false, 0));
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testAdsCoalescingMergesRequests(const std::string&)
+    {
+        static const AmsNetId netId {127, 0, 0, 22, 1, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {"127.0.0.22"};
+        /* the first batch stays in flight until all threads have queued their requests */
+        responder.Pause();
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, "127.0.0.22", options));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetCoalescingEx(port, true, 1000));
+
+        static const uint32_t NUM_THREADS = 32;
+        long results[NUM_THREADS];
+        std::thread threads[NUM_THREADS];
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            threads[i] = std::thread([port, i, &results]() {
+                uint32_t buffer;
+                results[i] = AdsSyncReadReqEx2(port, &target, 0x4020, i * sizeof(buffer), sizeof(buffer), &buffer,
+                                               nullptr);
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        responder.Resume();
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            fructose_loop_assert(i, 0 == results[i]);
+        }
+        const auto served = responder.Served();
+        fructose_assert(1 == served.size());
+        fructose_assert(0 < served[0]);
+        fructose_assert(served[0] < NUM_THREADS);
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+    }
+
+    void testAdsCoalescingFullBatch(const std::string&)
+    {
+        static const AmsNetId netId {127, 0, 0, 27, 1, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {"127.0.0.27"};
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, "127.0.0.27", options));
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetCoalescingEx(port, true, 100000));
+
+        // the last request doesn't fit into the open batch, which is sent without waiting for its window
+        static const uint32_t NUM_THREADS = 3;
+        static const uint32_t LENGTH = ADS_SUMUP_MAX_LENGTH * 2 / 5;
+        long results[NUM_THREADS];
+        std::thread threads[NUM_THREADS];
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            threads[i] = std::thread([port, i, &results]() {
+                std::vector<uint8_t> buffer(LENGTH);
+                results[i] = AdsSyncReadReqEx2(port, &target, 0x4020, i * LENGTH, LENGTH, buffer.data(), nullptr);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (uint32_t i = 0; i < NUM_THREADS; ++i) {
+            fructose_loop_assert(i, 0 == results[i]);
+        }
+        const auto served = responder.Served();
+        fructose_assert(1 == served.size());
+        fructose_assert(2 <= served[0]);
+
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+    }
+
+    void testAdsNotificationBuffer(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        AdsNotificationStatistics stats;
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsSyncSetNotificationBufferEx(0, 1, ADSOVERFLOW_DROPNEWEST));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncSetNotificationBufferEx(port, 1, static_cast<ADSNOTIFICATIONOVERFLOW>(3)));
+        fructose_assert(ADSERR_CLIENT_NOAMSADDR == AdsGetNotificationStatisticsEx(port, nullptr, &stats));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsGetNotificationStatisticsEx(port, &server, nullptr));
+
+        // frames are sent on demand by a private responder, so every sample is accounted for
+        static const AmsNetId netId {127, 0, 0, 23, 1, 1};
+        static const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        static const uint32_t NUM_FRAMES = 5;
+        static const uint32_t SAMPLES_PER_FRAME = 3;
+        static const uint32_t SAMPLE_SIZE = 4;
+        LoopbackResponder responder {"127.0.0.23"};
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, "127.0.0.23", options));
+
+        // no frame fits into a single byte, so all of them are dropped and counted
+        fructose_assert(0 == AdsSyncSetNotificationBufferEx(port, 1, ADSOVERFLOW_DROPNEWEST));
+        AdsNotificationAttrib attrib = { SAMPLE_SIZE, ADSTRANS_SERVERCYCLE, 0, {1000000} };
+        uint32_t hNotify;
+        fructose_assert(0 ==
+                        AdsSyncAddDeviceNotificationReqEx(port, &target, 0x4020, 0, &attrib, &CountingCallback, 0,
+                                                          &hNotify));
+        {
+            std::lock_guard<std::mutex> lock(g_CountMutex);
+            g_CountedSamples = 0;
+        }
+        for (uint32_t i = 0; i < NUM_FRAMES; ++i) {
+            fructose_loop_assert(i, responder.Notify(hNotify, SAMPLE_SIZE, SAMPLES_PER_FRAME));
+        }
+        // the response is received after all frames sent before it, so they were posted already
+        uint32_t buffer;
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, nullptr));
+        fructose_assert(0 == AdsGetNotificationStatisticsEx(port, &target, &stats));
+        fructose_assert_eq(NUM_FRAMES, stats.droppedFrames);
+        fructose_assert_eq(NUM_FRAMES * SAMPLES_PER_FRAME, stats.droppedSamples);
+        fructose_assert_eq(0U, stats.peakBytes);
+
+        // enlarging the buffer applies to existing notifications, too
+        fructose_assert(0 == AdsSyncSetNotificationBufferEx(port, 64 * 1024, ADSOVERFLOW_DROPOLDEST));
+        for (uint32_t i = 0; i < NUM_FRAMES; ++i) {
+            fructose_loop_assert(i, responder.Notify(hNotify, SAMPLE_SIZE, SAMPLES_PER_FRAME));
+        }
+        fructose_assert(WaitForSamples(NUM_FRAMES * SAMPLES_PER_FRAME));
+        fructose_assert(0 == AdsGetNotificationStatisticsEx(port, &target, &stats));
+        fructose_assert_eq(NUM_FRAMES, stats.droppedFrames);
+        fructose_assert(0 < stats.peakBytes);
+        {
+            std::lock_guard<std::mutex> lock(g_CountMutex);
+            fructose_assert_eq(NUM_FRAMES * SAMPLES_PER_FRAME, g_CountedSamples);
+        }
+
+        // a frame larger than the whole buffer is dropped with DROPOLDEST, too
+        fructose_assert(0 == AdsSyncSetNotificationBufferEx(port, 64, ADSOVERFLOW_DROPOLDEST));
+        fructose_assert(responder.Notify(hNotify, 64, 1));
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, nullptr));
+        fructose_assert(0 == AdsGetNotificationStatisticsEx(port, &target, &stats));
+        fructose_assert_eq(NUM_FRAMES + 1, stats.droppedFrames);
+
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &target, hNotify));
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+    }
+
+    void testAdsNotificationDelivery(const std::string&)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsSyncSetNotificationDeliveryEx(0, ADSDELIVERY_DIRECT));
+        fructose_assert(ADSERR_CLIENT_INVALIDPARM ==
+                        AdsSyncSetNotificationDeliveryEx(port, static_cast<ADSNOTIFICATIONDELIVERY>(2)));
+        fructose_assert(0 == AdsSyncSetNotificationDeliveryEx(port, ADSDELIVERY_DIRECT));
+
+        g_DirectSamples.clear();
+        AdsNotificationAttrib attrib = { 4, ADSTRANS_SERVERCYCLE, 0, {1000000} };
+        uint32_t hNotify;
+        fructose_assert(0 ==
+                        AdsSyncAddDeviceNotificationReqEx(port, &server, 0x4020, 0, &attrib, &DirectCallback, 0,
+                                                          &hNotify));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        fructose_assert(0 == AdsSyncDelDeviceNotificationReqEx(port, &server, hNotify));
+
+        std::lock_guard<std::mutex> lock(g_DirectMutex);
+        fructose_assert(!g_DirectSamples.empty());
+        for (const auto& sample : g_DirectSamples) {
+            fructose_assert(hNotify == sample.header.hNotification);
+            fructose_assert(4 == sample.header.cbSampleSize);
+        }
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
     void testAdsTimeout(const std::string&)
     {
         const long port = AdsPortOpenEx();
@@ -811,6 +2667,14 @@ struct TestAds : test_base<TestAds> {
 
         // provide nullptr to timeout
         fructose_assert(ADSERR_CLIENT_INVALIDPARM == AdsSyncGetTimeoutEx(port, nullptr));
+
+        // responses are still received while polling for them
+        uint32_t buffer;
+        uint32_t bytesRead;
+        fructose_assert(ADSERR_CLIENT_PORTNOTOPEN == AdsSyncSetSpinTimeEx(0, 100));
+        fructose_assert(0 == AdsSyncSetSpinTimeEx(port, 100));
+        fructose_assert(0 == AdsSyncReadReqEx2(port, &server, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead));
+        fructose_assert(sizeof(buffer) == bytesRead);
         fructose_assert(0 == AdsPortCloseEx(port));
     }
 };
@@ -872,6 +2736,166 @@ struct TestAdsPerformance : test_base<TestAdsPerformance> {
         out << testname << " took " << tmms << "ms\n";
     }
 
+    void testParallelReadSamePort(const std::string& testname)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+
+        std::thread threads[96];
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (auto& t : threads) {
+            t = std::thread(&TestAdsPerformance::ReadOnPort, this, port, 1024);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto tmms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        out << testname << " took " << tmms << "ms\n";
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    void testParallelReadCoalesced(const std::string& testname)
+    {
+        const long port = AdsPortOpenEx();
+        fructose_assert(0 != port);
+        fructose_assert(0 == AdsSyncSetCoalescingEx(port, true, 0));
+
+        std::thread threads[96];
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (auto& t : threads) {
+            t = std::thread(&TestAdsPerformance::ReadOnPort, this, port, 1024);
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto tmms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        out << testname << " took " << tmms << "ms\n";
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
+
+    /**
+     * Measure the round trip time against a LoopbackResponder listening on <ip>.
+     * Every measurement should use its own loopback address, so it gets a fresh
+     * connection with <options> instead of reusing an existing one.
+     */
+    double MeasureRoundTrip(SocketOptions options, const uint8_t ip, const size_t numThreads, const size_t numLoops)
+    {
+        const std::string address = "127.0.0." + std::to_string(ip);
+        const AmsNetId loopbackNetId {127, 0, 0, ip, 1, 1};
+        const AmsAddr loopback {loopbackNetId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {address.c_str()};
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(loopbackNetId, address.c_str(), options));
+
+        std::atomic<size_t> failed(0);
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back([&]() {
+                const long port = AdsPortOpenEx();
+                uint32_t buffer;
+                uint32_t bytesRead;
+                for (size_t n = 0; n < numLoops; ++n) {
+                    if (AdsSyncReadReqEx2(port, &loopback, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead) ||
+                        (sizeof(buffer) != bytesRead)) {
+                        ++failed;
+                    }
+                }
+                if (AdsPortCloseEx(port)) {
+                    ++failed;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        bhf::ads::DelLocalRoute(loopbackNetId);
+        fructose_assert_eq(0U, failed.load());
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        return static_cast<double>(us) / numLoops;
+    }
+
+    void testSocketOptionsRoundTrip(const std::string& testname)
+    {
+        SocketOptions nagle;
+        nagle.noDelay = false;
+        const SocketOptions lowLatency;
+
+        uint8_t ip = 2;
+        for (size_t numThreads : {1, 8}) {
+            const auto withNagle = MeasureRoundTrip(nagle, ip++, numThreads, 2000);
+            const auto withoutNagle = MeasureRoundTrip(lowLatency, ip++, numThreads, 2000);
+            fructose_assert(withNagle > 0);
+            fructose_assert(withoutNagle > 0);
+            out << testname << " " << numThreads << " thread(s) round trip: " << std::fixed << std::setprecision(1) <<
+                withNagle << "us with Nagle, " << withoutNagle << "us with TCP_NODELAY\n";
+        }
+    }
+
+    /**
+     * Measure the average latency of small reads, while three threads keep reading
+     * 300 KB over the same route with <numConnections> to a LoopbackResponder on <ip>.
+     */
+    double MeasureBesideBulkReads(const size_t numConnections, const uint8_t ip, const size_t numLoops)
+    {
+        static const size_t NUM_BULK_THREADS = 3;
+        const std::string address = "127.0.0." + std::to_string(ip);
+        const AmsNetId netId {127, 0, 0, ip, 1, 1};
+        const AmsAddr target {netId, AMSPORT_R0_PLC_TC3};
+        LoopbackResponder responder {address.c_str()};
+        SocketOptions options;
+        options.serverPort = responder.Port();
+        fructose_assert(0 == bhf::ads::AddLocalRoute(netId, address.c_str(), options, numConnections));
+
+        std::atomic<bool> running(true);
+        std::atomic<size_t> failed(0);
+        std::vector<std::thread> bulk;
+        for (size_t i = 0; i < NUM_BULK_THREADS; ++i) {
+            bulk.emplace_back([&]() {
+                const long port = AdsPortOpenEx();
+                std::vector<uint8_t> buffer(300 * 1024);
+                uint32_t bytesRead;
+                while (running) {
+                    if (AdsSyncReadReqEx2(port, &target, 0x4020, 0, buffer.size(), buffer.data(), &bytesRead)) {
+                        ++failed;
+                    }
+                }
+                AdsPortCloseEx(port);
+            });
+        }
+
+        const long port = AdsPortOpenEx();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < numLoops; ++n) {
+            uint32_t buffer;
+            uint32_t bytesRead;
+            if (AdsSyncReadReqEx2(port, &target, 0x4020, 0, sizeof(buffer), &buffer, &bytesRead)) {
+                ++failed;
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+        running = false;
+        for (auto& t : bulk) {
+            t.join();
+        }
+        fructose_assert(0 == AdsPortCloseEx(port));
+        bhf::ads::DelLocalRoute(netId);
+        fructose_assert_eq(0U, failed.load());
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        return static_cast<double>(us) / numLoops;
+    }
+
+    void testBulkConnections(const std::string& testname)
+    {
+        const auto shared = MeasureBesideBulkReads(1, 7, 1000);
+        const auto separate = MeasureBesideBulkReads(3, 8, 1000);
+        out << testname << " small reads beside bulk reads: " << std::fixed << std::setprecision(1) << shared <<
+            "us with one connection, " << separate << "us with three connections\n";
+    }
+
     void testEndurance(const std::string& testname)
     {
         static const size_t numNotifications = 1024;
@@ -940,7 +2964,12 @@ private:
     {
         const long port = AdsPortOpenEx();
         fructose_assert(0 != port);
+        ReadOnPort(port, numLoops);
+        fructose_assert(0 == AdsPortCloseEx(port));
+    }
 
+    void ReadOnPort(const long port, const size_t numLoops)
+    {
         uint32_t bytesRead;
         uint32_t buffer;
         do {
@@ -952,7 +2981,6 @@ private:
                 fructose_loop_assert(i, 0 == buffer);
             }
         } while (runEndurance);
-        fructose_assert(0 == AdsPortCloseEx(port));
     }
 };
 
@@ -973,6 +3001,8 @@ int main()
     TestAmsRouter routerTest(errorstream);
     routerTest.add_test("testAmsRouterAddRoute", &TestAmsRouter::testAmsRouterAddRoute);
     routerTest.add_test("testAmsRouterDelRoute", &TestAmsRouter::testAmsRouterDelRoute);
+    routerTest.add_test("testAmsRouterAddRoutes", &TestAmsRouter::testAmsRouterAddRoutes);
+    routerTest.add_test("testAmsRouterBulkConnections", &TestAmsRouter::testAmsRouterBulkConnections);
 //    routerTest.add_test("testConcurrentRoutes", &TestAmsRouter::testConcurrentRoutes);
     routerTest.add_test("testAmsRouterSetLocalAddress", &TestAmsRouter::testAmsRouterSetLocalAddress);
     failedTests += routerTest.run();
@@ -981,27 +3011,82 @@ int main()
     ipv4Test.add_test("testComparsion", &TestIpV4::testComparsion);
     failedTests += ipv4Test.run();
 
+#if defined(__linux__)
+    TestTcpSocket tcpSocketTest(errorstream);
+    tcpSocketTest.add_test("testConnectTimeout", &TestTcpSocket::testConnectTimeout);
+    failedTests += tcpSocketTest.run();
+#endif
+
+    TestFrame frameTest(errorstream);
+    frameTest.add_test("testFrameInline", &TestFrame::testFrameInline);
+    frameTest.add_test("testFrameCacheReuse", &TestFrame::testFrameCacheReuse);
+    frameTest.add_test("testFrameCacheBound", &TestFrame::testFrameCacheBound);
+    failedTests += frameTest.run();
+
     TestRingBuffer ringBufferTest(errorstream);
     ringBufferTest.add_test("testBytesFree", &TestRingBuffer::testBytesFree);
     ringBufferTest.add_test("testWriteChunk", &TestRingBuffer::testWriteChunk);
+    ringBufferTest.add_test("testMirrorBytesFree", &TestRingBuffer::testMirrorBytesFree);
+    ringBufferTest.add_test("testMirrorContiguous", &TestRingBuffer::testMirrorContiguous);
+    ringBufferTest.add_test("testMirrorReadFromLittleEndian", &TestRingBuffer::testMirrorReadFromLittleEndian);
     failedTests += ringBufferTest.run();
+
+    TestNotificationDispatcher notificationDispatcherTest(errorstream);
+    notificationDispatcherTest.add_test("testOrderPerHandle", &TestNotificationDispatcher::testOrderPerHandle);
+    notificationDispatcherTest.add_test("testOverflowDropNewest", &TestNotificationDispatcher::testOverflowDropNewest);
+    notificationDispatcherTest.add_test("testOverflowDropOldest", &TestNotificationDispatcher::testOverflowDropOldest);
+    notificationDispatcherTest.add_test("testOverflowBlock", &TestNotificationDispatcher::testOverflowBlock);
+    notificationDispatcherTest.add_test("testLookupManyHandles", &TestNotificationDispatcher::testLookupManyHandles);
+    notificationDispatcherTest.add_test("testDeliverDirect", &TestNotificationDispatcher::testDeliverDirect);
+    notificationDispatcherTest.add_test("testDeliverDirectWhileScheduled",
+                                        &TestNotificationDispatcher::testDeliverDirectWhileScheduled);
+    notificationDispatcherTest.add_test("testReclaimWithoutReader", &TestNotificationDispatcher::testReclaimWithoutReader);
+    failedTests += notificationDispatcherTest.run();
+
+#if defined(__linux__)
+    TestAmsReactor reactorTest(errorstream);
+    reactorTest.add_test("testReactorThreadLimit", &TestAmsReactor::testReactorThreadLimit);
+    reactorTest.add_test("testReactorManyConnections", &TestAmsReactor::testReactorManyConnections);
+    reactorTest.add_test("testDeleteRouteFromCallback", &TestAmsReactor::testDeleteRouteFromCallback);
+    reactorTest.add_test("testReactorDeleteRouteFromCallback", &TestAmsReactor::testReactorDeleteRouteFromCallback);
+    reactorTest.add_test("testReactorTimeout", &TestAmsReactor::testReactorTimeout);
+    reactorTest.add_test("testOversizedFrame", &TestAmsReactor::testOversizedFrame);
+    reactorTest.add_test("testReactorOversizedFrame", &TestAmsReactor::testReactorOversizedFrame);
+    failedTests += reactorTest.run();
+#endif
 #endif
     TestAds adsTest(errorstream);
     adsTest.add_test("testAdsPortOpenEx", &TestAds::testAdsPortOpenEx);
     adsTest.add_test("testAdsReadReqEx2", &TestAds::testAdsReadReqEx2);
+    adsTest.add_test("testAdsSumReadReqEx", &TestAds::testAdsSumReadReqEx);
+    adsTest.add_test("testAdsSumWriteReqEx", &TestAds::testAdsSumWriteReqEx);
+    adsTest.add_test("testAdsSumSplitByLength", &TestAds::testAdsSumSplitByLength);
     adsTest.add_test("testAdsReadReqEx2LargeBuffer", &TestAds::testAdsReadReqEx2LargeBuffer);
+    adsTest.add_test("testAdsAsyncReadWriteReqEx", &TestAds::testAdsAsyncReadWriteReqEx);
+    adsTest.add_test("testAdsAsyncCompletionDuringWrite", &TestAds::testAdsAsyncCompletionDuringWrite);
     adsTest.add_test("testAdsReadDeviceInfoReqEx", &TestAds::testAdsReadDeviceInfoReqEx);
     adsTest.add_test("testAdsReadStateReqEx", &TestAds::testAdsReadStateReqEx);
     adsTest.add_test("testAdsReadWriteReqEx2", &TestAds::testAdsReadWriteReqEx2);
     adsTest.add_test("testAdsWriteReqEx", &TestAds::testAdsWriteReqEx);
     adsTest.add_test("testAdsWriteControlReqEx", &TestAds::testAdsWriteControlReqEx);
     adsTest.add_test("testAdsNotification", &TestAds::testAdsNotification);
+    adsTest.add_test("testAdsNotifications", &TestAds::testAdsNotifications);
+    adsTest.add_test("testAdsNotificationsFallback", &TestAds::testAdsNotificationsFallback);
+    adsTest.add_test("testAdsCoalescing", &TestAds::testAdsCoalescing);
+    adsTest.add_test("testAdsCoalescingMergesRequests", &TestAds::testAdsCoalescingMergesRequests);
+    adsTest.add_test("testAdsCoalescingFullBatch", &TestAds::testAdsCoalescingFullBatch);
+    adsTest.add_test("testAdsNotificationBuffer", &TestAds::testAdsNotificationBuffer);
+    adsTest.add_test("testAdsNotificationDelivery", &TestAds::testAdsNotificationDelivery);
     adsTest.add_test("testAdsTimeout", &TestAds::testAdsTimeout);
     failedTests += adsTest.run();
 
     TestAdsPerformance performance(errorstream);
     performance.add_test("testManyNotifications", &TestAdsPerformance::testManyNotifications);
     performance.add_test("testParallelReadAndWrite", &TestAdsPerformance::testParallelReadAndWrite);
+    performance.add_test("testParallelReadSamePort", &TestAdsPerformance::testParallelReadSamePort);
+    performance.add_test("testParallelReadCoalesced", &TestAdsPerformance::testParallelReadCoalesced);
+    performance.add_test("testSocketOptionsRoundTrip", &TestAdsPerformance::testSocketOptionsRoundTrip);
+    performance.add_test("testBulkConnections", &TestAdsPerformance::testBulkConnections);
 //	performance.add_test("testEndurance", &TestAdsPerformance::testEndurance);
     failedTests += performance.run();
 
@@ -13,6 +13,7 @@
 
 static void NotifyCallback(const AmsAddr* pAddr, const AdsNotificationHeader* pNotification, uint32_t hUser)
 {
+    /* samples delivered with ADSDELIVERY_DIRECT aren't aligned, so they are only accessed bytewise or by memcpy() */
     const uint8_t* data = reinterpret_cast<const uint8_t*>(pNotification + 1);
     std::cout << std::setfill('0') <<
         "NetId: " << pAddr->netId <<